@@ -35,6 +35,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <libopencm3/cm3/common.h>
 
 /*---------------------------------------------------------------------------*/
 /** @brief Cortex M Enable interrupts
@@ -280,6 +281,113 @@ static inline uint32_t __cm_atomic_set(uint32_t *val)
 
 /**@}*/
 
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || \
+	defined(__ARM_ARCH_8M_MAIN__)
+
+/*---------------------------------------------------------------------------*/
+/** @brief Cortex M Get the base priority mask
+ *
+ * @returns Current BASEPRI, 0 when no priority is masked
+ */
+static inline uint32_t cm_get_basepri(void)
+{
+	uint32_t result;
+	__asm__ volatile ("MRS %0, BASEPRI" : "=r" (result));
+	return result;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Cortex M Set the base priority mask
+ *
+ * @param[in] basepri Interrupts with this priority value or a higher value
+ * (lower priority) are masked, 0 masks none
+ */
+static inline void cm_set_basepri(uint32_t basepri)
+{
+	__asm__ volatile ("MSR BASEPRI, %0" : : "r" (basepri) : "memory");
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Cortex M Raise the base priority mask
+ *
+ * Like cm_set_basepri(), but only ever masks more interrupts.
+ *
+ * @param[in] basepri Priority value to mask from
+ */
+static inline void cm_raise_basepri(uint32_t basepri)
+{
+	__asm__ volatile ("MSR BASEPRI_MAX, %0" : : "r" (basepri) : "memory");
+}
+
+#endif
+
+/** @defgroup CM3_cortex_critical Cortex Core Critical Sections
+ * @ingroup CM3_cortex_defines
+ *
+ * Critical sections of the library drivers. By default they mask all
+ * interrupts, like the atomic blocks. Once cm_set_irq_ceiling() has set a
+ * priority ceiling, on ARMv7-M and ARMv8-M mainline they only mask the
+ * interrupts at or below the ceiling through BASEPRI: interrupts with a
+ * higher priority form a zero latency tier that is never delayed by the
+ * library, and must therefore not call into it.
+ *
+ * cm_critical_measure() tracks the longest critical section in core cycles,
+ * using the DWT cycle counter.
+ */
+/**@{*/
+
+BEGIN_DECLS
+
+void cm_set_irq_ceiling(uint8_t priority);
+uint8_t cm_get_irq_ceiling(void);
+uint32_t cm_critical_enter(void);
+void cm_critical_exit(uint32_t state);
+bool cm_critical_measure(bool enable);
+uint32_t cm_critical_max_cycles(void);
+
+END_DECLS
+
+#if !defined(__DOXYGEN__)
+/* Do not populate this definition outside */
+static inline void __cm_critical_restore(uint32_t *state)
+{
+	cm_critical_exit(*state);
+}
+
+#define __CM_CRITICAL_SAVER()						\
+	__crit __attribute__((__cleanup__(__cm_critical_restore))) =	\
+	cm_critical_enter()
+
+#endif /* !defined(__DOXYGEN) */
+
+/*---------------------------------------------------------------------------*/
+/** @brief Cortex M Critical Declare block
+ *
+ * Like CM_ATOMIC_BLOCK(), masking the interrupts up to the ceiling.
+ *
+ * @warning The usage of sentences break or continue is prohibited in the block
+ * due to implementation of this macro!
+ */
+#if defined(__DOXYGEN__)
+#define CM_CRITICAL_BLOCK()
+#else /* defined(__DOXYGEN__) */
+#define CM_CRITICAL_BLOCK()						\
+	for (uint32_t __CM_CRITICAL_SAVER(), __my = true; __my; __my = false)
+#endif /* defined(__DOXYGEN__) */
+
+/*---------------------------------------------------------------------------*/
+/** @brief Cortex M Critical Declare context
+ *
+ * Like CM_ATOMIC_CONTEXT(), masking the interrupts up to the ceiling.
+ */
+#if defined(__DOXYGEN__)
+#define CM_CRITICAL_CONTEXT()
+#else /* defined(__DOXYGEN__) */
+#define CM_CRITICAL_CONTEXT()	uint32_t __CM_CRITICAL_SAVER()
+#endif /* defined(__DOXYGEN__) */
+
+/**@}*/
+
 
 
 #endif
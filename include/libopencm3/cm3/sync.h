@@ -54,6 +54,70 @@ void mutex_unlock(mutex_t *m);
 
 #endif
 
+/* --- Atomic operations --------------------------------------------------- */
+
+/* LDREX/STREX based on CM3 and above, with interrupts masked (PRIMASK) on
+ * CM0, which has no exclusive access instructions. */
+
+uint32_t sync_fetch_add(volatile uint32_t *addr, uint32_t val);
+uint32_t sync_exchange(volatile uint32_t *addr, uint32_t val);
+bool sync_cas(volatile uint32_t *addr, uint32_t expected, uint32_t desired);
+
+/* --- Single producer, single consumer ring ------------------------------- */
+
+/* Lock free when the producer and the consumer each run in one context,
+ * e.g. an interrupt handler and the main loop. The storage holds a power of
+ * two number of elements. */
+struct sync_spsc {
+	uint8_t *buf;
+	uint32_t mask;
+	uint16_t elem_size;
+	volatile uint32_t head;
+	volatile uint32_t tail;
+};
+
+void sync_spsc_init(struct sync_spsc *r, void *buf, uint32_t count,
+		    uint16_t elem_size);
+bool sync_spsc_push(struct sync_spsc *r, const void *elem);
+bool sync_spsc_pop(struct sync_spsc *r, void *elem);
+uint32_t sync_spsc_count(struct sync_spsc *r);
+
+/* --- Multiple producer, single consumer ring ----------------------------- */
+
+/* Producers may preempt each other, e.g. interrupt handlers of different
+ * priorities: each slot has a sequence number telling whether it is free or
+ * filled, so no producer ever waits for another one. seq holds one word per
+ * element. */
+struct sync_mpsc {
+	uint8_t *buf;
+	volatile uint32_t *seq;
+	uint32_t mask;
+	uint16_t elem_size;
+	volatile uint32_t head;
+	uint32_t tail;
+};
+
+void sync_mpsc_init(struct sync_mpsc *r, void *buf, volatile uint32_t *seq,
+		    uint32_t count, uint16_t elem_size);
+bool sync_mpsc_push(struct sync_mpsc *r, const void *elem);
+bool sync_mpsc_pop(struct sync_mpsc *r, void *elem);
+
+/* --- Sequence lock -------------------------------------------------------- */
+
+/* Consistent snapshots of multi-word data updated by a single writer:
+ * readers retry instead of blocking the writer. A reader must not preempt
+ * the writer, or it spins forever. */
+struct sync_seqlock {
+	volatile uint32_t seq;
+};
+
+#define SYNC_SEQLOCK_INIT	{ 0 }
+
+void sync_seqlock_write_begin(struct sync_seqlock *sl);
+void sync_seqlock_write_end(struct sync_seqlock *sl);
+uint32_t sync_seqlock_read_begin(struct sync_seqlock *sl);
+bool sync_seqlock_read_retry(struct sync_seqlock *sl, uint32_t seq);
+
 END_DECLS
 
 #endif
@@ -0,0 +1,53 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_CM3_TIMEBASE_H
+#define LIBOPENCM3_CM3_TIMEBASE_H
+
+#include <libopencm3/cm3/common.h>
+
+/**
+ * @defgroup cm_timebase Cortex-M 64 bit monotonic timebase
+ * @ingroup CM3_defines
+ * @{
+ */
+
+/** Counter read function: returns an up counting value from 0 to the
+ * maximum given to timebase_init(), wrapping to 0. */
+typedef uint32_t (*timebase_read_t)(void);
+
+BEGIN_DECLS
+
+void timebase_init(timebase_read_t read, uint32_t max, uint32_t freq);
+bool timebase_init_cycles(uint32_t freq);
+void timebase_init_systick(uint32_t freq);
+void timebase_systick_tick(void);
+void timebase_update(void);
+void timebase_set_frequency(uint32_t freq);
+void timebase_advance(uint64_t t);
+uint64_t timebase_now(void);
+uint32_t timebase_frequency(void);
+uint64_t timebase_to_us(uint64_t t);
+uint64_t timebase_to_ns(uint64_t t);
+uint64_t timebase_from_us(uint64_t us);
+uint32_t timebase_read_systick(void);
+
+END_DECLS
+
+/**@}*/
+
+#endif
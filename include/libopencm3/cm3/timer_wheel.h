@@ -0,0 +1,79 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_CM3_TIMER_WHEEL_H
+#define LIBOPENCM3_CM3_TIMER_WHEEL_H
+
+#include <libopencm3/cm3/common.h>
+
+/**
+ * @defgroup cm_timer_wheel Cortex-M hierarchical software timer wheel
+ * @ingroup CM3_defines
+ * @{
+ */
+
+/** Slots per level, as a power of two */
+#define TIMER_WHEEL_BITS		6
+/** Slots per level */
+#define TIMER_WHEEL_SLOTS		(1 << TIMER_WHEEL_BITS)
+/** Number of levels. Timers further than TIMER_WHEEL_SLOTS ^ levels ticks
+ * away are parked in the last level until they come in range. */
+#define TIMER_WHEEL_LEVELS		4
+
+struct timer_wheel_timer;
+
+/** Expiry callback, called from timer_wheel_advance(). The timer may be
+ * added again from the callback. */
+typedef void (*timer_wheel_callback)(struct timer_wheel_timer *t);
+
+/** Software timer, owned by the caller. It may be embedded in a larger
+ * structure holding the callback context. */
+struct timer_wheel_timer {
+	/** Called on expiry */
+	timer_wheel_callback callback;
+
+	/** Expiry tick */
+	uint64_t expires;
+	/** Next timer in the slot */
+	struct timer_wheel_timer *next;
+	/** Link pointing to this timer, NULL while not pending */
+	struct timer_wheel_timer **pprev;
+};
+
+/** Timer wheel. */
+struct timer_wheel {
+	/** Next tick to process */
+	uint64_t now;
+	/** Timer lists */
+	struct timer_wheel_timer *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+BEGIN_DECLS
+
+void timer_wheel_init(struct timer_wheel *tw, uint64_t now);
+void timer_wheel_add(struct timer_wheel *tw, struct timer_wheel_timer *t,
+		     uint64_t expires);
+void timer_wheel_del(struct timer_wheel *tw, struct timer_wheel_timer *t);
+bool timer_wheel_pending(struct timer_wheel_timer *t);
+void timer_wheel_advance(struct timer_wheel *tw, uint64_t now);
+uint32_t timer_wheel_idle(struct timer_wheel *tw, uint32_t max);
+
+END_DECLS
+
+/**@}*/
+
+#endif
@@ -0,0 +1,148 @@
+/** @defgroup can_filter_defines CAN filter compiler defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the STM32 CAN
+acceptance filter compiler</b>
+
+@version 1.0.0
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_CAN_FILTER_H
+#define LIBOPENCM3_CAN_FILTER_H
+
+#include <libopencm3/cm3/common.h>
+
+/**@{*/
+
+/** @defgroup can_filter_error CAN filter compiler return values
+@ingroup can_filter_defines
+
+@{*/
+#define CAN_FILTER_E_OK			0
+/** A rule has an identifier out of range, first > last or a FIFO > 1 */
+#define CAN_FILTER_E_RULE		-1
+/** The entry storage of the filter set is too small */
+#define CAN_FILTER_E_STORAGE		-2
+/** The rules cannot be packed into the available filters, not even
+ * approximately */
+#define CAN_FILTER_E_FILTERS		-3
+/**@}*/
+
+/** @defgroup can_filter_type CAN compiled filter entry types
+@ingroup can_filter_defines
+
+@{*/
+/** bxCAN 16 bit scale identifier list, four standard identifiers */
+#define CAN_FILTER_LIST16		0
+/** bxCAN 16 bit scale identifier/mask, two standard pairs */
+#define CAN_FILTER_MASK16		1
+/** bxCAN 32 bit scale identifier list, two extended identifiers */
+#define CAN_FILTER_LIST32		2
+/** bxCAN 32 bit scale identifier/mask, one extended pair */
+#define CAN_FILTER_MASK32		3
+/** FDCAN dual identifier element */
+#define CAN_FILTER_DUAL			4
+/** FDCAN range element */
+#define CAN_FILTER_RANGE		5
+/**@}*/
+
+/** Acceptance rule: a single identifier or a range of identifiers, steered
+ * to one receive FIFO. */
+struct can_filter_rule {
+	/** First identifier */
+	uint32_t first;
+	/** Last identifier, equal to @p first for a single identifier */
+	uint32_t last;
+	/** The identifiers are extended */
+	bool ext;
+	/** Receive FIFO, 0 or 1 */
+	uint8_t fifo;
+};
+
+/** Compiled filter entry. */
+struct can_filter_entry {
+	/** Identifier, or the first identifier of a range */
+	uint32_t id;
+	/** Mask for bxCAN, last identifier of the range for FDCAN */
+	uint32_t id2;
+	/** Number of identifiers requested by the rules that are matched */
+	uint32_t wanted;
+	/** The identifier is extended */
+	bool ext;
+	/** Receive FIFO */
+	uint8_t fifo;
+	/** Entry type, one of @ref can_filter_type */
+	uint8_t type;
+	/** Filter bank (bxCAN) or filter element (FDCAN) holding the entry */
+	uint16_t filter;
+};
+
+/** Compiled filter set.
+ *
+ * The entry storage must be provided by the application. Each rule needs
+ * one entry for FDCAN and up to 22 (standard) or 58 (extended) for bxCAN
+ * while it is split into identifier/mask pairs; rules with a power of two
+ * sized, aligned range need one.
+ */
+struct can_filter_set {
+	/** Entry storage */
+	struct can_filter_entry *buf;
+	/** Number of entries of @p buf */
+	uint16_t size;
+
+	/** Number of compiled entries, ordered by filter */
+	uint16_t count;
+	/** bxCAN filter banks used */
+	uint16_t banks;
+	/** FDCAN standard identifier filter elements used */
+	uint16_t std_elements;
+	/** FDCAN extended identifier filter elements used */
+	uint16_t ext_elements;
+	/** Number of identifiers accepted by the filters. Overlapping
+	 * identifier/mask pairs are counted twice, so this is an upper bound
+	 * for bxCAN. */
+	uint32_t accepted;
+	/** Number of accepted identifiers not requested by any rule */
+	uint32_t false_positives;
+};
+
+BEGIN_DECLS
+
+int can_filter_compile_bxcan(struct can_filter_set *set,
+			     const struct can_filter_rule *rules,
+			     uint16_t n, uint16_t banks);
+int can_filter_compile_fdcan(struct can_filter_set *set,
+			     const struct can_filter_rule *rules,
+			     uint16_t n, uint16_t std_elements,
+			     uint16_t ext_elements);
+
+/* Provided by the bxCAN driver */
+void can_filter_apply(const struct can_filter_set *set, uint32_t first_bank);
+
+/* Provided by the FDCAN driver */
+void fdcan_filter_apply(const struct can_filter_set *set, uint32_t canport);
+
+END_DECLS
+
+/**@}*/
+
+#endif
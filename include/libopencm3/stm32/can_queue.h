@@ -0,0 +1,132 @@
+/** @defgroup can_queue_defines CAN queue defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the STM32 interrupt
+driven CAN queues</b>
+
+@version 1.0.0
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_CAN_QUEUE_H
+#define LIBOPENCM3_CAN_QUEUE_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/can.h>
+
+/**@{*/
+
+/** Number of transmit mailboxes of the bxCAN */
+#define CAN_QUEUE_MAILBOXES		3
+
+/** CAN frame as stored in the receive ring and the transmit queue. */
+struct can_frame {
+	/** Standard or extended identifier */
+	uint32_t id;
+	/** The identifier is extended */
+	bool ext;
+	/** Remote transmission request */
+	bool rtr;
+	/** Number of data bytes */
+	uint8_t length;
+	/** Receive FIFO the frame arrived in, ignored for transmission */
+	uint8_t fifo;
+	/** Index of the matching filter, ignored for transmission */
+	uint8_t fmi;
+	/** Receive timestamp, only valid in time triggered mode */
+	uint16_t timestamp;
+	/** Payload */
+	uint8_t data[8];
+};
+
+/** Interrupt driven CAN queues.
+ *
+ * The first block of members is the configuration that must be filled in by
+ * the application before can_queue_init(). The receive ring and the transmit
+ * queue are arrays provided by the application.
+ */
+struct can_queue {
+	/** CAN register base address @ref can_reg_base */
+	uint32_t canport;
+	/** Receive ring storage */
+	struct can_frame *rx_buf;
+	/** Number of entries of @p rx_buf, one of them is kept free */
+	uint16_t rx_size;
+	/** Transmit queue storage */
+	struct can_frame *tx_buf;
+	/** Number of entries of @p tx_buf */
+	uint16_t tx_size;
+
+	/** Next receive ring entry written by the interrupt */
+	volatile uint16_t rx_head;
+	/** Next receive ring entry to be read */
+	volatile uint16_t rx_tail;
+	/** Number of queued frames, sorted with the highest priority last */
+	uint16_t tx_count;
+	/** Frames loaded into the mailboxes */
+	struct can_frame mbox[CAN_QUEUE_MAILBOXES];
+	/** Bit mask of the mailboxes holding a pending frame */
+	uint8_t mbox_busy;
+	/** Bit mask of the mailboxes with an abort requested */
+	uint8_t mbox_abort;
+	/** Error flags seen by the last interrupt */
+	uint32_t esr;
+
+	/** Number of frames received */
+	uint32_t rx_frames;
+	/** Number of frames lost because the receive ring was full */
+	uint32_t rx_dropped;
+	/** Number of frames lost because a hardware FIFO overran */
+	uint32_t rx_overruns;
+	/** Number of frames transmitted */
+	uint32_t tx_frames;
+	/** Number of pending frames aborted in favour of a higher priority
+	 * frame and queued again */
+	uint32_t tx_preempted;
+	/** Number of frames dropped after a failed transmission, only with
+	 * automatic retransmission disabled */
+	uint32_t tx_errors;
+	/** Number of times the controller entered the bus-off state */
+	uint32_t bus_off;
+	/** Number of times the controller became error passive */
+	uint32_t error_passive;
+	/** Number of times an error counter reached the warning limit */
+	uint32_t error_warning;
+	/** Last error code, one of the CAN_ESR_LEC_* values */
+	uint32_t last_error;
+};
+
+BEGIN_DECLS
+
+void can_queue_init(struct can_queue *cq);
+bool can_queue_transmit(struct can_queue *cq, const struct can_frame *frame);
+bool can_queue_receive(struct can_queue *cq, struct can_frame *frame);
+uint16_t can_queue_rx_pending(struct can_queue *cq);
+uint16_t can_queue_tx_pending(struct can_queue *cq);
+void can_queue_rx_irq(struct can_queue *cq, uint8_t fifo);
+void can_queue_tx_irq(struct can_queue *cq);
+void can_queue_sce_irq(struct can_queue *cq);
+
+END_DECLS
+
+/**@}*/
+
+#endif
@@ -33,6 +33,7 @@
  */
 
 #include <libopencm3/stm32/memorymap.h>
+#include <libopencm3/cm3/common.h>
 #include <stdint.h>
 
 #ifndef DMA2D_H
@@ -184,5 +185,96 @@
 /** DMA2D Background Color Lookup table */
 #define DMA2D_BG_CLUT			(uint32_t *)(DMA2D_BASE + 0x800U)
 
+struct dma2d_queue;
+struct dma2d_op;
+
+/** Operation completion callback, called from interrupt context. The
+ * operation may be resubmitted from the callback. */
+typedef void (*dma2d_callback)(struct dma2d_queue *q, struct dma2d_op *op);
+
+/** Input layer of an operation: the foreground, or the background of a
+ * blend. */
+struct dma2d_layer {
+	/** Address of the first pixel */
+	uint32_t addr;
+	/** Pixels to skip at the end of each line */
+	uint16_t offset;
+	/** Colour mode, DMA2D_xPFCCR_CM_* */
+	uint8_t format;
+	/** Alpha mode, DMA2D_xPFCCR_AM_* */
+	uint8_t alpha_mode;
+	/** Alpha value used by the alpha mode */
+	uint8_t alpha;
+	/** Colour of the A8/A4 formats, RGB888 */
+	uint32_t color;
+	/** CLUT of the L8/AL44/AL88/L4 formats, or NULL. It is loaded before
+	 * the operation is started. */
+	const uint32_t *clut;
+	/** Number of CLUT entries, 1 to 256 */
+	uint16_t clut_size;
+	/** The CLUT entries are RGB888 instead of ARGB8888 */
+	bool clut_rgb888;
+};
+
+/** DMA2D operation.
+ *
+ * Owned by the caller, it must stay valid until its callback has run.
+ */
+struct dma2d_op {
+	/** Mode, DMA2D_CR_MODE_*: fill (R2M), copy (M2M), copy with pixel
+	 * format conversion (M2MWPFC) or blend (M2MWB) */
+	uint8_t mode;
+	/** Output address of the first pixel */
+	uint32_t dst;
+	/** Output pixels to skip at the end of each line */
+	uint16_t dst_offset;
+	/** Output colour mode, DMA2D_OPFCCR_CM_*. The foreground format is
+	 * used for plain copies. */
+	uint8_t dst_format;
+	/** Width in pixels */
+	uint16_t width;
+	/** Height in lines */
+	uint16_t height;
+	/** Fill colour in the output format */
+	uint32_t color;
+	/** Foreground, the source of copies and conversions */
+	struct dma2d_layer fg;
+	/** Background of a blend */
+	struct dma2d_layer bg;
+	/** Completion callback, or NULL */
+	dma2d_callback callback;
+
+	/** 0 on success, negative on a transfer or configuration error */
+	int status;
+	/** Next operation in the queue */
+	struct dma2d_op *next;
+};
+
+/** DMA2D operation queue. */
+struct dma2d_queue {
+	/** Operation in progress, followed by the queued ones */
+	struct dma2d_op *head;
+	/** Last queued operation */
+	struct dma2d_op *tail;
+	/** The queue is being processed */
+	volatile bool busy;
+	/** CLUTs loaded for the head operation: bit 0 foreground, bit 1
+	 * background */
+	uint8_t clut_loaded;
+	/** Number of completed operations */
+	uint32_t ops;
+	/** Number of operations that failed */
+	uint32_t errors;
+};
+
+BEGIN_DECLS
+
+void dma2d_queue_init(struct dma2d_queue *q);
+void dma2d_submit(struct dma2d_queue *q, struct dma2d_op *op);
+void dma2d_irq(struct dma2d_queue *q);
+bool dma2d_busy(struct dma2d_queue *q);
+
+END_DECLS
+
 /**@}*/
 #endif
@@ -87,6 +87,8 @@
 /* --- FLASH_SR values ----------------------------------------------------- */
 
 #define FLASH_SR_BSY			(1 << 16)
+/* Sequence error: PGSERR on F2/F4, ERSERR on F7 */
+#define FLASH_SR_SEQERR			(1 << 7)
 #define FLASH_SR_PGPERR			(1 << 6)
 #define FLASH_SR_PGAERR			(1 << 5)
 #define FLASH_SR_WRPERR			(1 << 4)
@@ -141,6 +143,17 @@
 #define FLASH_OPTKEYR_KEY1		((uint32_t)0x08192a3b)
 #define FLASH_OPTKEYR_KEY2		((uint32_t)0x4c5d6e7f)
 
+/** Statistics of a flash_program_bulk() call */
+struct flash_program_stats {
+	/** Bytes programmed */
+	uint32_t bytes;
+	/** Program operations, one per flash word */
+	uint32_t operations;
+	/** Processor cycles spent, 0 unless the DWT cycle counter is
+	 * enabled */
+	uint32_t cycles;
+};
+
 /* --- Function prototypes ------------------------------------------------- */
 
 BEGIN_DECLS
@@ -156,6 +169,10 @@ void flash_program_word(uint32_t address, uint32_t data);
 void flash_program_half_word(uint32_t address, uint16_t data);
 void flash_program_byte(uint32_t address, uint8_t data);
 void flash_program(uint32_t address, const uint8_t *data, uint32_t len);
+uint32_t flash_get_program_size(uint16_t vdd_mv, bool vpp);
+uint32_t flash_program_bulk(uint32_t address, const uint8_t *data,
+			    uint32_t len, uint32_t program_size,
+			    struct flash_program_stats *stats);
 void flash_program_option_bytes(uint32_t data);
 
 END_DECLS
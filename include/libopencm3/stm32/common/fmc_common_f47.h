@@ -254,6 +254,31 @@ enum fmc_sdram_command { SDRAM_CLK_CONF, SDRAM_NORMAL, SDRAM_PALL,
 			 SDRAM_AUTO_REFRESH, SDRAM_LOAD_MODE,
 			 SDRAM_SELF_REFRESH, SDRAM_POWER_DOWN };
 
+/*
+ * SDRAM device description for sdram_setup(), with the timings in the units
+ * of the data sheet so they do not depend on the clock.
+ */
+struct sdram_device {
+	uint8_t columns;	/* Column address bits, 8 to 11 */
+	uint8_t rows;		/* Row address bits, 11 to 13 */
+	uint8_t width;		/* Data bus width in bits: 8, 16 or 32 */
+	uint8_t banks;		/* Internal banks: 2 or 4 */
+	uint8_t cas;		/* CAS latency in clock cycles, 1 to 3 */
+	uint32_t max_clock;	/* Highest SDRAM clock in Hz */
+	uint16_t trcd_ns;	/* Active to read/write delay */
+	uint16_t trp_ns;	/* Precharge command period */
+	uint16_t twr_ns;	/* Write recovery time */
+	uint16_t trc_ns;	/* Active to active command period */
+	uint16_t tras_ns;	/* Active to precharge command period */
+	uint16_t txsr_ns;	/* Exit self refresh to active delay */
+	uint8_t tmrd;		/* Load mode register to active cycles */
+	uint16_t refresh_ms;	/* Refresh period, usually 64 ms */
+	uint16_t refresh_rows;	/* Refresh cycles per period, e.g. 4096 */
+	uint16_t power_up_us;	/* Power up delay, usually 100 us */
+	bool read_burst;	/* Let the controller read ahead in bursts */
+	uint8_t read_pipe;	/* Read data delay in HCLK cycles, 0-2 */
+};
+
 /* Send an array of timing parameters (indices above) to create SDTR register
  * value
  */
@@ -262,6 +287,7 @@ BEGIN_DECLS
 uint32_t sdram_timing(struct sdram_timing *t);
 void sdram_command(enum fmc_sdram_bank bank, enum fmc_sdram_command cmd,
 			int autorefresh, int modereg);
+int sdram_setup(enum fmc_sdram_bank bank, const struct sdram_device *dev);
 
 END_DECLS
 
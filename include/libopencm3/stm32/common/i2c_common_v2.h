@@ -400,6 +400,25 @@ enum i2c_speeds {
 	i2c_speed_unknown
 };
 
+/**
+ * Bus and filter parameters for i2c_timing_compute().
+ */
+struct i2c_timing {
+	/** I2C kernel clock in Hz */
+	uint32_t clock;
+	/** SCL frequency in Hz, at most 1 MHz. Standard, fast and fast plus
+	 * mode limits are applied up to 100 kHz, 400 kHz and 1 MHz. */
+	uint32_t speed;
+	/** SCL/SDA rise time in ns, as measured on the bus */
+	uint16_t rise_ns;
+	/** SCL/SDA fall time in ns */
+	uint16_t fall_ns;
+	/** The analog noise filter is enabled (ANFOFF cleared) */
+	bool analog_filter;
+	/** Digital noise filter length in kernel clocks (DNF), 0 to 15 */
+	uint8_t digital_filter;
+};
+
 BEGIN_DECLS
 
 void i2c_peripheral_enable(uint32_t i2c);
@@ -445,6 +464,10 @@ void i2c_enable_txdma(uint32_t i2c);
 void i2c_disable_txdma(uint32_t i2c);
 void i2c_transfer7(uint32_t i2c, uint8_t addr, const uint8_t *w, size_t wn, uint8_t *r, size_t rn);
 void i2c_set_speed(uint32_t i2c, enum i2c_speeds speed, uint32_t clock_megahz);
+bool i2c_timing_compute(const struct i2c_timing *timing, uint32_t *timingr);
+void i2c_set_timing(uint32_t i2c, uint32_t timingr);
+void i2c_enable_fast_mode_plus(uint32_t i2c);
+void i2c_disable_fast_mode_plus(uint32_t i2c);
 
 END_DECLS
 
@@ -39,6 +39,7 @@
 
 
 #include <stdint.h>
+#include <libopencm3/cm3/common.h>
 #include <libopencm3/stm32/rcc.h>
 
 /**
@@ -535,6 +536,81 @@ static inline uint32_t ltdc_get_rgb888_from_rgb565(uint16_t rgb565)
 		 | ((((rgb565_32) & 0x001F) <<  (8-0))/31)<<0;
 }
 
+/**
+ * double/triple buffered layers with swaps at vertical blanking
+ */
+
+/** Number of framebuffers a layer can rotate through */
+#define LTDC_SWAP_BUFFERS	3
+/** No buffer index */
+#define LTDC_SWAP_NONE		0xff
+
+struct ltdc_swap;
+
+/** Line interrupt callback, called from interrupt context once per refresh
+ * when the scan reaches ltdc_swap::line. */
+typedef void (*ltdc_swap_callback)(struct ltdc_swap *ls);
+
+/** Framebuffers of one layer. */
+struct ltdc_swap_layer {
+	/** Framebuffer addresses, the first @p count are used. Leave @p count
+	 * 0 for a layer that is not managed. */
+	uint32_t fb[LTDC_SWAP_BUFFERS];
+	/** Number of framebuffers: 2 or 3 */
+	uint8_t count;
+
+	/** Buffer being scanned out */
+	volatile uint8_t front;
+	/** Buffer waiting for the next vertical blanking, or LTDC_SWAP_NONE */
+	volatile uint8_t queued;
+	/** Buffer handed out for drawing, or LTDC_SWAP_NONE */
+	uint8_t draw;
+};
+
+/** Framebuffer swap manager for both layers.
+ *
+ * The configuration members must be filled in before ltdc_swap_init().
+ */
+struct ltdc_swap {
+	/** Layers, index 0 is LTDC_LAYER_1 */
+	struct ltdc_swap_layer layer[2];
+	/** Line interrupt position, counted like LTDC_CPSR_CYPOS. 0 selects
+	 * the first line after the active area, the start of vertical
+	 * blanking. */
+	uint16_t line;
+	/** Line interrupt callback, or NULL */
+	ltdc_swap_callback callback;
+
+	/** Number of refreshes, counted at the line interrupt */
+	volatile uint32_t refreshes;
+	/** Refresh count at the last swap */
+	uint32_t last_swap;
+	/** Number of completed swaps */
+	uint32_t swaps;
+	/** Refreshes between the last two swaps */
+	uint32_t frame_time;
+	/** Shortest and longest frame_time seen */
+	uint32_t frame_time_min;
+	uint32_t frame_time_max;
+	/** Queued frames replaced by a newer one before they were shown */
+	uint32_t dropped;
+	/** FIFO underruns */
+	uint32_t underruns;
+	/** AHB transfer errors */
+	uint32_t transfer_errors;
+};
+
+BEGIN_DECLS
+
+void ltdc_swap_init(struct ltdc_swap *ls);
+uint32_t ltdc_swap_back_buffer(struct ltdc_swap *ls, uint8_t layer);
+bool ltdc_swap_present(struct ltdc_swap *ls, uint8_t layer);
+void ltdc_swap_irq(struct ltdc_swap *ls);
+void ltdc_set_clut(uint8_t layer, const uint32_t *clut, uint16_t n);
+void ltdc_set_color_keying(uint8_t layer, bool enable, uint32_t rgb888);
+
+END_DECLS
+
 /** @cond */
 #endif /* LIBOPENCM3_STM32_COMMON_LTDC_COMMON_F47_H_ */
 /** @endcond */
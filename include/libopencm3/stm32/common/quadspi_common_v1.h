@@ -71,6 +71,9 @@
 #define QUADSPI_CR_SSHIFT   (1 << 4)
 #define QUADSPI_CR_TCEN     (1 << 3)
 /* bit 2 reserved on h7, DMAEN on f4 */
+#if !defined(STM32H7)
+#define QUADSPI_CR_DMAEN    (1 << 2)
+#endif
 #define QUADSPI_CR_ABORT    (1 << 1)
 #define QUADSPI_CR_EN     (1 << 0)
 
@@ -158,6 +161,89 @@
  * @{
  */
 
+/**
+ * Command description: which phases a command has, on how many lines and in
+ * which data rate. The data length is passed separately.
+ */
+struct quadspi_command {
+	/** Instruction byte */
+	uint8_t instruction;
+	/** Instruction phase lines, QUADSPI_CCR_MODE_* */
+	uint8_t imode;
+	/** Address phase lines, QUADSPI_CCR_MODE_NONE for no address */
+	uint8_t admode;
+	/** Address size in bytes, 1 to 4 */
+	uint8_t adsize;
+	/** Alternate byte (mode bits) phase lines */
+	uint8_t abmode;
+	/** Alternate bytes size in bytes, 1 to 4 */
+	uint8_t absize;
+	/** Alternate bytes */
+	uint32_t alternate;
+	/** Dummy cycles, 0 to 31 */
+	uint8_t dummy;
+	/** Data phase lines, QUADSPI_CCR_MODE_NONE for no data */
+	uint8_t dmode;
+	/** Double data rate for the address, alternate and data phases */
+	bool ddr;
+	/** Send the instruction only for the first command, memory mapped
+	 * mode with flashes in continuous read ("XIP") mode */
+	bool sioo;
+};
+
+/**
+ * @defgroup quadspi_jedec QuadSPI command templates for common JEDEC flashes
+ * Initialisers for struct quadspi_command, for flashes with 3 byte addresses.
+ * The dummy cycles of the fast reads are the usual defaults, check the flash
+ * data sheet for the clock used.
+ * @{
+ */
+#define QUADSPI_CMD_1LINE(inst) \
+	.instruction = (inst), .imode = QUADSPI_CCR_MODE_1LINE
+#define QUADSPI_CMD_ADDR3(lines) \
+	.admode = (lines), .adsize = 3
+
+#define QUADSPI_CMD_WRITE_ENABLE \
+	{ QUADSPI_CMD_1LINE(0x06) }
+#define QUADSPI_CMD_READ_STATUS \
+	{ QUADSPI_CMD_1LINE(0x05), .dmode = QUADSPI_CCR_MODE_1LINE }
+#define QUADSPI_CMD_READ_JEDEC_ID \
+	{ QUADSPI_CMD_1LINE(0x9f), .dmode = QUADSPI_CCR_MODE_1LINE }
+#define QUADSPI_CMD_SECTOR_ERASE_4K \
+	{ QUADSPI_CMD_1LINE(0x20), QUADSPI_CMD_ADDR3(QUADSPI_CCR_MODE_1LINE) }
+#define QUADSPI_CMD_BLOCK_ERASE_64K \
+	{ QUADSPI_CMD_1LINE(0xd8), QUADSPI_CMD_ADDR3(QUADSPI_CCR_MODE_1LINE) }
+#define QUADSPI_CMD_PAGE_PROGRAM \
+	{ QUADSPI_CMD_1LINE(0x02), QUADSPI_CMD_ADDR3(QUADSPI_CCR_MODE_1LINE), \
+	  .dmode = QUADSPI_CCR_MODE_1LINE }
+/** 1-1-4 page program */
+#define QUADSPI_CMD_QUAD_PAGE_PROGRAM \
+	{ QUADSPI_CMD_1LINE(0x32), QUADSPI_CMD_ADDR3(QUADSPI_CCR_MODE_1LINE), \
+	  .dmode = QUADSPI_CCR_MODE_4LINE }
+#define QUADSPI_CMD_READ \
+	{ QUADSPI_CMD_1LINE(0x03), QUADSPI_CMD_ADDR3(QUADSPI_CCR_MODE_1LINE), \
+	  .dmode = QUADSPI_CCR_MODE_1LINE }
+#define QUADSPI_CMD_FAST_READ \
+	{ QUADSPI_CMD_1LINE(0x0b), QUADSPI_CMD_ADDR3(QUADSPI_CCR_MODE_1LINE), \
+	  .dummy = 8, .dmode = QUADSPI_CCR_MODE_1LINE }
+/** 1-1-4 fast read */
+#define QUADSPI_CMD_QUAD_OUTPUT_READ \
+	{ QUADSPI_CMD_1LINE(0x6b), QUADSPI_CMD_ADDR3(QUADSPI_CCR_MODE_1LINE), \
+	  .dummy = 8, .dmode = QUADSPI_CCR_MODE_4LINE }
+/** 1-4-4 fast read, with mode bits 0x00 (no continuous read) */
+#define QUADSPI_CMD_QUAD_IO_READ \
+	{ QUADSPI_CMD_1LINE(0xeb), QUADSPI_CMD_ADDR3(QUADSPI_CCR_MODE_4LINE), \
+	  .abmode = QUADSPI_CCR_MODE_4LINE, .absize = 1, .dummy = 4, \
+	  .dmode = QUADSPI_CCR_MODE_4LINE }
+/** 1-4-4 double transfer rate fast read, the dummy cycles depend on the
+ * flash */
+#define QUADSPI_CMD_QUAD_IO_READ_DTR(dummy_cycles) \
+	{ QUADSPI_CMD_1LINE(0xed), QUADSPI_CMD_ADDR3(QUADSPI_CCR_MODE_4LINE), \
+	  .abmode = QUADSPI_CCR_MODE_4LINE, .absize = 1, \
+	  .dummy = (dummy_cycles), .dmode = QUADSPI_CCR_MODE_4LINE, \
+	  .ddr = true }
+/**@}*/
+
 BEGIN_DECLS
 
 /**
@@ -170,6 +256,101 @@ void quadspi_enable(void);
  */
 void quadspi_disable(void);
 
+/**
+ * Configure and enable the quadspi peripheral for one flash.
+ * @param prescaler Kernel clock divider minus one, 0 to 255
+ * @param size_log2 Flash size as a power of two bytes, e.g. 24 for 16 MiB
+ * @param cs_high Minimum chip select high time between commands, 1 to 8
+ * cycles
+ * @param sample_shift Sample data half a clock cycle later, needed at high
+ * clock rates. Not allowed in DDR mode.
+ */
+void quadspi_setup(uint8_t prescaler, uint8_t size_log2, uint8_t cs_high,
+		   bool sample_shift);
+
+/**
+ * Abort the ongoing command, also ending memory mapped mode.
+ */
+void quadspi_abort(void);
+
+/**
+ * Send a command without a data phase, e.g. write enable or erase.
+ * @param cmd Command
+ * @param address Address, if the command has an address phase
+ * @returns 0, or -1 on a transfer error
+ */
+int quadspi_command(const struct quadspi_command *cmd, uint32_t address);
+
+/**
+ * Read data in indirect mode through the FIFO.
+ * @param cmd Command with a data phase
+ * @param address Address, if the command has an address phase
+ * @param buf Destination
+ * @param len Number of bytes, at least 1
+ * @returns 0, or -1 on a transfer error
+ */
+int quadspi_read(const struct quadspi_command *cmd, uint32_t address,
+		 void *buf, uint32_t len);
+
+/**
+ * Write data in indirect mode through the FIFO.
+ * @param cmd Command with a data phase
+ * @param address Address, if the command has an address phase
+ * @param buf Source
+ * @param len Number of bytes, at least 1
+ * @returns 0, or -1 on a transfer error
+ */
+int quadspi_write(const struct quadspi_command *cmd, uint32_t address,
+		  const void *buf, uint32_t len);
+
+#if !defined(STM32H7)
+/**
+ * Start an indirect transfer that is fed by DMA.
+ *
+ * The DMA stream or channel must be set up and enabled by the caller, for
+ * @p len bytes from or to QUADSPI_DR. Completion is signalled by the DMA,
+ * quadspi_wait() then ends the command.
+ * @param cmd Command with a data phase
+ * @param address Address, if the command has an address phase
+ * @param len Number of bytes, at least 1
+ * @param write Direction, true for writes to the flash
+ */
+void quadspi_start_dma(const struct quadspi_command *cmd, uint32_t address,
+		       uint32_t len, bool write);
+#endif
+
+/**
+ * Wait for the end of the current command and disable its DMA requests.
+ * @returns 0, or -1 on a transfer error
+ */
+int quadspi_wait(void);
+
+/**
+ * Poll a flash status register in automatic polling mode until
+ * (status & mask) == match, e.g. until the write in progress bit clears.
+ * @param cmd Status read command, e.g. QUADSPI_CMD_READ_STATUS
+ * @param mask Status bits to compare, the status is 1 byte per set byte lane
+ * @param match Expected value of the masked status
+ * @param interval Clock cycles between two reads
+ * @param max_loops Status register reads before giving up, 0 for no limit.
+ * This counts loop iterations, not time: scale it with the core clock.
+ * @returns 0, or -1 on a transfer error or timeout
+ */
+int quadspi_poll(const struct quadspi_command *cmd, uint32_t mask,
+		 uint32_t match, uint16_t interval, uint32_t max_loops);
+
+/**
+ * Enter memory mapped mode: reads of the QUADSPI bank are translated into
+ * read commands, with prefetching of the following data. quadspi_abort()
+ * must be called before any other command is sent.
+ * @param cmd Read command, e.g. QUADSPI_CMD_QUAD_IO_READ
+ * @param timeout Clock cycles after which chip select is released while the
+ * bus is idle, ending the prefetch. 0 keeps it asserted, which gives the
+ * lowest latency for sequential accesses but keeps the flash busy.
+ */
+void quadspi_memory_mapped(const struct quadspi_command *cmd,
+			   uint16_t timeout);
+
 END_DECLS
 
 /**@}*/
@@ -351,6 +351,8 @@ void spi_write(uint32_t spi, uint16_t data);
 void spi_send(uint32_t spi, uint16_t data);
 uint16_t spi_read(uint32_t spi);
 uint16_t spi_xfer(uint32_t spi, uint16_t data);
+void spi_transfer(uint32_t spi, const uint8_t *tx, uint8_t *rx,
+		  uint16_t len);
 void spi_set_bidirectional_mode(uint32_t spi);
 void spi_set_unidirectional_mode(uint32_t spi);
 void spi_set_bidirectional_receive_only_mode(uint32_t spi);
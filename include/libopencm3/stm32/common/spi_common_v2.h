@@ -36,6 +36,8 @@ specific memorymap.h header before including this header file.*/
 #define SPI2_DR8		SPI_DR8(SPI2_BASE)
 #define SPI3_DR8		SPI_DR8(SPI3_BASE)
 
+#define SPI_DR16(spi_base)	MMIO16((spi_base) + 0x0c)
+
 /* CRCL: CRC Length */
 /****************************************************************************/
 /** @defgroup spi_crcl SPI crc length
@@ -0,0 +1,95 @@
+/** @defgroup dma_copy_defines DMA memory copy defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the STM32 DMA memory
+copy and fill service</b>
+
+@version 1.0.0
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_DMA_COPY_H
+#define LIBOPENCM3_DMA_COPY_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/dma_mgr.h>
+
+/**@{*/
+
+struct dma_copy;
+
+/** Completion callback.
+ *
+ * Called from interrupt context, or from dma_memcpy_async() and
+ * dma_memset_async() for requests done by the CPU. A new request may be
+ * started from the callback.
+ *
+ * @param dc Copy engine
+ * @param status 0 on success, negative on a DMA transfer error
+ * @param arg Argument given with the request
+ */
+typedef void (*dma_copy_callback)(struct dma_copy *dc, int status, void *arg);
+
+/** DMA memory copy engine.
+ *
+ * The first block of members is the configuration that must be filled in by
+ * the application before dma_copy_init(). Only DMA2 can do memory to memory
+ * transfers on F2/F4/F7.
+ */
+struct dma_copy {
+	/** DMA controller base address */
+	uint32_t dma;
+	/** Stream or channel number */
+	uint8_t channel;
+	/** Priority, one of @ref dma_xfer_priority */
+	uint8_t priority;
+	/** Requests shorter than this number of bytes are done by the CPU,
+	 * which is faster than setting up the DMA for them */
+	uint32_t threshold;
+
+	/* Private state */
+	volatile bool busy;
+	bool fill;
+	uint8_t *dst;
+	const uint8_t *src;
+	uint32_t remaining;
+	uint32_t pattern;
+	dma_copy_callback callback;
+	void *arg;
+
+	/** Number of requests aborted by a DMA transfer error */
+	uint32_t dma_errors;
+};
+
+BEGIN_DECLS
+
+int dma_copy_init(struct dma_copy *dc);
+int dma_memcpy_async(struct dma_copy *dc, void *dst, const void *src,
+		     uint32_t n, dma_copy_callback callback, void *arg);
+int dma_memset_async(struct dma_copy *dc, void *dst, uint8_t c, uint32_t n,
+		     dma_copy_callback callback, void *arg);
+bool dma_copy_busy(const struct dma_copy *dc);
+
+END_DECLS
+
+/**@}*/
+
+#endif
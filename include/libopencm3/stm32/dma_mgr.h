@@ -0,0 +1,82 @@
+/** @defgroup dma_mgr_defines DMA resource manager defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the STM32 DMA resource
+manager</b>
+
+@version 1.0.0
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_DMA_MGR_H
+#define LIBOPENCM3_DMA_MGR_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/dma_xfer.h>
+
+/**@{*/
+
+/* The number of streams/channels is set by @ref dma_xfer_count. */
+#if defined(STM32F2) || defined(STM32F4) || defined(STM32F7)
+/** Streams are numbered from 0, channels from 1. */
+#define DMA_MGR_FIRST			0
+#else
+#define DMA_MGR_FIRST			1
+#endif
+
+/** @defgroup dma_mgr_error DMA resource manager return values
+@ingroup dma_mgr_defines
+
+@{*/
+#define DMA_MGR_E_OK			0
+/** The stream/channel is owned by someone else */
+#define DMA_MGR_E_BUSY			-1
+/** No such stream/channel, or none left */
+#define DMA_MGR_E_NONE			-2
+/**@}*/
+
+/** Event callback.
+ *
+ * Called from dma_mgr_irq() in interrupt context.
+ *
+ * @param dma DMA controller base address
+ * @param channel Stream or channel number
+ * @param flags Events, a combination of DMA_TCIF, DMA_HTIF and DMA_TEIF
+ * @param arg Argument given to dma_mgr_set_callback()
+ */
+typedef void (*dma_mgr_callback)(uint32_t dma, uint8_t channel,
+				 uint32_t flags, void *arg);
+
+BEGIN_DECLS
+
+int dma_mgr_claim(uint32_t dma, uint8_t channel, const void *owner);
+int dma_mgr_alloc(uint32_t dma, const void *owner);
+void dma_mgr_release(uint32_t dma, uint8_t channel, const void *owner);
+const void *dma_mgr_owner(uint32_t dma, uint8_t channel);
+void dma_mgr_set_callback(uint32_t dma, uint8_t channel,
+			  dma_mgr_callback callback, void *arg);
+void dma_mgr_irq(uint32_t dma, uint8_t channel);
+
+END_DECLS
+
+/**@}*/
+
+#endif
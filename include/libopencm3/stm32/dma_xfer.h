@@ -0,0 +1,176 @@
+/** @defgroup dma_xfer_defines DMA transfer descriptor defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the STM32 DMA transfer
+descriptors</b>
+
+@version 1.0.0
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_DMA_XFER_H
+#define LIBOPENCM3_DMA_XFER_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/dma.h>
+#if defined(STM32G0) || defined(STM32G4)
+#include <libopencm3/stm32/dmamux.h>
+#endif
+
+/**@{*/
+
+/** @defgroup dma_xfer_count DMA streams/channels per controller
+@ingroup dma_xfer_defines
+
+Defaults for the largest parts of each family. Define them on the command line
+for parts with fewer channels, so dma_mgr_alloc() does not hand out channels
+that do not exist. On the DMAMUX, the DMA2 channels follow the DMA1 ones.
+@{*/
+#ifndef DMA_XFER_DMA1_CHANNELS
+#if defined(STM32F2) || defined(STM32F4) || defined(STM32F7) || \
+	defined(STM32G4)
+#define DMA_XFER_DMA1_CHANNELS		8
+#else
+#define DMA_XFER_DMA1_CHANNELS		7
+#endif
+#endif
+
+#ifndef DMA_XFER_DMA2_CHANNELS
+#if defined(STM32F2) || defined(STM32F4) || defined(STM32F7) || \
+	defined(STM32G4)
+#define DMA_XFER_DMA2_CHANNELS		8
+#elif defined(STM32L4)
+#define DMA_XFER_DMA2_CHANNELS		7
+#elif defined(STM32L0)
+#define DMA_XFER_DMA2_CHANNELS		0
+#else
+#define DMA_XFER_DMA2_CHANNELS		5
+#endif
+#endif
+/**@}*/
+
+/** @defgroup dma_xfer_dir DMA transfer direction
+@ingroup dma_xfer_defines
+
+@{*/
+#define DMA_XFER_PERIPH_TO_MEM		0
+#define DMA_XFER_MEM_TO_PERIPH		1
+/** From the peripheral address to the memory address, both in memory */
+#define DMA_XFER_MEM_TO_MEM		2
+/**@}*/
+
+/** @defgroup dma_xfer_priority DMA transfer priority
+@ingroup dma_xfer_defines
+
+@{*/
+#define DMA_XFER_PRIORITY_LOW		0
+#define DMA_XFER_PRIORITY_MEDIUM	1
+#define DMA_XFER_PRIORITY_HIGH		2
+#define DMA_XFER_PRIORITY_VERY_HIGH	3
+/**@}*/
+
+/** @defgroup dma_xfer_irq DMA transfer interrupt selection
+@ingroup dma_xfer_defines
+
+@{*/
+#define DMA_XFER_IRQ_TC			(1 << 0)
+#define DMA_XFER_IRQ_HT			(1 << 1)
+#define DMA_XFER_IRQ_TE			(1 << 2)
+/**@}*/
+
+/** Description of a transfer, independent of the DMA controller type. */
+struct dma_xfer_config {
+	/** DMA controller base address */
+	uint32_t dma;
+	/** Stream number on F2/F4/F7, channel number otherwise */
+	uint8_t channel;
+	/** Request routing: channel select on F2/F4/F7, CSELR request on
+	 * F0/L0/L4 or DMAMUX request on G0/G4. Ignored elsewhere. */
+	uint8_t request;
+	/** Direction, one of @ref dma_xfer_dir */
+	uint8_t dir;
+	/** Peripheral address, the source of a memory to memory transfer */
+	uint32_t paddr;
+	/** Memory address */
+	uint32_t maddr;
+	/** Number of peripheral data items */
+	uint16_t count;
+	/** Peripheral data size in bytes: 1, 2 or 4 */
+	uint8_t psize;
+	/** Memory data size in bytes: 1, 2 or 4 */
+	uint8_t msize;
+	/** Increment the peripheral address */
+	bool pinc;
+	/** Increment the memory address */
+	bool minc;
+	/** Restart at the end of the buffer */
+	bool circular;
+	/** Priority, one of @ref dma_xfer_priority */
+	uint8_t priority;
+	/** Interrupts to enable, @ref dma_xfer_irq */
+	uint8_t irq;
+	/** FIFO threshold in quarters (1 to 4) on F2/F4/F7, 0 for direct
+	 * mode where possible. Ignored elsewhere. */
+	uint8_t fifo;
+	/** Memory burst length in beats (4, 8 or 16) on F2/F4/F7, also used
+	 * on the peripheral port of a memory to memory transfer. 0 for single
+	 * transfers. Needs the FIFO, the burst must fit the FIFO threshold and
+	 * must not cross a 1 KiB boundary. Ignored elsewhere. */
+	uint8_t burst;
+};
+
+/** Register values of a transfer, computed by dma_xfer_prepare(). */
+struct dma_xfer {
+	/** DMA controller base address */
+	uint32_t dma;
+	/** Stream or channel number */
+	uint8_t channel;
+	/** Request routing value */
+	uint8_t request;
+	/** Control register, without the enable bit */
+	uint32_t cr;
+	/** Number of data items */
+	uint32_t ndtr;
+	/** Peripheral address */
+	uint32_t par;
+	/** Memory address */
+	uint32_t mar;
+	/** FIFO control register, streams only */
+	uint32_t fcr;
+};
+
+BEGIN_DECLS
+
+void dma_xfer_prepare(struct dma_xfer *xfer,
+		      const struct dma_xfer_config *cfg);
+void dma_xfer_commit(const struct dma_xfer *xfer);
+void dma_xfer_start(const struct dma_xfer *xfer);
+void dma_xfer_restart(uint32_t dma, uint8_t channel, uint32_t maddr,
+		      uint16_t count);
+void dma_xfer_stop(uint32_t dma, uint8_t channel);
+void dma_xfer_set_minc(uint32_t dma, uint8_t channel, bool minc);
+uint32_t dma_xfer_get_flags(uint32_t dma, uint8_t channel);
+
+END_DECLS
+
+/**@}*/
+
+#endif
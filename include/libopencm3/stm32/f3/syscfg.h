@@ -38,4 +38,19 @@
 
 #include <libopencm3/stm32/common/syscfg_common_l1f234.h>
 
+/* --- SYSCFG registers ---------------------------------------------------- */
+
+/* SYSCFG configuration register 1, at the offset of SYSCFG_MEMRM */
+#define SYSCFG_CFGR1			MMIO32(SYSCFG_BASE + 0x00)
+
+/* --- SYSCFG_CFGR1 Values ------------------------------------------------- */
+
+#define SYSCFG_CFGR1_I2C_PB6_FMP	(1 << 16)
+#define SYSCFG_CFGR1_I2C_PB7_FMP	(1 << 17)
+#define SYSCFG_CFGR1_I2C_PB8_FMP	(1 << 18)
+#define SYSCFG_CFGR1_I2C_PB9_FMP	(1 << 19)
+#define SYSCFG_CFGR1_I2C1_FMP		(1 << 20)
+#define SYSCFG_CFGR1_I2C2_FMP		(1 << 21)
+#define SYSCFG_CFGR1_I2C3_FMP		(1 << 24)
+
 #endif
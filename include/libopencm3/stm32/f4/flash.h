@@ -36,11 +36,23 @@
 #include <libopencm3/stm32/common/flash_common_f24.h>
 
 #define FLASH_SR_PGSERR			(1 << 7)
+/* Mass erase of bank 2 on dual bank parts, FLASH_CR_MER erases bank 1 */
+#define FLASH_CR_MER1			(1 << 15)
+/* Dual bank mode of 1 MiB parts */
+#define FLASH_OPTCR_DB1M		(1 << 30)
 #define FLASH_OPTCR_WDG_SW		(1 << 5)
+/* Boot from bank 2 */
+#define FLASH_OPTCR_BFB2		(1 << 4)
 
 BEGIN_DECLS
 
 void flash_clear_pgserr_flag(void);
+bool flash_is_dual_bank(void);
+uint32_t flash_bank_size(void);
+uint8_t flash_bank_active(void);
+void flash_erase_bank(uint8_t bank, uint32_t program_size);
+bool flash_bank_swap_get(void);
+void flash_bank_swap_set(bool swap);
 
 END_DECLS
 
@@ -825,6 +825,31 @@ extern const struct rcc_clock_scale rcc_hse_12mhz_3v3[RCC_CLOCK_3V3_END];
 extern const struct rcc_clock_scale rcc_hse_16mhz_3v3[RCC_CLOCK_3V3_END];
 extern const struct rcc_clock_scale rcc_hse_25mhz_3v3[RCC_CLOCK_3V3_END];
 
+/** Clock targets for rcc_clock_scale_solve(). */
+struct rcc_clock_request {
+	/** HSE frequency in Hz, or 0 to run the PLL from the 16 MHz HSI */
+	uint32_t hse_frequency;
+	/** Wanted SYSCLK in Hz, the closest one not above it is chosen */
+	uint32_t sysclk_frequency;
+	/** Require exactly 48 MHz on the PLL Q output for USB, SDIO and RNG */
+	bool usb;
+	/** Supply voltage in mV for the flash wait states, 0 for 3300 */
+	uint16_t vdd_mv;
+	/** Highest APB1 frequency in Hz, 0 for 42 MHz */
+	uint32_t apb1_max;
+	/** Highest APB2 frequency in Hz, 0 for 84 MHz */
+	uint32_t apb2_max;
+};
+
+/** PLL output frequency for a source frequency and M, N and P/Q/R divider
+ * settings. Usable in constant expressions, e.g. to check a table entry. */
+#define RCC_PLL_FREQUENCY(src, m, n, div) \
+	((uint32_t)((uint64_t)(src) * (n) / ((uint64_t)(m) * (div))))
+
+/** Flash wait states needed for an HCLK in Hz at 2.7 - 3.6 V. Usable in
+ * constant expressions, with FLASH_ACR_LATENCY(). */
+#define RCC_FLASH_WS_3V3(hclk)		(((hclk) - 1) / 30000000)
+
 enum rcc_osc {
 	RCC_PLL,
 	RCC_PLLSAI,
@@ -1130,6 +1155,12 @@ void rcc_set_main_pll_hse(uint32_t pllm, uint32_t plln, uint32_t pllp,
 			  uint32_t pllq, uint32_t pllr);
 uint32_t rcc_system_clock_source(void);
 void rcc_clock_setup_pll(const struct rcc_clock_scale *clock);
+bool rcc_clock_scale_solve(const struct rcc_clock_request *req,
+			   struct rcc_clock_scale *clock);
+uint32_t rcc_pll_aux_solve(const struct rcc_clock_scale *clock,
+			   uint32_t src_frequency, uint32_t frequency,
+			   uint8_t div_min, uint8_t div_max,
+			   uint16_t *n, uint8_t *div);
 void __attribute__((deprecated("Use rcc_clock_setup_pll as direct replacement"))) rcc_clock_setup_hse_3v3(const struct rcc_clock_scale *clock);
 uint32_t rcc_get_usart_clk_freq(uint32_t usart);
 uint32_t rcc_get_timer_clk_freq(uint32_t timer);
@@ -61,10 +61,17 @@
 
 #define FLASH_SR_ERSERR			(1 << 7)
 
+/* Mass erase of bank 2 in dual bank mode, FLASH_CR_MER erases bank 1 */
+#define FLASH_CR_MER1			(1 << 15)
+
 /* --- FLASH_OPTCR values -------------------------------------------------- */
 
 #define FLASH_OPTCR_IWDG_STOP		(1 << 31)
 #define FLASH_OPTCR_IWDG_STDBY		(1 << 30)
+/* Single bank mode (F76x/F77x) */
+#define FLASH_OPTCR_NDBANK		(1 << 29)
+/* Dual boot disabled (F76x/F77x) */
+#define FLASH_OPTCR_NDBOOT		(1 << 28)
 
 #define FLASH_OPTCR_NWRP_SHIFT		16
 #define FLASH_OPTCR_NWRP_MASK		0xff
@@ -91,6 +98,10 @@ BEGIN_DECLS
 void flash_clear_erserr_flag(void);
 void flash_art_enable(void);
 void flash_art_reset(void);
+bool flash_is_dual_bank(void);
+uint32_t flash_bank_size(void);
+uint8_t flash_bank_active(void);
+void flash_erase_bank(uint8_t bank, uint32_t program_size);
 
 END_DECLS
 /**@}*/
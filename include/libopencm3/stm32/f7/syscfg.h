@@ -33,4 +33,20 @@
 
 #include <libopencm3/stm32/common/syscfg_common_l1f234.h>
 
+/* --- SYSCFG_MEMRM Values ------------------------------------------------- */
+
+/* Flash banks swapped (F76x/F77x in dual bank mode) */
+#define SYSCFG_MEMRM_SWP_FB		(1 << 8)
+
+/* --- SYSCFG_PMC Values --------------------------------------------------- */
+
+#define SYSCFG_PMC_I2C1_FMP		(1 << 0)
+#define SYSCFG_PMC_I2C2_FMP		(1 << 1)
+#define SYSCFG_PMC_I2C3_FMP		(1 << 2)
+#define SYSCFG_PMC_I2C4_FMP		(1 << 3)
+#define SYSCFG_PMC_I2C_PB6_FMP		(1 << 4)
+#define SYSCFG_PMC_I2C_PB7_FMP		(1 << 5)
+#define SYSCFG_PMC_I2C_PB8_FMP		(1 << 6)
+#define SYSCFG_PMC_I2C_PB9_FMP		(1 << 7)
+
 #endif
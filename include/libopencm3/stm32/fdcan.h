@@ -724,6 +724,43 @@ struct fdcan_tx_buffer_element {
 #define FDCAN_FIFO_RXTS_SHIFT			0
 #define FDCAN_FIFO_RXTS_MASK			0xFFFF
 
+/** @defgroup fdcan_frame_flags Frame flags
+ * Flags of @ref fdcan_frame.
+ * @{
+ */
+/** Extended (29 bit) identifier */
+#define FDCAN_FRAME_EXT					(1 << 0)
+/** Remote transmission request */
+#define FDCAN_FRAME_RTR					(1 << 1)
+/** FDCAN frame format */
+#define FDCAN_FRAME_FDF					(1 << 2)
+/** Bitrate switching for the data phase */
+#define FDCAN_FRAME_BRS					(1 << 3)
+/** Error state indicator of the transmitter */
+#define FDCAN_FRAME_ESI					(1 << 4)
+/**@}*/
+
+/** CAN or FDCAN frame used by @ref fdcan_rx_burst and @ref fdcan_tx_burst.
+ *
+ * Payload is stored in 32bit words, so that it can be copied from and to
+ * message RAM without unaligned accesses. Bytes are in transmission order
+ * when the payload is accessed through an uint8_t pointer.
+ */
+struct fdcan_frame {
+	/** Standard or extended message ID */
+	uint32_t id;
+	/** Frame flags. See @ref fdcan_frame_flags. */
+	uint8_t flags;
+	/** Payload length in bytes. Must be a valid CAN or FDCAN length. */
+	uint8_t length;
+	/** Index of the filter which matched the frame. Receive only. */
+	uint8_t fmi;
+	/** Receive timestamp. Receive only. */
+	uint16_t timestamp;
+	/** Message payload data */
+	uint32_t data[64 / sizeof(uint32_t)];
+};
+
 
 /** @defgroup fdcan_error FDCAN error return values
  * @{
@@ -810,5 +847,16 @@ void fdcan_set_fifo_locked_mode(uint32_t canport, bool locked);
 uint32_t fdcan_length_to_dlc(uint8_t length);
 uint8_t fdcan_dlc_to_length(uint32_t dlc);
 
+unsigned fdcan_get_rxfifo_size(uint32_t canport, unsigned fifo_id);
+unsigned fdcan_get_txfifo_size(uint32_t canport);
+
+unsigned fdcan_rx_burst(uint32_t canport, uint8_t fifo_id,
+		struct fdcan_frame *frames, unsigned count);
+unsigned fdcan_tx_burst(uint32_t canport, const struct fdcan_frame *frames,
+		unsigned count);
+unsigned fdcan_rx_peek(uint32_t canport, uint8_t fifo_id,
+		const struct fdcan_rx_fifo_element **elements, unsigned count);
+void fdcan_rx_release(uint32_t canport, uint8_t fifo_id, unsigned count);
+
 END_DECLS
 
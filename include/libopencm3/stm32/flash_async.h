@@ -0,0 +1,122 @@
+/** @defgroup flash_async_defines Asynchronous flash engine defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the STM32 interrupt
+driven flash erase and program engine</b>
+
+@version 1.0.0
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_FLASH_ASYNC_H
+#define LIBOPENCM3_FLASH_ASYNC_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/flash.h>
+
+/**@{*/
+
+/** Place a function in RAM, see the .ramtext section of the linker script.
+ * Code that must keep running while the flash is busy, such as the
+ * interrupt handlers and the job callbacks, needs it. */
+#define FLASH_ASYNC_RAMFUNC	__attribute__((long_call, section(".ramtext")))
+
+/** @defgroup flash_async_op Asynchronous flash job operations
+@ingroup flash_async_defines
+
+@{*/
+/** Erase a sector (F2/F4/F7) or a page (F0/F1/L0/L1) */
+#define FLASH_ASYNC_ERASE		0
+/** Program a data block */
+#define FLASH_ASYNC_PROGRAM		1
+/**@}*/
+
+struct flash_async;
+struct flash_async_job;
+
+/** Job completion callback, called from the flash interrupt. It must be in
+ * RAM, see @ref FLASH_ASYNC_RAMFUNC. The job may be resubmitted from the
+ * callback. */
+typedef void (*flash_async_callback)(struct flash_async *fa,
+				     struct flash_async_job *job);
+
+/** Flash job.
+ *
+ * Owned by the caller, it and its data must stay valid until its callback
+ * has run.
+ */
+struct flash_async_job {
+	/** Operation, one of @ref flash_async_op */
+	uint8_t op;
+	/** Erase: sector number on F2/F4/F7, page address on F0/F1/L0/L1.
+	 * Program: destination address, half word aligned on F0/F1 and word
+	 * aligned on L0/L1. */
+	uint32_t address;
+	/** Data to program */
+	const uint8_t *data;
+	/** Number of bytes to program. A partial last flash word is padded
+	 * with the erased value. */
+	uint32_t len;
+	/** Completion callback, or NULL */
+	flash_async_callback callback;
+
+	/** 0 on success, or the error flags of FLASH_SR */
+	uint32_t status;
+	/** Number of bytes programmed */
+	uint32_t done;
+	/** Next job in the queue */
+	struct flash_async_job *next;
+};
+
+/** Flash job queue. */
+struct flash_async {
+	/** Widest programming word width on F2/F4/F7, one of
+	 * @ref flash_cr_program_width, also used for erasing. Ignored
+	 * elsewhere. */
+	uint32_t program_size;
+
+	/** Job in progress, followed by the queued ones */
+	struct flash_async_job *head;
+	/** Last queued job */
+	struct flash_async_job *tail;
+	/** The queue is being processed */
+	volatile bool busy;
+	/** Width of the flash word being programmed */
+	uint8_t unit;
+	/** Number of completed jobs */
+	uint32_t jobs;
+	/** Number of jobs that failed */
+	uint32_t errors;
+};
+
+BEGIN_DECLS
+
+void flash_async_init(struct flash_async *fa, uint32_t program_size);
+void flash_async_submit(struct flash_async *fa, struct flash_async_job *job);
+void flash_async_irq(struct flash_async *fa) FLASH_ASYNC_RAMFUNC;
+void flash_async_wait(struct flash_async *fa) FLASH_ASYNC_RAMFUNC;
+bool flash_async_busy(struct flash_async *fa);
+
+END_DECLS
+
+/**@}*/
+
+#endif
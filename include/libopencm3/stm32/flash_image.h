@@ -0,0 +1,84 @@
+/** @defgroup flash_image_defines Flash image writer defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the STM32 streaming
+flash image writer</b>
+
+@version 1.0.0
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_FLASH_IMAGE_H
+#define LIBOPENCM3_FLASH_IMAGE_H
+
+#include <libopencm3/cm3/common.h>
+
+/**@{*/
+
+/** @defgroup flash_image_error Flash image writer return values
+@ingroup flash_image_defines
+
+@{*/
+#define FLASH_IMAGE_E_OK		0
+/** The image does not fit the area */
+#define FLASH_IMAGE_E_SIZE		-1
+/** A flash word did not read back as written */
+#define FLASH_IMAGE_E_PROGRAM		-2
+/** The CRC of the flash content differs from the CRC of the written data */
+#define FLASH_IMAGE_E_VERIFY		-3
+/** The CRC of the written data differs from the expected one */
+#define FLASH_IMAGE_E_CRC		-4
+/**@}*/
+
+/** Streaming image writer state. */
+struct flash_image {
+	/** First address of the area, 8 byte aligned */
+	uint32_t base;
+	/** Size of the area in bytes */
+	uint32_t size;
+	/** Programming word width on F2/F4/F7, one of
+	 * @ref flash_cr_program_width. Ignored elsewhere. */
+	uint32_t program_size;
+
+	/** Number of bytes written */
+	uint32_t offset;
+	/** CRC-32 of the written bytes */
+	uint32_t crc;
+	/** First error, one of @ref flash_image_error */
+	int status;
+	/** Bytes waiting for a complete flash word */
+	uint8_t word[8];
+};
+
+BEGIN_DECLS
+
+uint32_t flash_image_crc32(uint32_t crc, const void *data, uint32_t len);
+void flash_image_begin(struct flash_image *img, uint32_t base, uint32_t size,
+		       uint32_t program_size);
+int flash_image_write(struct flash_image *img, const void *data,
+		      uint32_t len);
+int flash_image_finish(struct flash_image *img, uint32_t crc);
+
+END_DECLS
+
+/**@}*/
+
+#endif
@@ -0,0 +1,136 @@
+/** @defgroup flash_kv_defines Flash key-value store defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the STM32
+log-structured flash key-value store</b>
+
+@version 1.0.0
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_FLASH_KV_H
+#define LIBOPENCM3_FLASH_KV_H
+
+#include <libopencm3/cm3/common.h>
+
+/**@{*/
+
+/** Largest value, in bytes */
+#define FLASH_KV_MAX_LEN		0x7fff
+
+/** @defgroup flash_kv_error Flash key-value store return values
+@ingroup flash_kv_defines
+
+@{*/
+#define FLASH_KV_E_OK			0
+/** The key has no value */
+#define FLASH_KV_E_NOKEY		-1
+/** The key is out of range */
+#define FLASH_KV_E_KEY			-2
+/** The live values do not leave room for the new one */
+#define FLASH_KV_E_FULL			-3
+/** The backend failed to erase or program */
+#define FLASH_KV_E_FLASH		-4
+/** The value is longer than @ref FLASH_KV_MAX_LEN */
+#define FLASH_KV_E_SIZE			-5
+/**@}*/
+
+struct flash_kv;
+
+/** Flash area holding part of the log: one sector or page. All areas of a
+ * store should have the same size. */
+struct flash_kv_area {
+	/** First address, 8 byte aligned and never 0 */
+	uint32_t address;
+	/** Size in bytes, a multiple of 8 */
+	uint32_t size;
+	/** Erase argument: sector number on F2/F4/F7, page number on L4/G4 */
+	uint32_t erase;
+
+	/** Log sequence number, 0 while the area is erased */
+	uint32_t seq;
+	/** Next free address */
+	uint32_t end;
+};
+
+/** Storage backend.
+ *
+ * Replacing it, for instance by a RAM array with injected failures, allows
+ * running the store on a host.
+ */
+struct flash_kv_ops {
+	/** Erase an area, returns 0 on success */
+	int (*erase)(struct flash_kv *kv, const struct flash_kv_area *area);
+	/** Program 8 bytes, returns 0 on success */
+	int (*program)(struct flash_kv *kv, uint32_t address,
+		       const uint8_t *data);
+	/** Read bytes */
+	void (*read)(struct flash_kv *kv, uint32_t address, uint8_t *data,
+		     uint32_t len);
+	/** Value of an erased byte */
+	uint8_t erased;
+};
+
+/** Key-value store. */
+struct flash_kv {
+	/** Backend, see flash_kv_flash_ops */
+	const struct flash_kv_ops *ops;
+	/** Backend context */
+	void *ctx;
+	/** Areas, at least two */
+	struct flash_kv_area *areas;
+	/** Number of areas */
+	uint8_t count;
+	/** Index storage, one entry per key */
+	uint32_t *index;
+	/** Number of keys, keys are 0 to keys - 1 */
+	uint16_t keys;
+	/** Programming word width on F2/F4/F7, one of
+	 * @ref flash_cr_program_width. Ignored elsewhere. */
+	uint32_t program_size;
+
+	/** Area being written */
+	uint8_t head;
+	/** Highest sequence number */
+	uint32_t seq;
+	/** Number of areas collected */
+	uint32_t collections;
+};
+
+BEGIN_DECLS
+
+/** Backend for the internal flash, which must be unlocked. Available on
+ * F2/F4/F7/L4/G4. */
+extern const struct flash_kv_ops flash_kv_flash_ops;
+
+int flash_kv_init(struct flash_kv *kv);
+int flash_kv_get(struct flash_kv *kv, uint16_t key, void *data,
+		 uint16_t size);
+int flash_kv_set(struct flash_kv *kv, uint16_t key, const void *data,
+		 uint16_t len);
+int flash_kv_delete(struct flash_kv *kv, uint16_t key);
+int flash_kv_compact(struct flash_kv *kv);
+
+END_DECLS
+
+/**@}*/
+
+#endif
@@ -36,6 +36,8 @@
 #define SYSCFG_MEMRM			MMIO32(SYSCFG_BASE + 0x00)
 
 #define SYSCFG_PMC			MMIO32(SYSCFG_BASE + 0x04)
+/** SYSCFG configuration register 1, the reference manual name of SYSCFG_PMC */
+#define SYSCFG_CFGR1			SYSCFG_PMC
 
 /** External interrupt configuration registers [0..3] (SYSCFG_EXTICR[1..4]) */
 #define SYSCFG_EXTICR(i)		MMIO32(SYSCFG_BASE + 0x08 + (i)*4)
@@ -49,4 +51,22 @@
 
 #define SYSCFG_EXTICR_FIELDSIZE		4
 
+/** @defgroup syscfg_memrm SYSCFG_MEMRM Values
+@{*/
+/** Bank 2 mapped at 0x08000000 */
+#define SYSCFG_MEMRM_FB_MODE		(1 << 8)
+/**@}*/
+
+/** @defgroup syscfg_cfgr1 SYSCFG_CFGR1 Values
+@{*/
+#define SYSCFG_CFGR1_I2C_PB6_FMP	(1 << 16)
+#define SYSCFG_CFGR1_I2C_PB7_FMP	(1 << 17)
+#define SYSCFG_CFGR1_I2C_PB8_FMP	(1 << 18)
+#define SYSCFG_CFGR1_I2C_PB9_FMP	(1 << 19)
+#define SYSCFG_CFGR1_I2C1_FMP		(1 << 20)
+#define SYSCFG_CFGR1_I2C2_FMP		(1 << 21)
+#define SYSCFG_CFGR1_I2C3_FMP		(1 << 22)
+#define SYSCFG_CFGR1_I2C4_FMP		(1 << 23)
+/**@}*/
+
 /**@}*/
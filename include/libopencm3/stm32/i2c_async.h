@@ -0,0 +1,156 @@
+/** @defgroup i2c_async_defines I2C asynchronous master defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the STM32 I2C
+asynchronous master engine</b>
+
+@version 1.0.0
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_I2C_ASYNC_H
+#define LIBOPENCM3_I2C_ASYNC_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/i2c.h>
+
+/**@{*/
+
+/** @defgroup i2c_async_status I2C asynchronous transaction status
+@ingroup i2c_async_defines
+
+@{*/
+#define I2C_ASYNC_OK			0
+/** The slave did not acknowledge its address or a data byte */
+#define I2C_ASYNC_NACK			-1
+/** Misplaced start or stop condition on the bus */
+#define I2C_ASYNC_BUS_ERROR		-2
+/** Another master won the arbitration */
+#define I2C_ASYNC_ARB_LOST		-3
+/** The transaction did not finish in time, the bus was recovered */
+#define I2C_ASYNC_TIMEOUT		-4
+/**@}*/
+
+struct i2c_async;
+struct i2c_async_xfer;
+
+/** Transaction completion callback, called from interrupt context. The
+ * transaction may be resubmitted from the callback. */
+typedef void (*i2c_async_callback)(struct i2c_async *ia,
+				   struct i2c_async_xfer *xfer);
+
+/** I2C master transaction.
+ *
+ * A write of @p wn bytes followed by a read of @p rn bytes with a repeated
+ * start in between. Either part may be empty; a transaction with both parts
+ * empty only probes the address. Owned by the caller, it must stay valid
+ * until its callback has run.
+ */
+struct i2c_async_xfer {
+	/** 7 bit slave address */
+	uint8_t addr;
+	/** Data to write */
+	const uint8_t *w;
+	/** Number of bytes to write */
+	uint16_t wn;
+	/** Buffer for read data */
+	uint8_t *r;
+	/** Number of bytes to read */
+	uint16_t rn;
+	/** Timeout in i2c_async_tick() periods, 0 for none */
+	uint32_t timeout;
+	/** Completion callback, or NULL */
+	i2c_async_callback callback;
+
+	/** Result, one of @ref i2c_async_status */
+	int status;
+	/** Next transaction in the queue */
+	struct i2c_async_xfer *next;
+};
+
+/** I2C asynchronous master engine.
+ *
+ * The first block of members is the configuration that must be filled in by
+ * the application before i2c_async_init().
+ */
+struct i2c_async {
+	/** I2C register base address @ref i2c_reg_base */
+	uint32_t i2c;
+	/** DMA controller base address for offloading the data phases, or 0
+	 * to move data from the interrupt. Only used on I2C peripherals with
+	 * TIMINGR (F0/F3/F7/G0/G4/L0/L4). */
+	uint32_t dma;
+	/** Receive DMA stream/channel number */
+	uint8_t rx_channel;
+	/** Receive request routing: channel select on F7, CSELR request on
+	 * F0/L0/L4 or DMAMUX request on G0/G4 */
+	uint8_t rx_request;
+	/** Transmit DMA stream/channel number */
+	uint8_t tx_channel;
+	/** Transmit request routing */
+	uint8_t tx_request;
+	/** GPIO port of SCL used for bus recovery, or 0 to disable it */
+	uint32_t scl_port;
+	/** GPIO pin of SCL */
+	uint16_t scl_pin;
+	/** GPIO port of SDA */
+	uint32_t sda_port;
+	/** GPIO pin of SDA */
+	uint16_t sda_pin;
+
+	/** Transaction in progress, followed by the queued ones */
+	struct i2c_async_xfer *head;
+	/** Last queued transaction */
+	struct i2c_async_xfer *tail;
+	/** The engine is processing the queue */
+	volatile bool busy;
+	/** Current phase of the transaction in progress */
+	uint8_t phase;
+	/** Bytes moved in the current phase */
+	uint16_t pos;
+	/** Bytes of the current phase not yet programmed into NBYTES */
+	uint16_t remaining;
+	/** Status to report once the stop condition has been sent */
+	int status;
+	/** Ticks left before the transaction in progress times out */
+	uint32_t ticks;
+	/** Number of transactions that were not acknowledged */
+	uint32_t nacks;
+	/** Number of bus errors and lost arbitrations */
+	uint32_t bus_errors;
+	/** Number of timed out transactions */
+	uint32_t timeouts;
+};
+
+BEGIN_DECLS
+
+int i2c_async_init(struct i2c_async *ia);
+void i2c_async_submit(struct i2c_async *ia, struct i2c_async_xfer *xfer);
+void i2c_async_irq(struct i2c_async *ia);
+void i2c_async_tick(struct i2c_async *ia);
+bool i2c_async_busy(struct i2c_async *ia);
+void i2c_async_bus_recover(struct i2c_async *ia);
+
+END_DECLS
+
+/**@}*/
+
+#endif
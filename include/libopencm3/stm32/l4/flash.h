@@ -233,6 +233,12 @@ void flash_program(uint32_t address, uint8_t *data, uint32_t len);
 void flash_erase_page(uint32_t page);
 void flash_erase_all_pages(void);
 void flash_program_option_bytes(uint32_t data);
+bool flash_is_dual_bank(void);
+uint32_t flash_bank_size(void);
+uint8_t flash_bank_active(void);
+void flash_erase_bank(uint8_t bank);
+bool flash_bank_swap_get(void);
+void flash_bank_swap_set(bool swap);
 
 END_DECLS
 
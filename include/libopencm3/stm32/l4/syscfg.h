@@ -57,6 +57,8 @@
 #define SYSCFG_MEMRMP_MEM_MODE_FMC	2
 #define SYSCFG_MEMRMP_MEM_MODE_SRAM	3
 #define SYSCFG_MEMRMP_MEM_MODE_QSPI	6
+/* Bank 2 mapped at 0x08000000 */
+#define SYSCFG_MEMRMP_FB_MODE		(1 << 8)
 
 /* --- SYSCFG_CFGR1 Values ------------------------------------------------- */
 
@@ -0,0 +1,130 @@
+/** @defgroup pwr_idle_defines Tickless idle defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the STM32 tickless
+low power idle manager</b>
+
+@version 1.0.0
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_PWR_IDLE_H
+#define LIBOPENCM3_PWR_IDLE_H
+
+#include <libopencm3/cm3/common.h>
+
+/**@{*/
+
+/** @defgroup pwr_idle_mode Tickless idle modes
+@ingroup pwr_idle_defines
+
+Ordered from the lightest to the deepest.
+@{*/
+/** Sleep, the tick keeps running */
+#define PWR_IDLE_SLEEP			0
+/** Stop with the main regulator on */
+#define PWR_IDLE_STOP			1
+/** Stop with the regulator in low power mode */
+#define PWR_IDLE_STOP_LP		2
+/**@}*/
+
+/** Wakeup timer backend. */
+struct pwr_idle_ops {
+	/** Arm a wakeup interrupt after the given number of counts */
+	void (*start)(void *ctx, uint32_t counts);
+	/** Disarm the wakeup, returns the counts elapsed since start */
+	uint32_t (*stop)(void *ctx);
+};
+
+/** Tickless idle manager. */
+struct pwr_idle {
+	/** Wakeup timer backend, see pwr_idle_lptim_init() and
+	 * pwr_idle_rtc_init() */
+	const struct pwr_idle_ops *ops;
+	/** Backend context */
+	void *ctx;
+	/** Wakeup timer counts per second */
+	uint32_t timer_freq;
+	/** Longest wakeup timer delay in counts */
+	uint32_t timer_max;
+	/** SysTick interrupts per second */
+	uint32_t tick_freq;
+	/** Wakeup latency of @ref PWR_IDLE_STOP in us, including the clock
+	 * restore */
+	uint32_t stop_latency;
+	/** Wakeup latency of @ref PWR_IDLE_STOP_LP in us, including the clock
+	 * restore */
+	uint32_t stop_lp_latency;
+	/** Restore the clocks after stop mode, which leaves SYSCLK on the
+	 * reset oscillator, or NULL */
+	void (*restore)(void);
+
+	/** Tick count */
+	volatile uint32_t ticks;
+	/** Timer time not yet counted as ticks, in counts * tick_freq */
+	uint32_t residue;
+	/** Wakeup latency allowed by the drivers in us */
+	uint32_t latency_limit;
+	/** Number of drivers preventing stop mode */
+	uint16_t stop_inhibit;
+	/** Number of times each mode was entered */
+	uint32_t entries[3];
+};
+
+/** LPTIM wakeup timer state, see pwr_idle_lptim_init() */
+struct pwr_idle_lptim {
+	/** LPTIM base address */
+	uint32_t lptim;
+	/** Counter value at start */
+	uint16_t start;
+};
+
+/** RTC wakeup timer state, see pwr_idle_rtc_init() */
+struct pwr_idle_rtc {
+	/** Synchronous prescaler + 1: counts per second */
+	uint32_t sync;
+	/** Wakeup timer clock selection */
+	uint8_t wucksel;
+	/** Wakeup timer periods per count */
+	uint32_t wut_per_count;
+	/** Time stamp at start, in counts since midnight */
+	uint32_t start;
+};
+
+BEGIN_DECLS
+
+void pwr_idle_init(struct pwr_idle *idle);
+void pwr_idle_tick(struct pwr_idle *idle);
+uint32_t pwr_idle_ticks(struct pwr_idle *idle);
+void pwr_idle_set_latency(struct pwr_idle *idle, uint32_t us);
+void pwr_idle_stop_inhibit(struct pwr_idle *idle);
+void pwr_idle_stop_allow(struct pwr_idle *idle);
+uint8_t pwr_idle_enter(struct pwr_idle *idle, uint32_t idle_ticks);
+void pwr_idle_lptim_init(struct pwr_idle *idle, struct pwr_idle_lptim *lp,
+			 uint32_t lptim, uint32_t freq);
+void pwr_idle_rtc_init(struct pwr_idle *idle, struct pwr_idle_rtc *rtc,
+		       uint32_t rtcclk);
+
+END_DECLS
+
+/**@}*/
+
+#endif
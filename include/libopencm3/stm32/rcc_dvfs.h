@@ -0,0 +1,115 @@
+/** @defgroup rcc_dvfs_defines Clock switching defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the STM32 runtime
+clock switching service</b>
+
+@version 1.0.0
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_RCC_DVFS_H
+#define LIBOPENCM3_RCC_DVFS_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/i2c.h>
+
+/**@{*/
+
+/** @defgroup rcc_dvfs_event Clock change events
+@ingroup rcc_dvfs_defines
+
+@{*/
+/** The clocks are about to change: finish or hold transfers */
+#define RCC_DVFS_PRE			0
+/** The clocks have changed: rcc_ahb_frequency and the APB frequencies hold
+ * the new values, recompute the dividers */
+#define RCC_DVFS_POST			1
+/**@}*/
+
+struct rcc_dvfs_notifier;
+
+/** Clock change callback, called from rcc_dvfs_switch() with one of
+ * @ref rcc_dvfs_event */
+typedef void (*rcc_dvfs_callback)(struct rcc_dvfs_notifier *nb,
+				  uint8_t event);
+
+/** Clock change notifier, owned by the driver. It may be embedded at the
+ * start of a larger structure holding the driver settings. */
+struct rcc_dvfs_notifier {
+	/** Called before and after each clock change */
+	rcc_dvfs_callback callback;
+
+	/** Next registered notifier */
+	struct rcc_dvfs_notifier *next;
+};
+
+/** Notifier keeping a USART baud rate, see rcc_dvfs_usart_register() */
+struct rcc_dvfs_usart {
+	struct rcc_dvfs_notifier nb;
+	/** USART base address */
+	uint32_t usart;
+	/** Baud rate */
+	uint32_t baud;
+};
+
+/** Notifier keeping the SysTick rate, see rcc_dvfs_systick_register() */
+struct rcc_dvfs_systick {
+	struct rcc_dvfs_notifier nb;
+	/** Interrupt frequency in Hz */
+	uint32_t freq;
+};
+
+/** Notifier keeping the timebase, see rcc_dvfs_timebase_register() */
+struct rcc_dvfs_timebase {
+	struct rcc_dvfs_notifier nb;
+	/** SysTick interrupt frequency in Hz, 0 for the cycle counter */
+	uint32_t tick_freq;
+};
+
+/** Notifier keeping an I2C bus speed, see rcc_dvfs_i2c_register() */
+struct rcc_dvfs_i2c {
+	struct rcc_dvfs_notifier nb;
+	/** I2C base address */
+	uint32_t i2c;
+	/** Bus speed */
+	enum i2c_speeds speed;
+};
+
+BEGIN_DECLS
+
+void rcc_dvfs_register(struct rcc_dvfs_notifier *nb);
+void rcc_dvfs_unregister(struct rcc_dvfs_notifier *nb);
+void rcc_dvfs_switch(const struct rcc_clock_scale *clock);
+void rcc_dvfs_usart_register(struct rcc_dvfs_usart *n, uint32_t usart,
+			     uint32_t baud);
+void rcc_dvfs_systick_register(struct rcc_dvfs_systick *n, uint32_t freq);
+void rcc_dvfs_i2c_register(struct rcc_dvfs_i2c *n, uint32_t i2c,
+			   enum i2c_speeds speed);
+void rcc_dvfs_timebase_register(struct rcc_dvfs_timebase *n,
+				uint32_t tick_freq);
+
+END_DECLS
+
+/**@}*/
+
+#endif
@@ -0,0 +1,118 @@
+/** @defgroup spi_dma_defines SPI DMA transfer engine defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the STM32 SPI DMA
+transfer engine</b>
+
+@version 1.0.0
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_SPI_DMA_H
+#define LIBOPENCM3_SPI_DMA_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/spi.h>
+#include <libopencm3/stm32/dma_mgr.h>
+
+/**@{*/
+
+struct spi_dma;
+struct spi_dma_xfer;
+
+/** Transaction completion callback.
+ *
+ * Called from interrupt context, or from spi_dma_submit() for transactions
+ * that are executed without DMA. The transaction may be resubmitted from the
+ * callback.
+ */
+typedef void (*spi_dma_callback)(struct spi_dma *sd, struct spi_dma_xfer *xfer);
+
+/** SPI transaction.
+ *
+ * Owned by the caller, it must stay valid until its callback has run.
+ */
+struct spi_dma_xfer {
+	/** Data to send, or NULL to send 0xff */
+	const uint8_t *tx;
+	/** Buffer for received data, or NULL to discard it */
+	uint8_t *rx;
+	/** Number of bytes to transfer */
+	uint16_t len;
+	/** GPIO port of the active low chip select, or 0 for none */
+	uint32_t cs_port;
+	/** GPIO pin of the chip select */
+	uint16_t cs_pin;
+	/** Completion callback, or NULL */
+	spi_dma_callback callback;
+
+	/** 0 on success, negative if the transfer was aborted by a DMA
+	 * error */
+	int status;
+	/** Next transaction in the queue */
+	struct spi_dma_xfer *next;
+};
+
+/** SPI DMA transfer engine.
+ *
+ * The first block of members is the configuration that must be filled in by
+ * the application before spi_dma_init(). Both DMA streams/channels must
+ * belong to the same controller.
+ */
+struct spi_dma {
+	/** SPI peripheral identifier @ref spi_reg_base */
+	uint32_t spi;
+	/** DMA controller base address: DMA1 or DMA2 */
+	uint32_t dma;
+	/** Receive DMA stream (F2/F4/F7) or channel number */
+	uint8_t rx_channel;
+	/** Receive request routing: channel select on F2/F4/F7, CSELR request
+	 * on F0/L0/L4 or DMAMUX request on G0/G4 */
+	uint8_t rx_request;
+	/** Transmit DMA stream or channel number */
+	uint8_t tx_channel;
+	/** Transmit request routing */
+	uint8_t tx_request;
+	/** Transactions shorter than this are executed with spi_transfer()
+	 * instead of DMA */
+	uint16_t dma_threshold;
+
+	/** Transaction in progress, followed by the queued ones */
+	struct spi_dma_xfer *head;
+	/** Last queued transaction */
+	struct spi_dma_xfer *tail;
+	/** The engine is processing the queue */
+	volatile bool busy;
+	/** Number of DMA transfer errors */
+	uint32_t dma_errors;
+};
+
+BEGIN_DECLS
+
+int spi_dma_init(struct spi_dma *sd);
+void spi_dma_submit(struct spi_dma *sd, struct spi_dma_xfer *xfer);
+bool spi_dma_busy(struct spi_dma *sd);
+
+END_DECLS
+
+/**@}*/
+
+#endif
@@ -0,0 +1,166 @@
+/** @defgroup usart_dma_defines USART DMA streaming defines
+
+@ingroup STM32F_defines
+
+@brief <b>libopencm3 Defined Constants and Types for the STM32 USART DMA
+streaming layer</b>
+
+@version 1.0.0
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBOPENCM3_USART_DMA_H
+#define LIBOPENCM3_USART_DMA_H
+
+#include <libopencm3/cm3/common.h>
+#include <libopencm3/stm32/usart.h>
+#include <libopencm3/stm32/dma_mgr.h>
+
+/**@{*/
+
+/** @defgroup usart_dma_rx_event USART DMA receive events
+@ingroup usart_dma_defines
+
+Reason for handing a span of received data to the application.
+@{*/
+/** The DMA reached the middle of the ring buffer */
+#define USART_DMA_RX_EVENT_HALF		(1 << 0)
+/** The DMA reached the end of the ring buffer */
+#define USART_DMA_RX_EVENT_FULL		(1 << 1)
+/** The line went idle, the span ends a frame */
+#define USART_DMA_RX_EVENT_IDLE		(1 << 2)
+/**@}*/
+
+struct usart_dma_rx;
+
+/** Receive callback.
+ *
+ * @param rx the receiver that produced the data
+ * @param data pointer into the ring buffer, valid until the DMA wraps around
+ * @param len number of contiguous bytes at @p data
+ * @param events bitwise OR of @ref usart_dma_rx_event
+ */
+typedef void (*usart_dma_rx_callback)(struct usart_dma_rx *rx,
+				      const uint8_t *data, uint16_t len,
+				      uint32_t events);
+
+/** Circular DMA receiver.
+ *
+ * The first block of members is the configuration and must be filled in by
+ * the application before usart_dma_rx_start(), the remaining members are
+ * private state.
+ */
+struct usart_dma_rx {
+	/** USART block register address base @ref usart_reg_base */
+	uint32_t usart;
+	/** DMA controller base address: DMA1 or DMA2 */
+	uint32_t dma;
+	/** DMA stream (F2/F4/F7) or channel number */
+	uint8_t channel;
+	/** Channel select on F2/F4/F7, CSELR request on F0/L0/L4 or DMAMUX
+	 * request on G0/G4. Ignored on the other families. */
+	uint8_t request;
+	/** Ring buffer, must be accessible by the DMA controller */
+	uint8_t *buf;
+	/** Size of the ring buffer in bytes */
+	uint16_t size;
+	/** Called from usart_dma_rx_irq() or the DMA interrupt with received
+	 * spans, in order and never reentered, whatever the priorities of the
+	 * two interrupts. When NULL the application polls with
+	 * usart_dma_rx_peek(). */
+	usart_dma_rx_callback callback;
+
+	/** Read position in the ring buffer */
+	uint16_t tail;
+	/** Events waiting for the running delivery */
+	uint32_t pending;
+	/** A context is delivering spans to the callback */
+	bool delivering;
+	/** Number of completed frames (idle line events) */
+	uint32_t frames;
+	/** Number of receiver overruns */
+	uint32_t overruns;
+	/** Number of DMA transfer errors */
+	uint32_t dma_errors;
+};
+
+struct usart_dma_tx;
+
+/** Transmit completion callback.
+ *
+ * @param tx the transmitter
+ * @param data the buffer that was passed to usart_dma_tx_write()
+ * @param len its length
+ */
+typedef void (*usart_dma_tx_callback)(struct usart_dma_tx *tx,
+				      const uint8_t *data, uint16_t len);
+
+/** Queued transmit buffer */
+struct usart_dma_tx_buf {
+	const uint8_t *data;
+	uint16_t len;
+	usart_dma_tx_callback callback;
+};
+
+/** DMA transmit queue.
+ *
+ * As for the receiver, the first block of members is the configuration that
+ * must be filled in by the application before usart_dma_tx_init().
+ */
+struct usart_dma_tx {
+	/** USART block register address base @ref usart_reg_base */
+	uint32_t usart;
+	/** DMA controller base address: DMA1 or DMA2 */
+	uint32_t dma;
+	/** DMA stream (F2/F4/F7) or channel number */
+	uint8_t channel;
+	/** Request routing, see struct usart_dma_rx */
+	uint8_t request;
+	/** Storage for the queued buffers */
+	struct usart_dma_tx_buf *queue;
+	/** Number of entries in @p queue */
+	uint8_t queue_len;
+
+	/** Index of the buffer being transmitted */
+	uint8_t head;
+	/** Number of queued buffers, including the one being transmitted */
+	volatile uint8_t count;
+	/** Number of DMA transfer errors */
+	uint32_t dma_errors;
+};
+
+BEGIN_DECLS
+
+int usart_dma_rx_start(struct usart_dma_rx *rx);
+void usart_dma_rx_stop(struct usart_dma_rx *rx);
+void usart_dma_rx_irq(struct usart_dma_rx *rx);
+uint16_t usart_dma_rx_peek(struct usart_dma_rx *rx, const uint8_t **data);
+void usart_dma_rx_consume(struct usart_dma_rx *rx, uint16_t len);
+
+int usart_dma_tx_init(struct usart_dma_tx *tx);
+bool usart_dma_tx_write(struct usart_dma_tx *tx, const uint8_t *data,
+			uint16_t len, usart_dma_tx_callback callback);
+bool usart_dma_tx_busy(struct usart_dma_tx *tx);
+
+END_DECLS
+
+/**@}*/
+
+#endif
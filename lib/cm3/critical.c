@@ -0,0 +1,170 @@
+/** @defgroup CM3_critical_file Critical sections
+ *
+ * @ingroup CM3_files
+ *
+ * @brief <b>libopencm3 Cortex-M priority ceiling critical sections</b>
+ *
+ * Backs CM_CRITICAL_BLOCK() and CM_CRITICAL_CONTEXT(). Without a ceiling, or
+ * on ARMv6-M, a critical section sets PRIMASK. With a ceiling, it raises
+ * BASEPRI to it, so nested sections and sections entered from interrupt
+ * handlers only ever mask more.
+ *
+ * The ceiling uses the priority format of nvic_set_priority(): with
+ * 4 priority bits, a ceiling of 0x40 masks priorities 0x40 to 0xf0 and
+ * leaves 0x00 to 0x30 running.
+ *
+ * LGPL License Terms @ref lgpl_license
+ * @{
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || \
+	defined(__ARM_ARCH_8M_MAIN__)
+#define CM_CRITICAL_HAS_BASEPRI
+#endif
+
+/* Marks a state saved from BASEPRI rather than PRIMASK. */
+#define CM_CRITICAL_BASEPRI	(1U << 31)
+
+static uint8_t cm_irq_ceiling;
+static uint32_t cm_critical_depth;
+static bool cm_critical_measuring;
+static bool cm_critical_timed;
+static uint32_t cm_critical_start;
+static uint32_t cm_critical_max;
+
+/*---------------------------------------------------------------------------*/
+/** @brief Cortex M Set Interrupt Priority Ceiling
+ *
+ * Must be called outside of critical sections, typically once at startup.
+ * Ignored on ARMv6-M, which has no BASEPRI.
+ *
+ * @param[in] priority Highest priority masked by critical sections, 0 to
+ * mask all interrupts
+ */
+void cm_set_irq_ceiling(uint8_t priority)
+{
+#if defined(CM_CRITICAL_HAS_BASEPRI)
+	cm_irq_ceiling = priority;
+#else
+	(void)priority;
+#endif
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Cortex M Get Interrupt Priority Ceiling
+ *
+ * @returns Ceiling, 0 if critical sections mask all interrupts
+ */
+uint8_t cm_get_irq_ceiling(void)
+{
+	return cm_irq_ceiling;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Cortex M Enter Critical Section
+ *
+ * @returns State to pass to cm_critical_exit()
+ */
+uint32_t cm_critical_enter(void)
+{
+	uint32_t state;
+
+#if defined(CM_CRITICAL_HAS_BASEPRI)
+	if (cm_irq_ceiling) {
+		state = CM_CRITICAL_BASEPRI | cm_get_basepri();
+		cm_raise_basepri(cm_irq_ceiling);
+	} else {
+		state = cm_mask_interrupts(true);
+	}
+#else
+	state = cm_mask_interrupts(true);
+#endif
+
+	if (cm_critical_depth++ == 0 && cm_critical_measuring) {
+		cm_critical_timed = true;
+		cm_critical_start = dwt_read_cycle_counter();
+	}
+	return state;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Cortex M Exit Critical Section
+ *
+ * @param[in] state Value returned by the matching cm_critical_enter()
+ */
+void cm_critical_exit(uint32_t state)
+{
+	uint32_t cycles;
+
+	if (--cm_critical_depth == 0 && cm_critical_timed) {
+		cm_critical_timed = false;
+		cycles = dwt_read_cycle_counter() - cm_critical_start;
+		if (cycles > cm_critical_max) {
+			cm_critical_max = cycles;
+		}
+	}
+
+#if defined(CM_CRITICAL_HAS_BASEPRI)
+	if (state & CM_CRITICAL_BASEPRI) {
+		cm_set_basepri(state & ~CM_CRITICAL_BASEPRI);
+		return;
+	}
+#endif
+	cm_mask_interrupts(state);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Cortex M Measure Critical Sections
+ *
+ * Start or stop tracking the longest critical section. Starting resets the
+ * maximum.
+ *
+ * @param[in] enable true to start, false to stop
+ * @returns false if the DWT cycle counter is not available
+ */
+bool cm_critical_measure(bool enable)
+{
+	if (enable && !dwt_enable_cycle_counter()) {
+		return false;
+	}
+
+	CM_ATOMIC_BLOCK() {
+		cm_critical_max = 0;
+		cm_critical_measuring = enable;
+	}
+	return true;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Cortex M Longest Critical Section
+ *
+ * Only sections entered outside of any other one are timed, so the result
+ * covers the nested ones.
+ *
+ * @returns Longest critical section in core cycles since measuring started
+ */
+uint32_t cm_critical_max_cycles(void)
+{
+	return cm_critical_max;
+}
+
+/**@}*/
@@ -17,6 +17,8 @@
  * along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+#include <libopencm3/cm3/cortex.h>
 #include <libopencm3/cm3/sync.h>
 
 /* DMB is supported on CM0 */
@@ -77,3 +79,218 @@ void mutex_unlock(mutex_t *m)
 }
 
 #endif
+
+/* --- Atomic operations --------------------------------------------------- */
+
+/* returns the previous value */
+uint32_t sync_fetch_add(volatile uint32_t *addr, uint32_t val)
+{
+	uint32_t old;
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+	do {
+		old = __ldrex(addr);
+	} while (__strex(old + val, addr));
+#else
+	CM_ATOMIC_BLOCK() {
+		old = *addr;
+		*addr = old + val;
+	}
+#endif
+	__dmb();
+	return old;
+}
+
+/* returns the previous value */
+uint32_t sync_exchange(volatile uint32_t *addr, uint32_t val)
+{
+	uint32_t old;
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+	do {
+		old = __ldrex(addr);
+	} while (__strex(val, addr));
+#else
+	CM_ATOMIC_BLOCK() {
+		old = *addr;
+		*addr = val;
+	}
+#endif
+	__dmb();
+	return old;
+}
+
+/* returns true if *addr held expected and was replaced */
+bool sync_cas(volatile uint32_t *addr, uint32_t expected, uint32_t desired)
+{
+	bool ok = false;
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+	do {
+		if (__ldrex(addr) != expected) {
+			/* Drop the exclusive monitor. */
+			__asm__ volatile ("clrex");
+			break;
+		}
+		ok = !__strex(desired, addr);
+	} while (!ok);
+#else
+	CM_ATOMIC_BLOCK() {
+		if (*addr == expected) {
+			*addr = desired;
+			ok = true;
+		}
+	}
+#endif
+	__dmb();
+	return ok;
+}
+
+/* --- Single producer, single consumer ring ------------------------------- */
+
+/* head and tail run freely, the fill level is their difference. */
+
+void sync_spsc_init(struct sync_spsc *r, void *buf, uint32_t count,
+		    uint16_t elem_size)
+{
+	r->buf = buf;
+	r->mask = count - 1;
+	r->elem_size = elem_size;
+	r->head = 0;
+	r->tail = 0;
+}
+
+/* returns false if the ring is full */
+bool sync_spsc_push(struct sync_spsc *r, const void *elem)
+{
+	uint32_t head = r->head;
+
+	if (head - r->tail > r->mask) {
+		return false;
+	}
+	memcpy(r->buf + (head & r->mask) * r->elem_size, elem, r->elem_size);
+
+	/* Publish the element after writing it. */
+	__dmb();
+	r->head = head + 1;
+	return true;
+}
+
+/* returns false if the ring is empty */
+bool sync_spsc_pop(struct sync_spsc *r, void *elem)
+{
+	uint32_t tail = r->tail;
+
+	if (r->head == tail) {
+		return false;
+	}
+	__dmb();
+	memcpy(elem, r->buf + (tail & r->mask) * r->elem_size, r->elem_size);
+
+	/* Free the slot after reading it. */
+	__dmb();
+	r->tail = tail + 1;
+	return true;
+}
+
+uint32_t sync_spsc_count(struct sync_spsc *r)
+{
+	return r->head - r->tail;
+}
+
+/* --- Multiple producer, single consumer ring ----------------------------- */
+
+/* Slot i is free for position p when seq[i] == p, and holds the element of
+ * position p when seq[i] == p + 1. */
+
+void sync_mpsc_init(struct sync_mpsc *r, void *buf, volatile uint32_t *seq,
+		    uint32_t count, uint16_t elem_size)
+{
+	uint32_t i;
+
+	r->buf = buf;
+	r->seq = seq;
+	r->mask = count - 1;
+	r->elem_size = elem_size;
+	r->head = 0;
+	r->tail = 0;
+	for (i = 0; i < count; i++) {
+		seq[i] = i;
+	}
+}
+
+/* returns false if the ring is full */
+bool sync_mpsc_push(struct sync_mpsc *r, const void *elem)
+{
+	uint32_t pos, slot;
+	int32_t diff;
+
+	for (;;) {
+		pos = r->head;
+		slot = pos & r->mask;
+		diff = (int32_t)(r->seq[slot] - pos);
+		if (diff < 0) {
+			return false;
+		}
+		/* diff > 0: another producer took pos, reload. */
+		if (diff == 0 && sync_cas(&r->head, pos, pos + 1)) {
+			break;
+		}
+	}
+
+	memcpy(r->buf + slot * r->elem_size, elem, r->elem_size);
+	__dmb();
+	r->seq[slot] = pos + 1;
+	return true;
+}
+
+/* returns false if the ring is empty, or the oldest element is still being
+ * written by a preempted producer */
+bool sync_mpsc_pop(struct sync_mpsc *r, void *elem)
+{
+	uint32_t pos = r->tail;
+	uint32_t slot = pos & r->mask;
+
+	if (r->seq[slot] != pos + 1) {
+		return false;
+	}
+	__dmb();
+	memcpy(elem, r->buf + slot * r->elem_size, r->elem_size);
+	__dmb();
+	r->seq[slot] = pos + r->mask + 1;
+	r->tail = pos + 1;
+	return true;
+}
+
+/* --- Sequence lock -------------------------------------------------------- */
+
+/* The sequence is odd while a write is in progress. */
+
+void sync_seqlock_write_begin(struct sync_seqlock *sl)
+{
+	sl->seq++;
+	__dmb();
+}
+
+void sync_seqlock_write_end(struct sync_seqlock *sl)
+{
+	__dmb();
+	sl->seq++;
+}
+
+uint32_t sync_seqlock_read_begin(struct sync_seqlock *sl)
+{
+	uint32_t seq;
+
+	while ((seq = sl->seq) & 1);
+	__dmb();
+	return seq;
+}
+
+/* returns true if the data read since sync_seqlock_read_begin() may be
+ * inconsistent and must be read again */
+bool sync_seqlock_read_retry(struct sync_seqlock *sl, uint32_t seq)
+{
+	__dmb();
+	return sl->seq != seq;
+}
@@ -0,0 +1,436 @@
+/** @defgroup CM3_timebase_file Timebase
+ *
+ * @ingroup CM3_files
+ *
+ * @brief <b>libopencm3 Cortex-M 64 bit monotonic timebase</b>
+ *
+ * Extends a hardware counter to a 64 bit time that never wraps in practice
+ * and can be read from any context, including interrupt handlers.
+ *
+ * timebase_update() adds the counts elapsed since the previous update,
+ * modulo the counter period, to a 64 bit total. It must run at least once
+ * per period, from one context only: a periodic interrupt is the usual
+ * place. A read adds the counts elapsed since the last update to its total.
+ *
+ * SysTick wraps every tick, too often for that: its handler counts the
+ * periods instead, and a read adds the current count to them. The counter
+ * has already wrapped when the handler runs, so a read from a handler that
+ * preempts the SysTick handler before timebase_systick_tick() is one period
+ * late. The time is monotonic for all other readers; handlers of a higher
+ * priority than SysTick that need it should use the cycle counter or a
+ * timer.
+ *
+ * The time is counted at the frequency given at initialisation. When the
+ * counter clock changes, e.g. with the system clock, timebase_set_frequency()
+ * counts the time so far at the old frequency and scales the counts that
+ * follow, so the time stays continuous. timebase_advance() adds time during
+ * which the counter was stopped, such as stop mode.
+ *
+ * Reads never mask interrupts, so handlers above the critical section
+ * ceiling can take timestamps without being delayed. The writer publishes
+ * the total in one of two copies and then bumps a sequence number; a read
+ * uses the copy the sequence selects and starts again if it changed
+ * meanwhile. A read that preempts the writer sees the previous copy and
+ * never waits for it.
+ *
+ * Usual counters:
+ * * the DWT cycle counter (ARMv7-M), with core clock resolution and a 32 bit
+ *   period of seconds, see timebase_init_cycles()
+ * * SysTick, whose period is one tick, see timebase_init_systick()
+ * * a free running 32 bit timer such as TIM2 or TIM5 of the STM32, whose
+ *   counter register is returned by a user read function
+ *
+ * LGPL License Terms @ref lgpl_license
+ * @{
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/dwt.h>
+#include <libopencm3/cm3/scb.h>
+#include <libopencm3/cm3/sync.h>
+#include <libopencm3/cm3/systick.h>
+#include <libopencm3/cm3/timebase.h>
+
+/*
+ * Total at the last update, the counter value it was taken at, and the
+ * counter setup. Counts are scaled to the time by a 32.32 fixed point factor,
+ * 0 while the counter runs at the time frequency; frac carries the fraction
+ * of a count of the time.
+ */
+struct timebase_copy {
+	uint64_t total;
+	uint64_t scale;
+	uint32_t frac;
+	uint32_t last;
+	uint32_t max;
+	/* SysTick: the pending period is already in the total. */
+	bool skip;
+};
+
+static timebase_read_t timebase_read;
+static uint32_t timebase_freq;
+static bool timebase_systick;
+static struct timebase_copy timebase_copies[2];
+/* The low bit selects the current copy. */
+static volatile uint32_t timebase_seq;
+
+/* Counts from the last update to count, at most one period later. */
+static uint32_t timebase_elapsed(const struct timebase_copy *c, uint32_t count)
+{
+	if (count >= c->last) {
+		return count - c->last;
+	}
+	/* Wrapped; for a 32 bit counter max + 1 is 0. */
+	return count - c->last + c->max + 1;
+}
+
+/* Counter counts to time, carrying the fraction in c. */
+static uint64_t timebase_scale(struct timebase_copy *c, uint32_t counts)
+{
+	uint64_t lo;
+
+	if (!c->scale) {
+		return counts;
+	}
+	lo = (uint64_t)counts * (uint32_t)c->scale + c->frac;
+	c->frac = lo;
+	return (uint64_t)counts * (uint32_t)(c->scale >> 32) + (lo >> 32);
+}
+
+static struct timebase_copy *timebase_current(void)
+{
+	return &timebase_copies[timebase_seq & 1];
+}
+
+/* Make a new total current. Only one context may write. */
+static void timebase_publish(const struct timebase_copy *c)
+{
+	timebase_copies[(timebase_seq + 1) & 1] = *c;
+	__dmb();
+	timebase_seq++;
+}
+
+/* SysTick as an up counter for a period of max + 1 counts. */
+static uint32_t timebase_systick_count(uint32_t max)
+{
+	uint32_t value = systick_get_value();
+
+	return value ? max + 1 - value : 0;
+}
+
+/* Counts on SysTick since the period counted by the handler, plus a period
+ * if the counter wrapped, the handler has not run yet and the period is not
+ * in the total already. */
+static uint32_t timebase_systick_elapsed(const struct timebase_copy *c)
+{
+	uint32_t before, count;
+	bool pending;
+
+	before = timebase_systick_count(c->max);
+	pending = SCB_ICSR & SCB_ICSR_PENDSTSET;
+	count = timebase_systick_count(c->max);
+	if ((pending || count < before) && !c->skip) {
+		return c->max + 1 + count;
+	}
+	return count;
+}
+
+/*
+ * Count the time up to now with the current setup, then restart counting
+ * with the given counts scale and the SysTick reload value.
+ */
+static void timebase_rebase(uint64_t scale, uint64_t add)
+{
+	struct timebase_copy c = *timebase_current();
+	uint32_t count;
+
+	if (timebase_systick) {
+		c.total += timebase_scale(&c, timebase_systick_elapsed(&c));
+		systick_clear();
+		/* Keep the handler from counting a wrap counted above. */
+		c.skip = SCB_ICSR & SCB_ICSR_PENDSTSET;
+		c.last = 0;
+		c.max = systick_get_reload();
+	} else {
+		count = timebase_read();
+		c.total += timebase_scale(&c, timebase_elapsed(&c, count));
+		c.last = count;
+	}
+	c.total += add;
+	c.scale = scale;
+	timebase_publish(&c);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timebase Initialize
+ *
+ * Start the time at 0.
+ *
+ * @param[in] read Counter read function
+ * @param[in] max Largest counter value, UINT32_MAX for a 32 bit counter
+ * @param[in] freq Counter frequency in Hz, also the frequency of the time
+ */
+void timebase_init(timebase_read_t read, uint32_t max, uint32_t freq)
+{
+	struct timebase_copy c = {
+		.max = max,
+	};
+
+	CM_ATOMIC_CONTEXT();
+
+	timebase_read = read;
+	timebase_freq = freq;
+	timebase_systick = false;
+	c.last = read();
+	timebase_publish(&c);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timebase Initialize on the Cycle Counter
+ *
+ * Enable the DWT cycle counter and use it as counter.
+ *
+ * @param[in] freq Core clock frequency in Hz
+ * @returns false if the cycle counter is not implemented.
+ */
+bool timebase_init_cycles(uint32_t freq)
+{
+	if (!dwt_enable_cycle_counter()) {
+		return false;
+	}
+	timebase_init(dwt_read_cycle_counter, UINT32_MAX, freq);
+	return true;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timebase Initialize on SysTick
+ *
+ * Use the SysTick counter, which must be configured and running with its
+ * interrupt enabled. The SysTick handler must call timebase_systick_tick()
+ * before anything else reading the time.
+ *
+ * @param[in] freq SysTick clock frequency in Hz (AHB or AHB / 8)
+ */
+void timebase_init_systick(uint32_t freq)
+{
+	struct timebase_copy c = {
+		.max = systick_get_reload(),
+	};
+
+	timebase_init(timebase_read_systick, c.max, freq);
+	CM_ATOMIC_BLOCK() {
+		timebase_publish(&c);
+		timebase_systick = true;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timebase SysTick Period
+ *
+ * Count one SysTick period. Call it first in the SysTick handler: the
+ * counter has already wrapped, and a read from a handler that preempts the
+ * SysTick handler before this call still misses the new period.
+ */
+void timebase_systick_tick(void)
+{
+	struct timebase_copy c = *timebase_current();
+
+	if (c.skip) {
+		c.skip = false;
+	} else {
+		c.total += timebase_scale(&c, c.max + 1);
+	}
+	timebase_publish(&c);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timebase Update
+ *
+ * Add the counts elapsed since the last update to the total. Call it at
+ * least once per counter period, always from the same context, such as a
+ * periodic interrupt. Not needed on SysTick, where timebase_systick_tick()
+ * keeps the total.
+ */
+void timebase_update(void)
+{
+	struct timebase_copy c = *timebase_current();
+	uint32_t count;
+
+	if (timebase_systick) {
+		return;
+	}
+	count = timebase_read();
+	c.total += timebase_scale(&c, timebase_elapsed(&c, count));
+	c.last = count;
+	timebase_publish(&c);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timebase Set Counter Frequency
+ *
+ * Call right after the counter clock changed, e.g. from a clock change
+ * notifier. The time so far is counted at the old frequency, and the
+ * following counts are scaled to the frequency given at initialisation.
+ *
+ * On SysTick, set the reload value for the new clock first and call this
+ * instead of systick_clear(): the current period is counted with the old
+ * reload value and the counter restarts.
+ *
+ * Does nothing before the timebase is initialised.
+ *
+ * @param[in] freq New counter frequency in Hz
+ */
+void timebase_set_frequency(uint32_t freq)
+{
+	uint64_t scale = 0;
+
+	if (!timebase_read || !freq) {
+		return;
+	}
+	if (freq != timebase_freq) {
+		scale = ((uint64_t)timebase_freq << 32) / freq;
+	}
+
+	CM_ATOMIC_BLOCK() {
+		timebase_rebase(scale, 0);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timebase Advance
+ *
+ * Add time during which the counter was stopped, e.g. measured by a wakeup
+ * timer across stop mode, where SysTick and the cycle counter stop with the
+ * core clock. Must not be used for a counter that kept running. On SysTick,
+ * call it with the counter stopped; it counts the current period and clears
+ * the counter.
+ *
+ * Does nothing before the timebase is initialised.
+ *
+ * @param[in] t Time to add, at the frequency of timebase_frequency()
+ */
+void timebase_advance(uint64_t t)
+{
+	if (!timebase_read) {
+		return;
+	}
+
+	CM_ATOMIC_BLOCK() {
+		timebase_rebase(timebase_current()->scale, t);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timebase Read SysTick as an Up Counter
+ *
+ * The count is 0 when the counter reaches 0 and the SysTick exception
+ * becomes pending, and the reload value just before.
+ *
+ * @returns Counts since the last SysTick period ended.
+ */
+uint32_t timebase_read_systick(void)
+{
+	return timebase_systick_count(systick_get_reload());
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timebase Get Time
+ *
+ * Lock free, may be called from any context, see the file description for
+ * the SysTick handler.
+ *
+ * @returns Time since timebase_init(), at the frequency of
+ * timebase_frequency().
+ */
+uint64_t timebase_now(void)
+{
+	struct timebase_copy c;
+	uint32_t seq, count;
+	uint64_t t;
+
+	do {
+		seq = timebase_seq;
+		__dmb();
+		c = timebase_copies[seq & 1];
+		if (timebase_systick) {
+			count = timebase_systick_elapsed(&c);
+		} else {
+			count = timebase_elapsed(&c, timebase_read());
+		}
+		t = c.total + timebase_scale(&c, count);
+		__dmb();
+	} while (seq != timebase_seq);
+
+	return t;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timebase Get Frequency
+ *
+ * @returns Time units per second, the counter frequency given at
+ * initialisation, or 0 before.
+ */
+uint32_t timebase_frequency(void)
+{
+	return timebase_freq;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timebase Convert to Microseconds
+ *
+ * @param[in] t Time in counts
+ * @returns Time in us, rounded down, or 0 before initialisation.
+ */
+uint64_t timebase_to_us(uint64_t t)
+{
+	if (!timebase_freq) {
+		return 0;
+	}
+	return t / timebase_freq * 1000000 +
+	       t % timebase_freq * 1000000 / timebase_freq;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timebase Convert to Nanoseconds
+ *
+ * @param[in] t Time in counts
+ * @returns Time in ns, rounded down, or 0 before initialisation.
+ */
+uint64_t timebase_to_ns(uint64_t t)
+{
+	if (!timebase_freq) {
+		return 0;
+	}
+	return t / timebase_freq * 1000000000 +
+	       t % timebase_freq * 1000000000 / timebase_freq;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timebase Convert from Microseconds
+ *
+ * @param[in] us Time in us
+ * @returns Time in counts, rounded down, or 0 before initialisation.
+ */
+uint64_t timebase_from_us(uint64_t us)
+{
+	return us / 1000000 * timebase_freq +
+	       us % 1000000 * timebase_freq / 1000000;
+}
+
+/**@}*/
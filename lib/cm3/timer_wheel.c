@@ -0,0 +1,270 @@
+/** @defgroup CM3_timer_wheel_file Timer wheel
+ *
+ * @ingroup CM3_files
+ *
+ * @brief <b>libopencm3 Cortex-M hierarchical software timer wheel</b>
+ *
+ * Handles any number of software timers with constant time insertion,
+ * removal and expiry. Level 0 has one slot per tick, each following level
+ * one slot per TIMER_WHEEL_SLOTS slots of the level below. A timer is
+ * linked in the slot covering its expiry tick on the lowest level that
+ * reaches that far; when the wheel turns past a slot boundary, the timers of
+ * the corresponding upper slot are moved down a level.
+ *
+ * Ticks are arbitrary units, typically a tick count or timebase_now()
+ * scaled down. timer_wheel_advance() is called with the current tick, e.g.
+ * from the tick interrupt; the list manipulations are done in critical
+ * sections, so timers can be added and removed from any context below the
+ * interrupt priority ceiling, while the callbacks run outside of them.
+ *
+ * LGPL License Terms @ref lgpl_license
+ * @{
+ */
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/timer_wheel.h>
+
+#define TIMER_WHEEL_MASK	(TIMER_WHEEL_SLOTS - 1)
+
+static void timer_wheel_link(struct timer_wheel_timer **head,
+			     struct timer_wheel_timer *t)
+{
+	t->next = *head;
+	if (t->next) {
+		t->next->pprev = &t->next;
+	}
+	t->pprev = head;
+	*head = t;
+}
+
+static void timer_wheel_unlink(struct timer_wheel_timer *t)
+{
+	*t->pprev = t->next;
+	if (t->next) {
+		t->next->pprev = t->pprev;
+	}
+	t->pprev = NULL;
+}
+
+/* Link a timer in its slot, in a critical section. */
+static void timer_wheel_insert(struct timer_wheel *tw,
+			       struct timer_wheel_timer *t)
+{
+	uint64_t tick = t->expires;
+	uint64_t delta;
+	int level;
+
+	if (tick < tw->now) {
+		tick = tw->now;
+	}
+	delta = tick - tw->now;
+
+	for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++) {
+		if (delta < (1ULL << ((level + 1) * TIMER_WHEEL_BITS))) {
+			break;
+		}
+	}
+	if (delta >= (1ULL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS))) {
+		/* Park in the furthest slot, it is re-examined from there. */
+		tick = tw->now +
+		       (1ULL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) - 1;
+	}
+
+	timer_wheel_link(&tw->slots[level][(tick >> (level * TIMER_WHEEL_BITS)) &
+					   TIMER_WHEEL_MASK], t);
+}
+
+/* Move the timers of a slot one level down, returns the slot index. */
+static int timer_wheel_cascade(struct timer_wheel *tw, int level)
+{
+	int index = (tw->now >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK;
+	struct timer_wheel_timer *t = tw->slots[level][index];
+	struct timer_wheel_timer *next;
+
+	tw->slots[level][index] = NULL;
+	while (t) {
+		next = t->next;
+		timer_wheel_insert(tw, t);
+		t = next;
+	}
+	return index;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timer Wheel Initialize
+ *
+ * @param[out] tw Timer wheel
+ * @param[in] now Current tick
+ */
+void timer_wheel_init(struct timer_wheel *tw, uint64_t now)
+{
+	int level, index;
+
+	tw->now = now;
+	for (level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		for (index = 0; index < TIMER_WHEEL_SLOTS; index++) {
+			tw->slots[level][index] = NULL;
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timer Wheel Add Timer
+ *
+ * Start or restart a timer. A timer already due expires at the next tick.
+ *
+ * @param[in] tw Timer wheel
+ * @param[in] t Timer, with its callback set; pprev must be NULL the first
+ * time
+ * @param[in] expires Expiry tick
+ */
+void timer_wheel_add(struct timer_wheel *tw, struct timer_wheel_timer *t,
+		     uint64_t expires)
+{
+	CM_CRITICAL_CONTEXT();
+
+	if (t->pprev) {
+		timer_wheel_unlink(t);
+	}
+	t->expires = expires;
+	timer_wheel_insert(tw, t);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timer Wheel Delete Timer
+ *
+ * Stop a timer if it is pending.
+ *
+ * @param[in] tw Timer wheel
+ * @param[in] t Timer
+ */
+void timer_wheel_del(struct timer_wheel *tw, struct timer_wheel_timer *t)
+{
+	CM_CRITICAL_CONTEXT();
+
+	(void)tw;
+	if (t->pprev) {
+		timer_wheel_unlink(t);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timer Wheel Timer Pending
+ *
+ * @param[in] t Timer
+ * @returns true if the timer is waiting for its expiry.
+ */
+bool timer_wheel_pending(struct timer_wheel_timer *t)
+{
+	return t->pprev != NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timer Wheel Advance
+ *
+ * Process the ticks up to and including now, calling the callbacks of the
+ * expired timers in tick order. Must not be called concurrently.
+ *
+ * @param[in] tw Timer wheel
+ * @param[in] now Current tick
+ */
+void timer_wheel_advance(struct timer_wheel *tw, uint64_t now)
+{
+	struct timer_wheel_timer *expired;
+	struct timer_wheel_timer *t;
+	uint64_t tick;
+	int level, index;
+	bool due;
+
+	while (tw->now <= now) {
+		CM_CRITICAL_BLOCK() {
+			tick = tw->now;
+			index = tick & TIMER_WHEEL_MASK;
+			for (level = 1; !index && level < TIMER_WHEEL_LEVELS;
+			     level++) {
+				index = timer_wheel_cascade(tw, level);
+			}
+
+			/* Take the slot, timers added from the callbacks
+			 * go to later ticks. */
+			expired = NULL;
+			t = tw->slots[0][tick & TIMER_WHEEL_MASK];
+			if (t) {
+				tw->slots[0][tick & TIMER_WHEEL_MASK] = NULL;
+				t->pprev = &expired;
+				expired = t;
+			}
+			tw->now++;
+		}
+
+		for (;;) {
+			due = false;
+			CM_CRITICAL_BLOCK() {
+				t = expired;
+				if (t) {
+					timer_wheel_unlink(t);
+					due = t->expires <= tick;
+					if (!due) {
+						/* Parked, not in range yet. */
+						timer_wheel_insert(tw, t);
+					}
+				}
+			}
+			if (!t) {
+				break;
+			}
+			if (due) {
+				t->callback(t);
+			}
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Timer Wheel Idle Ticks
+ *
+ * Count the ticks before the next level 0 slot holding a timer, e.g. to
+ * program a tickless idle period. Timers on upper levels end the count at
+ * the next slot boundary, where they are moved down.
+ *
+ * @param[in] tw Timer wheel
+ * @param[in] max Largest result
+ * @returns Number of ticks without expiry after the last processed one, at
+ * most max.
+ */
+uint32_t timer_wheel_idle(struct timer_wheel *tw, uint32_t max)
+{
+	uint32_t n = 0;
+	uint64_t tick;
+	CM_CRITICAL_CONTEXT();
+
+	tick = tw->now;
+	while (n < max && !tw->slots[0][tick & TIMER_WHEEL_MASK]) {
+		n++;
+		tick++;
+		if (!(tick & TIMER_WHEEL_MASK)) {
+			/* Cascades happen here. */
+			break;
+		}
+	}
+	return n;
+}
+
+/**@}*/
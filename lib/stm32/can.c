@@ -36,6 +36,7 @@ LGPL License Terms @ref lgpl_license
  */
 
 #include <libopencm3/stm32/can.h>
+#include <libopencm3/stm32/can_filter.h>
 #include <libopencm3/stm32/rcc.h>
 
 /* Timeout for CAN INIT acknowledge
@@ -317,6 +318,75 @@ void can_filter_id_list_32bit_init(uint32_t nr,
 	can_filter_init(nr, true, true, id1, id2, fifo, enable);
 }
 
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Load a Compiled Filter Set
+
+Program and enable the filter banks of a set compiled with
+can_filter_compile_bxcan(). Other banks are left untouched. Identifiers packed
+into identifier lists accept data frames only, identifier/mask entries accept
+remote frames as well.
+
+@param[in] set Compiled filter set
+@param[in] first_bank Unsigned int32. Number of the first filter bank to use.
+ */
+void can_filter_apply(const struct can_filter_set *set, uint32_t first_bank)
+{
+	const struct can_filter_entry *e, *b;
+	uint32_t v[4];
+	uint16_t i, k, n;
+
+	for (i = 0; i < set->count; i += n) {
+		b = &set->buf[i];
+		n = 1;
+		while (i + n < set->count &&
+		       set->buf[i + n].filter == b->filter) {
+			n++;
+		}
+
+		/* Unused slots repeat the first entry of the bank. */
+		for (k = 0; k < 4; k++) {
+			e = &set->buf[i + ((k < n) ? k : 0)];
+			switch (b->type) {
+			case CAN_FILTER_LIST16:
+				v[k] = e->id << 5;
+				break;
+			case CAN_FILTER_MASK16:
+				v[k] = ((e->id2 << 5) << 16) | (e->id << 5);
+				/* Match the IDE bit, ignore RTR. */
+				v[k] |= 1 << (16 + 3);
+				break;
+			case CAN_FILTER_LIST32:
+				v[k] = (e->id << 3) | CAN_TIxR_IDE;
+				break;
+			default:
+				v[k] = (e->id << 3) | CAN_TIxR_IDE;
+				break;
+			}
+		}
+
+		switch (b->type) {
+		case CAN_FILTER_LIST16:
+			can_filter_init(first_bank + b->filter, false, true,
+					(v[0] << 16) | v[1], (v[2] << 16) | v[3],
+					b->fifo, true);
+			break;
+		case CAN_FILTER_MASK16:
+			can_filter_init(first_bank + b->filter, false, false,
+					v[0], v[1], b->fifo, true);
+			break;
+		case CAN_FILTER_LIST32:
+			can_filter_init(first_bank + b->filter, true, true,
+					v[0], v[1], b->fifo, true);
+			break;
+		default:
+			can_filter_init(first_bank + b->filter, true, false,
+					v[0], (b->id2 << 3) | CAN_TIxR_IDE,
+					b->fifo, true);
+			break;
+		}
+	}
+}
+
 /*---------------------------------------------------------------------------*/
 /** @brief CAN Enable IRQ
 
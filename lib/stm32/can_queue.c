@@ -0,0 +1,409 @@
+/** @defgroup can_queue_file CAN queues
+
+@ingroup STM32F_files
+
+@brief <b>libopencm3 STM32Fxxx interrupt driven CAN queues</b>
+
+@version 1.0.0
+
+Buffers the bxCAN in software so that bursts of frames do not overrun the
+three entry receive FIFOs and the three transmit mailboxes are always fed with
+the most important frames.
+
+Received frames are moved from both FIFOs into a ring of configurable depth by
+the FIFO interrupts and read with can_queue_receive().
+
+Frames passed to can_queue_transmit() are kept in a queue ordered by bus
+priority, i.e. by the arbitration field, and are loaded into the mailboxes as
+these become empty. When all mailboxes hold pending frames and a frame with a
+higher priority than one of them is queued, the lowest priority mailbox is
+aborted and its frame queued again, so a high priority frame never waits for
+low priority ones. Frames with equal arbitration fields are sent in the order
+they were queued.
+
+The CAN must be initialised with can_init() with the mailbox priority given by
+the identifier (txfp false), and its filters set up. Its transmit, FIFO 0,
+FIFO 1 and status change/error interrupts must be enabled in the NVIC and call
+can_queue_tx_irq(), can_queue_rx_irq() and can_queue_sce_irq(). On F0 all of
+them share one interrupt, from which all handlers can be called.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/sync.h>
+#include <libopencm3/stm32/can_queue.h>
+
+#define CAN_QUEUE_ESR_FLAGS	(CAN_ESR_BOFF | CAN_ESR_EPVF | CAN_ESR_EWGF)
+#define CAN_QUEUE_MBOX_ALL	((1 << CAN_QUEUE_MAILBOXES) - 1)
+
+/* The status bits of mailbox n are those of mailbox 0 shifted by 8 * n. */
+#define CAN_QUEUE_TSR(bit, n)	((bit) << (8 * (n)))
+
+/* Arbitration field of a frame; the lower value wins on the bus. The base
+ * identifier comes first, then the RTR bit of a standard frame or the
+ * recessive SRR of an extended one, the IDE bit, the identifier extension
+ * and the RTR bit of an extended frame. */
+static uint32_t can_queue_key(const struct can_frame *frame)
+{
+	if (frame->ext) {
+		return (((frame->id >> 18) & 0x7ff) << 21) | (3 << 19) |
+		       ((frame->id & 0x3ffff) << 1) | (frame->rtr ? 1 : 0);
+	}
+	return ((frame->id & 0x7ff) << 21) | (frame->rtr ? (1 << 20) : 0);
+}
+
+/* Insert a frame into the transmit queue behind all frames it does not win
+ * against, or, for an aborted frame, in front of the ones with an equal
+ * arbitration field. */
+static void can_queue_insert(struct can_queue *cq,
+			     const struct can_frame *frame, bool requeue)
+{
+	uint32_t key = can_queue_key(frame);
+	uint32_t k;
+	uint16_t i = cq->tx_count;
+
+	while (i > 0) {
+		k = can_queue_key(&cq->tx_buf[i - 1]);
+		if (k > key || (k == key && requeue)) {
+			break;
+		}
+		cq->tx_buf[i] = cq->tx_buf[i - 1];
+		i--;
+	}
+	cq->tx_buf[i] = *frame;
+	cq->tx_count++;
+}
+
+static void can_queue_update_errors(struct can_queue *cq)
+{
+	uint32_t esr = CAN_ESR(cq->canport);
+	uint32_t set = esr & ~cq->esr;
+
+	if (set & CAN_ESR_BOFF) {
+		cq->bus_off++;
+	}
+	if (set & CAN_ESR_EPVF) {
+		cq->error_passive++;
+	}
+	if (set & CAN_ESR_EWGF) {
+		cq->error_warning++;
+	}
+	cq->esr = esr & CAN_QUEUE_ESR_FLAGS;
+	if (esr & CAN_ESR_LEC_MASK) {
+		cq->last_error = esr & CAN_ESR_LEC_MASK;
+	}
+}
+
+/* Account for the mailboxes that completed, successfully or not. */
+static void can_queue_complete(struct can_queue *cq)
+{
+	uint32_t tsr = CAN_TSR(cq->canport);
+	bool ok = false;
+	uint8_t bit;
+	int i;
+
+	for (i = 0; i < CAN_QUEUE_MAILBOXES; i++) {
+		bit = 1 << i;
+		if (!(cq->mbox_busy & bit) ||
+		    !(tsr & CAN_QUEUE_TSR(CAN_TSR_RQCP0, i))) {
+			continue;
+		}
+
+		/* Also clears TXOK, ALST and TERR. */
+		CAN_TSR(cq->canport) = CAN_QUEUE_TSR(CAN_TSR_RQCP0, i);
+		cq->mbox_busy &= ~bit;
+
+		if (tsr & CAN_QUEUE_TSR(CAN_TSR_TXOK0, i)) {
+			cq->tx_frames++;
+			ok = true;
+		} else if (cq->mbox_abort & bit) {
+			can_queue_insert(cq, &cq->mbox[i], true);
+			cq->tx_preempted++;
+		} else {
+			cq->tx_errors++;
+		}
+		cq->mbox_abort &= ~bit;
+	}
+
+	/* A bus-off or error passive state that ended is not signalled by an
+	 * interrupt, pick it up after a successful transmission. */
+	if (ok && cq->esr) {
+		can_queue_update_errors(cq);
+	}
+}
+
+/* Load the highest priority frames into the empty mailboxes, or preempt the
+ * lowest priority mailbox if none is empty. */
+static void can_queue_refill(struct can_queue *cq)
+{
+	struct can_frame *frame;
+	uint32_t key, k, worst_key;
+	int i, worst, mbox;
+
+	can_queue_complete(cq);
+
+	while (cq->tx_count) {
+		frame = &cq->tx_buf[cq->tx_count - 1];
+		key = can_queue_key(frame);
+		worst = -1;
+		worst_key = 0;
+
+		for (i = 0; i < CAN_QUEUE_MAILBOXES; i++) {
+			if (!(cq->mbox_busy & (1 << i))) {
+				continue;
+			}
+			k = can_queue_key(&cq->mbox[i]);
+			if (k == key) {
+				/* The mailboxes do not keep the order of
+				 * frames with equal arbitration fields. */
+				return;
+			}
+			if (k > worst_key) {
+				worst = i;
+				worst_key = k;
+			}
+		}
+
+		if (cq->mbox_busy == CAN_QUEUE_MBOX_ALL) {
+			if (cq->mbox_abort == 0 && worst_key > key) {
+				CAN_TSR(cq->canport) =
+					CAN_QUEUE_TSR(CAN_TSR_ABRQ0, worst);
+				cq->mbox_abort |= 1 << worst;
+			}
+			return;
+		}
+
+		mbox = can_transmit(cq->canport, frame->id, frame->ext,
+				    frame->rtr, frame->length, frame->data);
+		if (mbox < 0) {
+			return;
+		}
+		cq->mbox[mbox] = *frame;
+		cq->mbox_busy |= 1 << mbox;
+		cq->tx_count--;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Queue Initialise
+
+Empty the receive ring and the transmit queue, reset the statistics and enable
+the FIFO, transmit and error interrupts of the CAN.
+
+@param[in] cq Queues, the configuration members must be filled in.
+*/
+
+void can_queue_init(struct can_queue *cq)
+{
+	cq->rx_head = 0;
+	cq->rx_tail = 0;
+	cq->tx_count = 0;
+	cq->mbox_busy = 0;
+	cq->mbox_abort = 0;
+	cq->esr = 0;
+	cq->rx_frames = 0;
+	cq->rx_dropped = 0;
+	cq->rx_overruns = 0;
+	cq->tx_frames = 0;
+	cq->tx_preempted = 0;
+	cq->tx_errors = 0;
+	cq->bus_off = 0;
+	cq->error_passive = 0;
+	cq->error_warning = 0;
+	cq->last_error = 0;
+
+	can_enable_irq(cq->canport, CAN_IER_FMPIE0 | CAN_IER_FOVIE0 |
+		       CAN_IER_FMPIE1 | CAN_IER_FOVIE1 | CAN_IER_TMEIE |
+		       CAN_IER_ERRIE | CAN_IER_BOFIE | CAN_IER_EPVIE |
+		       CAN_IER_EWGIE);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Queue Transmit Frame
+
+Queue a frame for transmission by priority. May be called from interrupt
+context.
+
+@param[in] cq Queues
+@param[in] frame Frame, copied into the queue.
+@returns false if the queue is full.
+*/
+
+bool can_queue_transmit(struct can_queue *cq, const struct can_frame *frame)
+{
+	CM_CRITICAL_CONTEXT();
+
+	/* Keep room for a frame that is being aborted. */
+	if (cq->tx_count + (cq->mbox_abort ? 1 : 0) >= cq->tx_size) {
+		return false;
+	}
+	can_queue_insert(cq, frame, false);
+	can_queue_refill(cq);
+	return true;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Queue Receive Frame
+
+Take the oldest frame from the receive ring. Must not be called from more than
+one context at a time.
+
+@param[in] cq Queues
+@param[out] frame Frame
+@returns false if no frame was received.
+*/
+
+bool can_queue_receive(struct can_queue *cq, struct can_frame *frame)
+{
+	uint16_t tail = cq->rx_tail;
+
+	if (tail == cq->rx_head) {
+		return false;
+	}
+	*frame = cq->rx_buf[tail];
+	__dmb();
+	cq->rx_tail = (tail + 1 == cq->rx_size) ? 0 : tail + 1;
+	return true;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Queue Frames Received
+
+@param[in] cq Queues
+@returns Number of frames waiting in the receive ring.
+*/
+
+uint16_t can_queue_rx_pending(struct can_queue *cq)
+{
+	uint16_t head = cq->rx_head;
+	uint16_t tail = cq->rx_tail;
+
+	return (head >= tail) ? head - tail : cq->rx_size - tail + head;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Queue Frames To Transmit
+
+@param[in] cq Queues
+@returns Number of frames queued or pending in a mailbox.
+*/
+
+uint16_t can_queue_tx_pending(struct can_queue *cq)
+{
+	uint16_t n;
+	int i;
+
+	CM_CRITICAL_CONTEXT();
+
+	n = cq->tx_count;
+	for (i = 0; i < CAN_QUEUE_MAILBOXES; i++) {
+		if (cq->mbox_busy & (1 << i)) {
+			n++;
+		}
+	}
+	return n;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Queue Receive Interrupt Handler
+
+Must be called from the interrupt of each receive FIFO that has filters
+assigned. Frames that do not fit into the ring are discarded.
+
+@param[in] cq Queues
+@param[in] fifo Unsigned int8. FIFO id.
+*/
+
+void can_queue_rx_irq(struct can_queue *cq, uint8_t fifo)
+{
+	volatile uint32_t *rfr = fifo ? &CAN_RF1R(cq->canport) :
+				 &CAN_RF0R(cq->canport);
+	struct can_frame *frame;
+	uint16_t head, next;
+	uint32_t rf;
+
+	for (;;) {
+		rf = *rfr;
+		/* Releasing an entry would clear the overrun flag, so count
+		 * it first. The bits are the same in both FIFO registers. */
+		if (rf & CAN_RF0R_FOVR0) {
+			*rfr = CAN_RF0R_FOVR0 | CAN_RF0R_FULL0;
+			cq->rx_overruns++;
+		}
+		if (!(rf & CAN_RF0R_FMP0_MASK)) {
+			break;
+		}
+
+		head = cq->rx_head;
+		next = (head + 1 == cq->rx_size) ? 0 : head + 1;
+		if (next == cq->rx_tail) {
+			can_fifo_release(cq->canport, fifo);
+			cq->rx_dropped++;
+			continue;
+		}
+
+		frame = &cq->rx_buf[head];
+		can_receive(cq->canport, fifo, true, &frame->id, &frame->ext,
+			    &frame->rtr, &frame->fmi, &frame->length,
+			    frame->data, &frame->timestamp);
+		frame->fifo = fifo;
+		cq->rx_frames++;
+		__dmb();
+		cq->rx_head = next;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Queue Transmit Interrupt Handler
+
+Must be called from the transmit interrupt of the CAN.
+
+@param[in] cq Queues
+*/
+
+void can_queue_tx_irq(struct can_queue *cq)
+{
+	/* Frames may be queued from higher priority interrupts. */
+	CM_CRITICAL_CONTEXT();
+
+	can_queue_refill(cq);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Queue Status Change and Error Interrupt Handler
+
+Must be called from the status change/error interrupt of the CAN to count the
+bus-off, error passive and error warning events.
+
+@param[in] cq Queues
+*/
+
+void can_queue_sce_irq(struct can_queue *cq)
+{
+	/* can_queue_complete() updates the same state from other contexts. */
+	CM_CRITICAL_CONTEXT();
+
+	CAN_MSR(cq->canport) = CAN_MSR_ERRI;
+	can_queue_update_errors(cq);
+}
+
+/**@}*/
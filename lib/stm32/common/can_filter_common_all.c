@@ -0,0 +1,580 @@
+/** @addtogroup can_filter_file CAN acceptance filter compiler
+
+@ingroup STM32F_files
+
+@brief <b>libopencm3 STM32 CAN acceptance filter compiler</b>
+
+@version 1.0.0
+
+Translates a list of identifiers and identifier ranges into the acceptance
+filters of the bxCAN or the FDCAN, so that frames nobody listens to are
+dropped by the hardware instead of being received and discarded in software.
+
+For the bxCAN each rule is split into the smallest set of exact identifier/mask
+pairs. Single standard identifiers are packed four to a bank as a 16 bit
+identifier list, standard pairs two to a bank, single extended identifiers two
+to a bank as a 32 bit list and extended pairs one to a bank.
+
+For the FDCAN adjacent ranges are joined, single identifiers are packed two to
+an element as dual identifier filters and ranges use one range element each.
+
+If the result does not fit into the available filters, entries steered to the
+same FIFO are merged into wider masks or ranges, choosing at each step the
+merge that accepts the fewest additional identifiers. A merge never widens an
+entry over identifiers steered to the other FIFO. The identifiers accepted
+without being requested are reported, so the application can weigh the
+filters against the remaining software filtering.
+
+Each rule selects a receive FIFO. Frequently received identifiers can be given
+a FIFO of their own, so they are not delayed behind bulk traffic and can be
+served by a higher priority interrupt. Rules must not overlap.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <libopencm3/stm32/can_filter.h>
+
+#define CAN_FILTER_STD_BITS	0x7ffU
+#define CAN_FILTER_EXT_BITS	0x1fffffffU
+
+static uint32_t can_filter_bits(bool ext)
+{
+	return ext ? CAN_FILTER_EXT_BITS : CAN_FILTER_STD_BITS;
+}
+
+static bool can_filter_single(const struct can_filter_entry *e, bool range)
+{
+	return range ? e->id2 == e->id : e->id2 == can_filter_bits(e->ext);
+}
+
+/* Number of identifiers matched by an entry. */
+static uint32_t can_filter_size(const struct can_filter_entry *e, bool range)
+{
+	uint32_t free, size = 1;
+
+	if (range) {
+		return e->id2 - e->id + 1;
+	}
+	for (free = ~e->id2 & can_filter_bits(e->ext); free; free >>= 1) {
+		if (free & 1) {
+			size <<= 1;
+		}
+	}
+	return size;
+}
+
+/* Smallest entry matching both entries. */
+static void can_filter_join(const struct can_filter_entry *a,
+			    const struct can_filter_entry *b,
+			    struct can_filter_entry *m, bool range)
+{
+	m->ext = a->ext;
+	m->fifo = a->fifo;
+	m->type = a->type;
+	m->filter = 0;
+	m->wanted = a->wanted + b->wanted;
+	if (range) {
+		m->id = (a->id < b->id) ? a->id : b->id;
+		m->id2 = (a->id2 > b->id2) ? a->id2 : b->id2;
+	} else {
+		m->id2 = a->id2 & b->id2 & ~(a->id ^ b->id);
+		m->id = a->id & m->id2;
+	}
+}
+
+static bool can_filter_contains(const struct can_filter_entry *m,
+				const struct can_filter_entry *e, bool range)
+{
+	if (range) {
+		return e->id >= m->id && e->id2 <= m->id2;
+	}
+	return (e->id2 & m->id2) == m->id2 && (e->id & m->id2) == m->id;
+}
+
+static bool can_filter_overlaps(const struct can_filter_entry *a,
+				const struct can_filter_entry *b, bool range)
+{
+	if (range) {
+		return a->id <= b->id2 && b->id <= a->id2;
+	}
+	return ((a->id ^ b->id) & a->id2 & b->id2) == 0;
+}
+
+/* A merged entry must not take identifiers of the other FIFO, as the filter
+ * matched first would then steer them to the wrong FIFO. */
+static bool can_filter_steals(const struct can_filter_set *set,
+			      const struct can_filter_entry *m, bool range)
+{
+	const struct can_filter_entry *e;
+	uint16_t i;
+
+	for (i = 0; i < set->count; i++) {
+		e = &set->buf[i];
+		if (e->ext == m->ext && e->fifo != m->fifo &&
+		    can_filter_overlaps(m, e, range)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void can_filter_remove(struct can_filter_set *set, uint16_t i)
+{
+	set->count--;
+	for (; i < set->count; i++) {
+		set->buf[i] = set->buf[i + 1];
+	}
+}
+
+static int can_filter_add(struct can_filter_set *set, uint32_t id,
+			  uint32_t id2, uint32_t wanted, bool ext, uint8_t fifo)
+{
+	struct can_filter_entry *e;
+
+	if (set->count >= set->size) {
+		return CAN_FILTER_E_STORAGE;
+	}
+	e = &set->buf[set->count++];
+	e->id = id;
+	e->id2 = id2;
+	e->wanted = wanted;
+	e->ext = ext;
+	e->fifo = fifo;
+	return CAN_FILTER_E_OK;
+}
+
+static int can_filter_check(const struct can_filter_rule *rule)
+{
+	if (rule->first > rule->last || rule->last > can_filter_bits(rule->ext) ||
+	    rule->fifo > 1) {
+		return CAN_FILTER_E_RULE;
+	}
+	return CAN_FILTER_E_OK;
+}
+
+/* Filters used by the standard [0] and extended [1] identifiers, for the
+ * bxCAN the banks shared by both. A single standard identifier may take the
+ * free half of a 16 bit identifier/mask bank. */
+static void can_filter_used(uint16_t n[2][2][2], bool range,
+			    uint16_t used[2])
+{
+	uint16_t s, m;
+	int f;
+
+	used[0] = 0;
+	used[1] = 0;
+	for (f = 0; f < 2; f++) {
+		if (range) {
+			used[0] += (n[f][0][1] + 1) / 2 + n[f][0][0];
+			used[1] += (n[f][1][1] + 1) / 2 + n[f][1][0];
+			continue;
+		}
+		s = n[f][0][1];
+		m = n[f][0][0];
+		if ((m & 1) && (s & 3) == 1) {
+			s--;
+			m++;
+		}
+		used[0] += (s + 3) / 4 + (m + 1) / 2 +
+			   (n[f][1][1] + 1) / 2 + n[f][1][0];
+	}
+}
+
+static uint16_t can_filter_excess(uint16_t n[2][2][2], bool range,
+				  const uint16_t avail[2])
+{
+	uint16_t used[2];
+
+	can_filter_used(n, range, used);
+	return ((used[0] > avail[0]) ? used[0] - avail[0] : 0) +
+	       ((used[1] > avail[1]) ? used[1] - avail[1] : 0);
+}
+
+/* Entry counts by [fifo][ext][single]. */
+static void can_filter_count(const struct can_filter_set *set,
+			     uint16_t n[2][2][2], bool range)
+{
+	const struct can_filter_entry *e;
+	uint16_t i;
+
+	for (i = 0; i < 8; i++) {
+		n[i >> 2][(i >> 1) & 1][i & 1] = 0;
+	}
+	for (i = 0; i < set->count; i++) {
+		e = &set->buf[i];
+		n[e->fifo][e->ext][can_filter_single(e, range)]++;
+	}
+}
+
+/* Rank of merging entries a and b: 0 if it reduces the filters needed beyond
+ * the available ones, 1 if it does not change them, 2 otherwise. Merges of
+ * FDCAN entries whose identifier type fits are not considered. */
+static int can_filter_rank(uint16_t n[2][2][2], bool range,
+			   const uint16_t avail[2],
+			   const struct can_filter_entry *a,
+			   const struct can_filter_entry *b,
+			   const struct can_filter_entry *m)
+{
+	uint16_t t[2][2][2];
+	uint16_t used[2], before, after;
+	int i;
+
+	can_filter_used(n, range, used);
+	if (range && used[a->ext] <= avail[a->ext]) {
+		return -1;
+	}
+
+	for (i = 0; i < 8; i++) {
+		t[i >> 2][(i >> 1) & 1][i & 1] = n[i >> 2][(i >> 1) & 1][i & 1];
+	}
+	t[a->fifo][a->ext][can_filter_single(a, range)]--;
+	t[b->fifo][b->ext][can_filter_single(b, range)]--;
+	t[m->fifo][m->ext][can_filter_single(m, range)]++;
+
+	before = can_filter_excess(n, range, avail);
+	after = can_filter_excess(t, range, avail);
+	if (after < before) {
+		return 0;
+	}
+	return (after == before) ? 1 : 2;
+}
+
+/* Merge entries until the set fits. The FDCAN ranges are kept sorted and
+ * only neighbours are merged; any two bxCAN entries of a FIFO and identifier
+ * type are candidates. Merges overlapping an entry of the other FIFO are
+ * never made, so the order of the filters does not matter. */
+static int can_filter_reduce(struct can_filter_set *set, bool range,
+			     const uint16_t avail[2])
+{
+	uint16_t n[2][2][2];
+	struct can_filter_entry m, *a, *b;
+	uint16_t i, j, best_i = 0, best_j = 0;
+	uint32_t size, cost, best_cost = 0;
+	int rank, best_rank = 0;
+
+	for (;;) {
+		can_filter_count(set, n, range);
+		if (can_filter_excess(n, range, avail) == 0) {
+			return CAN_FILTER_E_OK;
+		}
+
+		best_j = 0;
+		for (i = 0; i < set->count; i++) {
+			for (j = i + 1; j < set->count; j++) {
+				a = &set->buf[i];
+				b = &set->buf[j];
+				if (a->ext != b->ext || a->fifo != b->fifo) {
+					if (range) {
+						break;
+					}
+					continue;
+				}
+
+				can_filter_join(a, b, &m, range);
+				if (can_filter_steals(set, &m, range)) {
+					if (range) {
+						break;
+					}
+					continue;
+				}
+				rank = can_filter_rank(n, range, avail, a, b,
+						       &m);
+				size = can_filter_size(a, range) +
+				       can_filter_size(b, range);
+				cost = can_filter_size(&m, range);
+				cost = (cost > size) ? cost - size : 0;
+
+				if (rank >= 0 &&
+				    (best_j == 0 || rank < best_rank ||
+				     (rank == best_rank && cost < best_cost))) {
+					best_i = i;
+					best_j = j;
+					best_cost = cost;
+					best_rank = rank;
+				}
+				if (range) {
+					break;
+				}
+			}
+		}
+
+		if (best_j == 0) {
+			return CAN_FILTER_E_FILTERS;
+		}
+
+		/* Replace the first entry by the merged one and drop the
+		 * entries it covers. */
+		can_filter_join(&set->buf[best_i], &set->buf[best_j], &m,
+				range);
+		set->buf[best_i] = m;
+		can_filter_remove(set, best_j);
+		for (j = set->count; j-- > 0;) {
+			b = &set->buf[j];
+			if (j != best_i && b->ext == m.ext &&
+			    b->fifo == m.fifo &&
+			    can_filter_contains(&m, b, range)) {
+				set->buf[best_i].wanted += b->wanted;
+				can_filter_remove(set, j);
+				if (j < best_i) {
+					best_i--;
+				}
+			}
+		}
+	}
+}
+
+/* Ordering used for packing: FIFO, identifier type, entry type, identifier. */
+static bool can_filter_before(const struct can_filter_entry *a,
+			      const struct can_filter_entry *b)
+{
+	if (a->fifo != b->fifo) {
+		return a->fifo < b->fifo;
+	}
+	if (a->ext != b->ext) {
+		return !a->ext;
+	}
+	if (a->type != b->type) {
+		return a->type < b->type;
+	}
+	return a->id < b->id;
+}
+
+static void can_filter_sort(struct can_filter_set *set)
+{
+	struct can_filter_entry e;
+	uint16_t i, j;
+
+	for (i = 1; i < set->count; i++) {
+		e = set->buf[i];
+		for (j = i; j > 0 && can_filter_before(&e, &set->buf[j - 1]);
+		     j--) {
+			set->buf[j] = set->buf[j - 1];
+		}
+		set->buf[j] = e;
+	}
+}
+
+static void can_filter_summary(struct can_filter_set *set, bool range)
+{
+	uint16_t i;
+
+	set->accepted = 0;
+	set->false_positives = 0;
+	for (i = 0; i < set->count; i++) {
+		set->accepted += can_filter_size(&set->buf[i], range);
+		set->false_positives += can_filter_size(&set->buf[i], range) -
+					set->buf[i].wanted;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Filter Compile for bxCAN
+
+@param[in] set Filter set, the storage members must be filled in.
+@param[in] rules Acceptance rules
+@param[in] n Number of rules
+@param[in] banks Number of filter banks available
+@returns @ref CAN_FILTER_E_OK or an error, see @ref can_filter_error.
+*/
+
+int can_filter_compile_bxcan(struct can_filter_set *set,
+			     const struct can_filter_rule *rules,
+			     uint16_t n, uint16_t banks)
+{
+	const struct can_filter_rule *rule;
+	uint16_t cnt[2][2][2];
+	struct can_filter_entry *e;
+	uint32_t lo, bits, size, cap[4] = {4, 2, 2, 1};
+	uint16_t i, used, avail[2];
+	int ret;
+
+	set->count = 0;
+	set->banks = 0;
+	set->std_elements = 0;
+	set->ext_elements = 0;
+	set->accepted = 0;
+	set->false_positives = 0;
+
+	for (i = 0; i < n; i++) {
+		rule = &rules[i];
+		ret = can_filter_check(rule);
+		if (ret) {
+			return ret;
+		}
+
+		/* Split into aligned power of two sized blocks. */
+		bits = can_filter_bits(rule->ext);
+		for (lo = rule->first;; lo += size) {
+			size = lo ? (lo & (~lo + 1)) : bits + 1;
+			while (size - 1 > rule->last - lo) {
+				size >>= 1;
+			}
+			ret = can_filter_add(set, lo, ~(size - 1) & bits, size,
+					     rule->ext, rule->fifo);
+			if (ret) {
+				return ret;
+			}
+			if (rule->last - lo == size - 1) {
+				break;
+			}
+		}
+	}
+
+	avail[0] = banks;
+	avail[1] = 0;
+	ret = can_filter_reduce(set, false, avail);
+	if (ret) {
+		return ret;
+	}
+
+	/* Assign the entry types, a lone standard identifier may fill an
+	 * identifier/mask bank. */
+	can_filter_count(set, cnt, false);
+	for (i = 0; i < set->count; i++) {
+		e = &set->buf[i];
+		if (e->ext) {
+			e->type = can_filter_single(e, false) ?
+				  CAN_FILTER_LIST32 : CAN_FILTER_MASK32;
+		} else if (can_filter_single(e, false)) {
+			e->type = CAN_FILTER_LIST16;
+			if ((cnt[e->fifo][0][0] & 1) &&
+			    (cnt[e->fifo][0][1] & 3) == 1) {
+				e->type = CAN_FILTER_MASK16;
+				cnt[e->fifo][0][0]++;
+				cnt[e->fifo][0][1]--;
+			}
+		} else {
+			e->type = CAN_FILTER_MASK16;
+		}
+	}
+	can_filter_sort(set);
+
+	for (i = 0, used = 0; i < set->count; i++) {
+		e = &set->buf[i];
+		if (used == 0 || used == cap[e->type] ||
+		    e->type != set->buf[i - 1].type ||
+		    e->fifo != set->buf[i - 1].fifo) {
+			set->banks++;
+			used = 0;
+		}
+		e->filter = set->banks - 1;
+		used++;
+	}
+
+	can_filter_summary(set, false);
+	return CAN_FILTER_E_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief CAN Filter Compile for FDCAN
+
+@param[in] set Filter set, the storage members must be filled in.
+@param[in] rules Acceptance rules
+@param[in] n Number of rules
+@param[in] std_elements Number of standard identifier filter elements
+available
+@param[in] ext_elements Number of extended identifier filter elements
+available
+@returns @ref CAN_FILTER_E_OK or an error, see @ref can_filter_error.
+*/
+
+int can_filter_compile_fdcan(struct can_filter_set *set,
+			     const struct can_filter_rule *rules,
+			     uint16_t n, uint16_t std_elements,
+			     uint16_t ext_elements)
+{
+	struct can_filter_entry *e, *p;
+	uint16_t i, used, avail[2];
+	int ret;
+
+	set->count = 0;
+	set->banks = 0;
+	set->std_elements = 0;
+	set->ext_elements = 0;
+	set->accepted = 0;
+	set->false_positives = 0;
+
+	for (i = 0; i < n; i++) {
+		ret = can_filter_check(&rules[i]);
+		if (ret) {
+			return ret;
+		}
+		ret = can_filter_add(set, rules[i].first, rules[i].last,
+				     rules[i].last - rules[i].first + 1,
+				     rules[i].ext, rules[i].fifo);
+		if (ret) {
+			return ret;
+		}
+		set->buf[set->count - 1].type = CAN_FILTER_RANGE;
+	}
+
+	/* Sort and join adjacent ranges, which costs nothing. */
+	can_filter_sort(set);
+	for (i = 1; i < set->count;) {
+		p = &set->buf[i - 1];
+		e = &set->buf[i];
+		if (p->ext == e->ext && p->fifo == e->fifo &&
+		    e->id == p->id2 + 1) {
+			p->id2 = e->id2;
+			p->wanted += e->wanted;
+			can_filter_remove(set, i);
+		} else {
+			i++;
+		}
+	}
+
+	avail[0] = std_elements;
+	avail[1] = ext_elements;
+	ret = can_filter_reduce(set, true, avail);
+	if (ret) {
+		return ret;
+	}
+
+	for (i = 0; i < set->count; i++) {
+		e = &set->buf[i];
+		e->type = can_filter_single(e, true) ?
+			  CAN_FILTER_DUAL : CAN_FILTER_RANGE;
+	}
+	can_filter_sort(set);
+
+	for (i = 0, used = 0; i < set->count; i++) {
+		e = &set->buf[i];
+		if (used == 0 || used == 2 || e->type != CAN_FILTER_DUAL ||
+		    e->type != set->buf[i - 1].type ||
+		    e->ext != set->buf[i - 1].ext ||
+		    e->fifo != set->buf[i - 1].fifo) {
+			if (e->ext) {
+				set->ext_elements++;
+			} else {
+				set->std_elements++;
+			}
+			used = 0;
+		}
+		e->filter = (e->ext ? set->ext_elements : set->std_elements) -
+			    1;
+		used++;
+	}
+
+	can_filter_summary(set, true);
+	return CAN_FILTER_E_OK;
+}
+
+/**@}*/
@@ -7,6 +7,15 @@
  * This library supports the DMA2D Peripheral in the STM32F4xx and STM32F7xx
  * series of ARM Cortex Microcontrollers by ST Microelectronics.
  *
+ * Operations (fills, copies, pixel format conversions and blends) are queued
+ * with dma2d_submit() and run back to back: the transfer complete interrupt
+ * finishes one and starts the next, so the CPU is only involved once per
+ * operation. CLUTs of indexed input formats are loaded by the DMA2D itself
+ * before the operation that needs them.
+ *
+ * The DMA2D clock must be enabled and the DMA2D interrupt enabled in the
+ * NVIC, calling dma2d_irq().
+ *
  * LGPL License Terms @ref lgpl_license
  */
 /*
@@ -26,8 +35,238 @@
  * along with this library.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <libopencm3/stm32/common/dma2d_common_f47.h>
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/stm32/dma2d.h>
 
 /**@{*/
 
+#define DMA2D_QUEUE_CLUT_FG	(1 << 0)
+#define DMA2D_QUEUE_CLUT_BG	(1 << 1)
+
+#define DMA2D_ERRORS		(DMA2D_ISR_CEIF | DMA2D_ISR_CAEIF | \
+				 DMA2D_ISR_TEIF)
+#define DMA2D_IRQS		(DMA2D_CR_CEIE | DMA2D_CR_CTCIE | \
+				 DMA2D_CR_CAEIE | DMA2D_CR_TCIE | \
+				 DMA2D_CR_TEIE)
+
+static uint32_t dma2d_pfccr(const struct dma2d_layer *l)
+{
+	uint32_t reg32;
+
+	reg32 = ((uint32_t)l->alpha << DMA2D_xPFCCR_ALPHA_SHIFT) |
+		((l->alpha_mode & DMA2D_xPFCCR_AM_MASK) <<
+		 DMA2D_xPFCCR_AM_SHIFT) |
+		((l->format & DMA2D_xPFCCR_CM_MASK) << DMA2D_xPFCCR_CM_SHIFT);
+	if (l->clut) {
+		reg32 |= ((uint32_t)(l->clut_size - 1) &
+			  DMA2D_xPFCCR_CS_MASK) << DMA2D_xPFCCR_CS_SHIFT;
+		reg32 |= l->clut_rgb888 ? DMA2D_xPFCCR_CCM_RGB888 :
+			 DMA2D_xPFCCR_CCM_ARGB8888;
+	}
+	return reg32;
+}
+
+/* Start loading the CLUT of a layer, returns false if there is none. */
+static bool dma2d_load_clut(const struct dma2d_layer *l, bool bg)
+{
+	if (!l->clut || l->clut_size == 0) {
+		return false;
+	}
+	if (bg) {
+		DMA2D_BGCMAR = (uint32_t)l->clut;
+		DMA2D_BGPFCCR = dma2d_pfccr(l) | DMA2D_xPFCCR_START;
+	} else {
+		DMA2D_FGCMAR = (uint32_t)l->clut;
+		DMA2D_FGPFCCR = dma2d_pfccr(l) | DMA2D_xPFCCR_START;
+	}
+	return true;
+}
+
+static void dma2d_start(const struct dma2d_op *op)
+{
+	uint8_t out = op->dst_format;
+
+	if (op->mode != DMA2D_CR_MODE_R2M) {
+		DMA2D_FGMAR = op->fg.addr;
+		DMA2D_FGOR = op->fg.offset & DMA2D_FGOR_LO_MASK;
+		DMA2D_FGPFCCR = dma2d_pfccr(&op->fg);
+		DMA2D_FGCOLR = op->fg.color;
+	}
+	if (op->mode == DMA2D_CR_MODE_M2MWB) {
+		DMA2D_BGMAR = op->bg.addr;
+		DMA2D_BGOR = op->bg.offset & DMA2D_BGOR_LO_MASK;
+		DMA2D_BGPFCCR = dma2d_pfccr(&op->bg);
+		DMA2D_BGCOLR = op->bg.color;
+	}
+	if (op->mode == DMA2D_CR_MODE_M2M) {
+		/* The output has the foreground format, which only matters
+		 * for the pixel size. */
+		out = op->fg.format;
+	}
+	if (op->mode == DMA2D_CR_MODE_R2M) {
+		DMA2D_OCOLR = op->color;
+	}
+	DMA2D_OPFCCR = out;
+	DMA2D_OMAR = op->dst;
+	DMA2D_OOR = op->dst_offset & DMA2D_OOR_LO_MASK;
+	DMA2D_NLR = ((uint32_t)(op->width & DMA2D_NLR_PL_MASK) <<
+		     DMA2D_NLR_PL_SHIFT) | op->height;
+	DMA2D_CR = ((uint32_t)op->mode << DMA2D_CR_MODE_SHIFT) | DMA2D_IRQS |
+		   DMA2D_CR_START;
+}
+
+/* Load the missing CLUTs of the head operation, or start it. */
+static void dma2d_run(struct dma2d_queue *q)
+{
+	struct dma2d_op *op;
+
+	CM_CRITICAL_BLOCK() {
+		op = q->head;
+		if (!op) {
+			q->busy = false;
+		}
+	}
+	if (!op) {
+		return;
+	}
+
+	if (op->mode != DMA2D_CR_MODE_R2M &&
+	    !(q->clut_loaded & DMA2D_QUEUE_CLUT_FG)) {
+		q->clut_loaded |= DMA2D_QUEUE_CLUT_FG;
+		if (dma2d_load_clut(&op->fg, false)) {
+			return;
+		}
+	}
+	if (op->mode == DMA2D_CR_MODE_M2MWB &&
+	    !(q->clut_loaded & DMA2D_QUEUE_CLUT_BG)) {
+		q->clut_loaded |= DMA2D_QUEUE_CLUT_BG;
+		if (dma2d_load_clut(&op->bg, true)) {
+			return;
+		}
+	}
+	dma2d_start(op);
+}
+
+/* Finish the operation at the head of the queue and start the next. */
+static void dma2d_done(struct dma2d_queue *q, int status)
+{
+	struct dma2d_op *op = q->head;
+
+	CM_CRITICAL_BLOCK() {
+		q->head = op->next;
+		if (q->head == NULL) {
+			q->tail = NULL;
+		}
+	}
+	q->clut_loaded = 0;
+	if (status) {
+		q->errors++;
+	} else {
+		q->ops++;
+	}
+
+	op->status = status;
+	if (op->callback) {
+		op->callback(q, op);
+	}
+	dma2d_run(q);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA2D Initialise Operation Queue
+
+Empty the queue and enable the interrupts used by it.
+
+@param[in] q Queue
+*/
+
+void dma2d_queue_init(struct dma2d_queue *q)
+{
+	q->head = NULL;
+	q->tail = NULL;
+	q->busy = false;
+	q->clut_loaded = 0;
+	q->ops = 0;
+	q->errors = 0;
+
+	DMA2D_IFCR = DMA2D_ERRORS | DMA2D_ISR_CTCIF | DMA2D_ISR_TCIF |
+		     DMA2D_ISR_TWIF;
+	DMA2D_CR = DMA2D_IRQS;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA2D Submit Operation
+
+Append an operation to the queue, starting it if the DMA2D is idle. May be
+called from interrupt context, including completion callbacks.
+
+@param[in] q Queue
+@param[in] op Operation, owned by the caller until its callback has run.
+*/
+
+void dma2d_submit(struct dma2d_queue *q, struct dma2d_op *op)
+{
+	CM_CRITICAL_CONTEXT();
+
+	op->next = NULL;
+	op->status = 0;
+	if (q->tail) {
+		q->tail->next = op;
+	} else {
+		q->head = op;
+	}
+	q->tail = op;
+
+	if (!q->busy) {
+		q->busy = true;
+		q->clut_loaded = 0;
+		dma2d_run(q);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA2D Interrupt Handler
+
+Must be called from the DMA2D interrupt. Continues after a CLUT load,
+completes the current operation and starts the next one.
+
+@param[in] q Queue
+*/
+
+void dma2d_irq(struct dma2d_queue *q)
+{
+	uint32_t isr = DMA2D_ISR;
+
+	DMA2D_IFCR = isr;
+	if (!q->head) {
+		return;
+	}
+
+	if (isr & DMA2D_ERRORS) {
+		/* Stop whatever is left of the failed operation. */
+		if (DMA2D_CR & DMA2D_CR_START) {
+			DMA2D_CR |= DMA2D_CR_ABORT;
+			while (DMA2D_CR & DMA2D_CR_START);
+		}
+		dma2d_done(q, -1);
+	} else if (isr & DMA2D_ISR_TCIF) {
+		dma2d_done(q, 0);
+	} else if (isr & DMA2D_ISR_CTCIF) {
+		dma2d_run(q);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA2D Queue Busy
+
+@param[in] q Queue
+@returns true while operations are queued or running.
+*/
+
+bool dma2d_busy(struct dma2d_queue *q)
+{
+	return q->busy;
+}
+
 /**@}*/
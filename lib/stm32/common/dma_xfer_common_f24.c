@@ -0,0 +1,255 @@
+/** @addtogroup dma_xfer_file DMA transfer descriptors
+
+@ingroup STM32F_files
+
+@brief <b>libopencm3 STM32 DMA transfer descriptors, stream controller</b>
+
+@version 1.0.0
+
+A transfer is described once by a @ref dma_xfer_config and translated by
+dma_xfer_prepare() into the values of the stream registers, including the
+channel selection and the FIFO control register. dma_xfer_commit() and
+dma_xfer_start() then write these values with one store per register instead
+of a read-modify-write sequence per setting, which makes it cheap to
+reconfigure a stream before every transfer.
+
+The same calls are available for the channel controller of the other
+families.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <libopencm3/stm32/dma_xfer.h>
+
+/* Size field value for a data size in bytes. */
+static uint32_t dma_xfer_size(uint8_t bytes)
+{
+	return (bytes == 4) ? 2 : ((bytes == 2) ? 1 : 0);
+}
+
+/* Burst field value for a burst length in beats. */
+static uint32_t dma_xfer_burst(uint8_t beats)
+{
+	switch (beats) {
+	case 16:
+		return 3;
+	case 8:
+		return 2;
+	case 4:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+/* Disable the stream and wait until an ongoing beat has finished. */
+static void dma_xfer_disable(uint32_t dma, uint8_t stream)
+{
+	DMA_SCR(dma, stream) &= ~DMA_SxCR_EN;
+	while (DMA_SCR(dma, stream) & DMA_SxCR_EN);
+}
+
+static void dma_xfer_write(const struct dma_xfer *xfer, uint32_t en)
+{
+	uint32_t dma = xfer->dma;
+	uint8_t stream = xfer->channel;
+
+	dma_xfer_disable(dma, stream);
+	DMA_SPAR(dma, stream) = (void *)xfer->par;
+	DMA_SM0AR(dma, stream) = (void *)xfer->mar;
+	DMA_SNDTR(dma, stream) = xfer->ndtr;
+	DMA_SFCR(dma, stream) = xfer->fcr;
+	dma_clear_interrupt_flags(dma, stream, DMA_ISR_FLAGS);
+	DMA_SCR(dma, stream) = xfer->cr | en;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Transfer Prepare
+
+Compute the register values of a transfer. Does not access the hardware, so a
+transfer can be prepared once and committed many times.
+
+Memory to memory transfers, bursts and transfers with different peripheral
+and memory data sizes always use the FIFO.
+
+@param[out] xfer Register values
+@param[in] cfg Transfer description
+*/
+
+void dma_xfer_prepare(struct dma_xfer *xfer,
+		      const struct dma_xfer_config *cfg)
+{
+	uint8_t fifo = cfg->fifo;
+	uint32_t cr;
+
+	cr = DMA_SxCR_CHSEL(cfg->request & 7) |
+	     ((uint32_t)(cfg->priority & 3) << DMA_SxCR_PL_SHIFT) |
+	     (dma_xfer_size(cfg->msize) << DMA_SxCR_MSIZE_SHIFT) |
+	     (dma_xfer_size(cfg->psize) << DMA_SxCR_PSIZE_SHIFT) |
+	     ((uint32_t)cfg->dir << DMA_SxCR_DIR_SHIFT);
+	if (cfg->minc) {
+		cr |= DMA_SxCR_MINC;
+	}
+	if (cfg->pinc) {
+		cr |= DMA_SxCR_PINC;
+	}
+	if (cfg->circular && cfg->dir != DMA_XFER_MEM_TO_MEM) {
+		cr |= DMA_SxCR_CIRC;
+	}
+	if (cfg->irq & DMA_XFER_IRQ_TC) {
+		cr |= DMA_SxCR_TCIE;
+	}
+	if (cfg->irq & DMA_XFER_IRQ_HT) {
+		cr |= DMA_SxCR_HTIE;
+	}
+	if (cfg->irq & DMA_XFER_IRQ_TE) {
+		cr |= DMA_SxCR_TEIE;
+	}
+
+	if (cfg->burst) {
+		cr |= dma_xfer_burst(cfg->burst) << DMA_SxCR_MBURST_SHIFT;
+		if (cfg->dir == DMA_XFER_MEM_TO_MEM) {
+			cr |= dma_xfer_burst(cfg->burst) <<
+			      DMA_SxCR_PBURST_SHIFT;
+		}
+	}
+
+	if (fifo == 0 && (cfg->dir == DMA_XFER_MEM_TO_MEM || cfg->burst ||
+			  cfg->psize != cfg->msize)) {
+		fifo = 4;
+	}
+
+	xfer->dma = cfg->dma;
+	xfer->channel = cfg->channel;
+	xfer->request = cfg->request;
+	xfer->cr = cr;
+	xfer->ndtr = cfg->count;
+	xfer->par = cfg->paddr;
+	xfer->mar = cfg->maddr;
+	xfer->fcr = fifo ? (DMA_SxFCR_DMDIS | ((fifo - 1) & 3)) : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Transfer Commit
+
+Disable the stream, clear its flags and write the prepared register values.
+The stream is left disabled.
+
+@param[in] xfer Register values
+*/
+
+void dma_xfer_commit(const struct dma_xfer *xfer)
+{
+	dma_xfer_write(xfer, 0);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Transfer Start
+
+As dma_xfer_commit(), with the stream enabled by the last store.
+
+@param[in] xfer Register values
+*/
+
+void dma_xfer_start(const struct dma_xfer *xfer)
+{
+	dma_xfer_write(xfer, DMA_SxCR_EN);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Transfer Restart
+
+Start a committed stream again on a new buffer, keeping the other settings.
+
+@param[in] dma DMA controller base address
+@param[in] channel Stream number
+@param[in] maddr Memory address
+@param[in] count Number of data items
+*/
+
+void dma_xfer_restart(uint32_t dma, uint8_t channel, uint32_t maddr,
+		      uint16_t count)
+{
+	dma_xfer_disable(dma, channel);
+	DMA_SM0AR(dma, channel) = (void *)maddr;
+	DMA_SNDTR(dma, channel) = count;
+	dma_clear_interrupt_flags(dma, channel, DMA_ISR_FLAGS);
+	DMA_SCR(dma, channel) |= DMA_SxCR_EN;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Transfer Stop
+
+Disable the stream and wait until it has stopped.
+
+@param[in] dma DMA controller base address
+@param[in] channel Stream number
+*/
+
+void dma_xfer_stop(uint32_t dma, uint8_t channel)
+{
+	dma_xfer_disable(dma, channel);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Transfer Set Memory Increment
+
+The stream must be stopped.
+
+@param[in] dma DMA controller base address
+@param[in] channel Stream number
+@param[in] minc Increment the memory address
+*/
+
+void dma_xfer_set_minc(uint32_t dma, uint8_t channel, bool minc)
+{
+	if (minc) {
+		DMA_SCR(dma, channel) |= DMA_SxCR_MINC;
+	} else {
+		DMA_SCR(dma, channel) &= ~DMA_SxCR_MINC;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Transfer Get Flags
+
+Read and acknowledge the transfer complete, half transfer and transfer error
+flags of a stream.
+
+@param[in] dma DMA controller base address
+@param[in] channel Stream number
+@returns Set flags, a combination of DMA_TCIF, DMA_HTIF and DMA_TEIF.
+*/
+
+uint32_t dma_xfer_get_flags(uint32_t dma, uint8_t channel)
+{
+	uint32_t isr = (channel < 4) ? DMA_LISR(dma) : DMA_HISR(dma);
+	uint32_t flags;
+
+	flags = (isr >> DMA_ISR_OFFSET(channel)) &
+		(DMA_TCIF | DMA_HTIF | DMA_TEIF);
+	if (flags) {
+		dma_clear_interrupt_flags(dma, channel, flags);
+	}
+	return flags;
+}
+
+/**@}*/
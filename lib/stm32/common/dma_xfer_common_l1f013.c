@@ -0,0 +1,242 @@
+/** @addtogroup dma_xfer_file DMA transfer descriptors
+
+@ingroup STM32F_files
+
+@brief <b>libopencm3 STM32 DMA transfer descriptors, channel controller</b>
+
+@version 1.0.0
+
+A transfer is described once by a @ref dma_xfer_config and translated by
+dma_xfer_prepare() into the values of the channel registers. The request
+routing through CSELR or the DMAMUX is done by the same calls.
+dma_xfer_commit() and dma_xfer_start() then write these values with one store
+per register instead of a read-modify-write sequence per setting, which makes
+it cheap to reconfigure a channel before every transfer.
+
+The same calls are available for the stream controller of F2/F4/F7.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <libopencm3/stm32/dma_xfer.h>
+
+/* Size field value for a data size in bytes. */
+static uint32_t dma_xfer_size(uint8_t bytes)
+{
+	return (bytes == 4) ? 2 : ((bytes == 2) ? 1 : 0);
+}
+
+static void dma_xfer_route(uint32_t dma, uint8_t channel, uint8_t request)
+{
+#if defined(STM32G0) || defined(STM32G4)
+	uint8_t mux = (dma == DMA1) ? channel :
+		      channel + DMA_XFER_DMA1_CHANNELS;
+	uint32_t reg32 = DMAMUX_CxCR(DMAMUX1, mux);
+
+	reg32 &= ~(DMAMUX_CxCR_DMAREQ_ID_MASK << DMAMUX_CxCR_DMAREQ_ID_SHIFT);
+	reg32 |= (request & DMAMUX_CxCR_DMAREQ_ID_MASK) <<
+		 DMAMUX_CxCR_DMAREQ_ID_SHIFT;
+	DMAMUX_CxCR(DMAMUX1, mux) = reg32;
+#elif defined(STM32F0) || defined(STM32L0) || defined(STM32L4)
+	uint32_t reg32 = DMA_CSELR(dma);
+
+	reg32 &= ~(DMA_CSELR_CxS_MASK << DMA_CSELR_CxS_SHIFT(channel));
+	reg32 |= (uint32_t)(request & DMA_CSELR_CxS_MASK) <<
+		 DMA_CSELR_CxS_SHIFT(channel);
+	DMA_CSELR(dma) = reg32;
+#else
+	(void)dma;
+	(void)channel;
+	(void)request;
+#endif
+}
+
+static void dma_xfer_write(const struct dma_xfer *xfer, uint32_t en)
+{
+	uint32_t dma = xfer->dma;
+	uint8_t channel = xfer->channel;
+
+	DMA_CCR(dma, channel) = 0;
+	dma_xfer_route(dma, channel, xfer->request);
+	DMA_CPAR(dma, channel) = xfer->par;
+	DMA_CMAR(dma, channel) = xfer->mar;
+	DMA_CNDTR(dma, channel) = xfer->ndtr;
+	DMA_IFCR(dma) = DMA_IFCR_CIF(channel);
+	DMA_CCR(dma, channel) = xfer->cr | en;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Transfer Prepare
+
+Compute the register values of a transfer. Does not access the hardware, so a
+transfer can be prepared once and committed many times.
+
+@param[out] xfer Register values
+@param[in] cfg Transfer description
+*/
+
+void dma_xfer_prepare(struct dma_xfer *xfer,
+		      const struct dma_xfer_config *cfg)
+{
+	uint32_t cr;
+
+	cr = ((uint32_t)(cfg->priority & 3) << DMA_CCR_PL_SHIFT) |
+	     (dma_xfer_size(cfg->msize) << DMA_CCR_MSIZE_SHIFT) |
+	     (dma_xfer_size(cfg->psize) << DMA_CCR_PSIZE_SHIFT);
+	if (cfg->dir == DMA_XFER_MEM_TO_PERIPH) {
+		cr |= DMA_CCR_DIR;
+	} else if (cfg->dir == DMA_XFER_MEM_TO_MEM) {
+		cr |= DMA_CCR_MEM2MEM;
+	}
+	if (cfg->minc) {
+		cr |= DMA_CCR_MINC;
+	}
+	if (cfg->pinc) {
+		cr |= DMA_CCR_PINC;
+	}
+	if (cfg->circular && cfg->dir != DMA_XFER_MEM_TO_MEM) {
+		cr |= DMA_CCR_CIRC;
+	}
+	if (cfg->irq & DMA_XFER_IRQ_TC) {
+		cr |= DMA_CCR_TCIE;
+	}
+	if (cfg->irq & DMA_XFER_IRQ_HT) {
+		cr |= DMA_CCR_HTIE;
+	}
+	if (cfg->irq & DMA_XFER_IRQ_TE) {
+		cr |= DMA_CCR_TEIE;
+	}
+
+	xfer->dma = cfg->dma;
+	xfer->channel = cfg->channel;
+	xfer->request = cfg->request;
+	xfer->cr = cr;
+	xfer->ndtr = cfg->count;
+	xfer->par = cfg->paddr;
+	xfer->mar = cfg->maddr;
+	xfer->fcr = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Transfer Commit
+
+Disable the channel, route its request, clear its flags and write the prepared
+register values. The channel is left disabled.
+
+@param[in] xfer Register values
+*/
+
+void dma_xfer_commit(const struct dma_xfer *xfer)
+{
+	dma_xfer_write(xfer, 0);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Transfer Start
+
+As dma_xfer_commit(), with the channel enabled by the last store.
+
+@param[in] xfer Register values
+*/
+
+void dma_xfer_start(const struct dma_xfer *xfer)
+{
+	dma_xfer_write(xfer, DMA_CCR_EN);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Transfer Restart
+
+Start a committed channel again on a new buffer, keeping the other settings.
+
+@param[in] dma DMA controller base address
+@param[in] channel Channel number
+@param[in] maddr Memory address
+@param[in] count Number of data items
+*/
+
+void dma_xfer_restart(uint32_t dma, uint8_t channel, uint32_t maddr,
+		      uint16_t count)
+{
+	/* Channels stay enabled after a transfer, the counter is only
+	 * writable while disabled. */
+	DMA_CCR(dma, channel) &= ~DMA_CCR_EN;
+	DMA_CMAR(dma, channel) = maddr;
+	DMA_CNDTR(dma, channel) = count;
+	DMA_IFCR(dma) = DMA_IFCR_CIF(channel);
+	DMA_CCR(dma, channel) |= DMA_CCR_EN;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Transfer Stop
+
+@param[in] dma DMA controller base address
+@param[in] channel Channel number
+*/
+
+void dma_xfer_stop(uint32_t dma, uint8_t channel)
+{
+	DMA_CCR(dma, channel) &= ~DMA_CCR_EN;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Transfer Set Memory Increment
+
+The channel must be stopped.
+
+@param[in] dma DMA controller base address
+@param[in] channel Channel number
+@param[in] minc Increment the memory address
+*/
+
+void dma_xfer_set_minc(uint32_t dma, uint8_t channel, bool minc)
+{
+	if (minc) {
+		DMA_CCR(dma, channel) |= DMA_CCR_MINC;
+	} else {
+		DMA_CCR(dma, channel) &= ~DMA_CCR_MINC;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Transfer Get Flags
+
+Read and acknowledge the transfer complete, half transfer and transfer error
+flags of a channel.
+
+@param[in] dma DMA controller base address
+@param[in] channel Channel number
+@returns Set flags, a combination of DMA_TCIF, DMA_HTIF and DMA_TEIF.
+*/
+
+uint32_t dma_xfer_get_flags(uint32_t dma, uint8_t channel)
+{
+	uint32_t flags;
+
+	flags = (DMA_ISR(dma) >> DMA_FLAG_OFFSET(channel)) &
+		(DMA_TCIF | DMA_HTIF | DMA_TEIF);
+	if (flags) {
+		DMA_IFCR(dma) = flags << DMA_FLAG_OFFSET(channel);
+	}
+	return flags;
+}
+
+/**@}*/
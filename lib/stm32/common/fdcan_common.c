@@ -18,6 +18,7 @@
  */
 
 #include <libopencm3/stm32/fdcan.h>
+#include <libopencm3/stm32/can_filter.h>
 #include <libopencm3/stm32/rcc.h>
 #include <stddef.h>
 
@@ -229,6 +230,101 @@ uint8_t fdcan_dlc_to_length(uint32_t dlc)
 	}
 }
 
+/** Fills transmit buffer element from frame structure.
+ *
+ * @param [in] frame Frame to be sent.
+ * @param [out] tx_buffer Transmit buffer element in message RAM.
+ * @returns FDCAN_E_OK on success, FDCAN_E_INVALID if frame length cannot
+ * be encoded into DLC.
+ */
+static int fdcan_frame_to_txbuf(const struct fdcan_frame *frame,
+		struct fdcan_tx_buffer_element *tx_buffer)
+{
+	uint32_t dlc, id_flags, flags = 0;
+
+	dlc = fdcan_length_to_dlc(frame->length);
+	if (dlc == 0xFF) {
+		return FDCAN_E_INVALID;
+	}
+
+	if (frame->flags & FDCAN_FRAME_EXT) {
+		id_flags = FDCAN_FIFO_XTD
+			| ((frame->id & FDCAN_FIFO_EID_MASK) << FDCAN_FIFO_EID_SHIFT);
+	} else {
+		id_flags = (frame->id & FDCAN_FIFO_SID_MASK) << FDCAN_FIFO_SID_SHIFT;
+	}
+
+	if (frame->flags & FDCAN_FRAME_RTR) {
+		id_flags |= FDCAN_FIFO_RTR;
+	}
+
+	if (frame->flags & FDCAN_FRAME_ESI) {
+		id_flags |= FDCAN_FIFO_ESI;
+	}
+
+	if (frame->flags & FDCAN_FRAME_FDF) {
+		flags |= FDCAN_FIFO_FDF;
+	}
+
+	if (frame->flags & FDCAN_FRAME_BRS) {
+		flags |= FDCAN_FIFO_BRS;
+	}
+
+	tx_buffer->identifier_flags = id_flags;
+	tx_buffer->evt_fmt_dlc_res = (dlc << FDCAN_FIFO_DLC_SHIFT) | flags;
+
+	for (unsigned q = 0; q < frame->length; q += 4) {
+		tx_buffer->data[q / 4] = frame->data[q / 4];
+	}
+
+	return FDCAN_E_OK;
+}
+
+/** Fills frame structure from receive FIFO element.
+ *
+ * @param [in] fifo Receive FIFO element in message RAM.
+ * @param [out] frame Received frame.
+ */
+static void fdcan_rxfifo_to_frame(const struct fdcan_rx_fifo_element *fifo,
+		struct fdcan_frame *frame)
+{
+	uint32_t id_flags = fifo->identifier_flags;
+	uint32_t dlc_ts = fifo->filt_fmt_dlc_ts;
+
+	frame->flags = 0;
+	if (id_flags & FDCAN_FIFO_XTD) {
+		frame->flags |= FDCAN_FRAME_EXT;
+		frame->id = (id_flags >> FDCAN_FIFO_EID_SHIFT) & FDCAN_FIFO_EID_MASK;
+	} else {
+		frame->id = (id_flags >> FDCAN_FIFO_SID_SHIFT) & FDCAN_FIFO_SID_MASK;
+	}
+
+	if (id_flags & FDCAN_FIFO_RTR) {
+		frame->flags |= FDCAN_FRAME_RTR;
+	}
+
+	if (id_flags & FDCAN_FIFO_ESI) {
+		frame->flags |= FDCAN_FRAME_ESI;
+	}
+
+	if (dlc_ts & FDCAN_FIFO_FDF) {
+		frame->flags |= FDCAN_FRAME_FDF;
+	}
+
+	if (dlc_ts & FDCAN_FIFO_BRS) {
+		frame->flags |= FDCAN_FRAME_BRS;
+	}
+
+	frame->length = fdcan_dlc_to_length((dlc_ts >> FDCAN_FIFO_DLC_SHIFT)
+		& FDCAN_FIFO_DLC_MASK);
+	frame->fmi = (dlc_ts >> FDCAN_FIFO_MM_SHIFT) & FDCAN_FIFO_MM_MASK;
+	frame->timestamp = (dlc_ts >> FDCAN_FIFO_RXTS_SHIFT) & FDCAN_FIFO_RXTS_MASK;
+
+	for (unsigned q = 0; q < frame->length; q += 4) {
+		frame->data[q / 4] = fifo->data[q / 4];
+	}
+}
+
 /* --- FD-CAN functions ----------------------------------------------------- */
 
 /** @ingroup fdcan_file */
@@ -470,6 +566,69 @@ void fdcan_set_ext_filter(uint32_t canport, uint32_t nr,
 		| ((id2 & FDCAN_EFID2_MASK) << FDCAN_EFID2_SHIFT);
 }
 
+/** Load a compiled filter set.
+ *
+ * Configures as many standard and extended filter elements as the set needs
+ * using @ref fdcan_init_filter, programs them and makes the FDCAN reject the
+ * frames not matched by any element. Must be called while the FDCAN block is
+ * in INIT mode.
+ *
+ * @param [in] set Filter set compiled with @ref can_filter_compile_fdcan.
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ */
+void fdcan_filter_apply(const struct can_filter_set *set, uint32_t canport)
+{
+	const struct can_filter_entry *e;
+	uint32_t id2;
+	uint16_t i, n;
+	bool dual;
+
+	fdcan_init_filter(canport, set->std_elements, set->ext_elements);
+
+	for (i = 0; i < set->count; i += n) {
+		e = &set->buf[i];
+		n = 1;
+		while (i + n < set->count && set->buf[i + n].ext == e->ext &&
+		       set->buf[i + n].filter == e->filter) {
+			n++;
+		}
+
+		dual = e->type == CAN_FILTER_DUAL;
+		if (dual) {
+			id2 = (n > 1) ? set->buf[i + 1].id : e->id;
+		} else {
+			id2 = e->id2;
+		}
+
+		if (e->ext) {
+			fdcan_set_ext_filter(canport, e->filter,
+					     dual ? FDCAN_EFT_DUAL :
+					     FDCAN_EFT_RANGE_NOXIDAM,
+					     e->id, id2,
+					     e->fifo ? FDCAN_EFEC_FIFO1 :
+					     FDCAN_EFEC_FIFO0);
+		} else {
+			fdcan_set_std_filter(canport, e->filter,
+					     dual ? FDCAN_SFT_DUAL :
+					     FDCAN_SFT_RANGE,
+					     e->id, id2,
+					     e->fifo ? FDCAN_SFEC_FIFO1 :
+					     FDCAN_SFEC_FIFO0);
+		}
+	}
+
+	/* Reject frames that do not match any element. */
+#if defined(FDCAN_RXGFC)
+	FDCAN_RXGFC(canport) |=
+		(FDCAN_RXGFC_ANFS_MASK << FDCAN_RXGFC_ANFS_SHIFT) |
+		(FDCAN_RXGFC_ANFE_MASK << FDCAN_RXGFC_ANFE_SHIFT);
+#else
+	FDCAN_GFC(canport) |=
+		(FDCAN_GFC_ANFS_MASK << FDCAN_GFC_ANFS_SHIFT) |
+		(FDCAN_GFC_ANFE_MASK << FDCAN_GFC_ANFE_SHIFT);
+#endif
+}
+
 /** Transmit Message using FDCAN
  *
  * @param [in] canport CAN block register base. See @ref fdcan_block.
@@ -694,6 +853,181 @@ bool fdcan_available_rx(uint32_t canport, uint8_t fifo)
 	return (pending_frames != 0);
 }
 
+/** Receive burst of messages from FDCAN FIFO
+ *
+ * Copies up to @p count messages from receive FIFO into frame structures.
+ * Fill level of the FIFO is read once and all copied messages are released
+ * by a single write to the acknowledge register. Payload is copied in 32bit
+ * words.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @param [in] fifo_id FIFO id.
+ * @param [out] frames Array of frames to receive into.
+ * @param [in] count Size of @p frames array.
+ * @returns Number of frames received, 0 if FIFO is empty.
+ */
+unsigned fdcan_rx_burst(uint32_t canport, uint8_t fifo_id,
+		struct fdcan_frame *frames, unsigned count)
+{
+	unsigned pending_frames, get_index, size, element_size, n;
+	const uint8_t *base;
+
+	fdcan_get_fill_rxfifo(canport, fifo_id, &get_index, &pending_frames);
+	if (pending_frames == 0 || count == 0) {
+		return 0;
+	}
+
+	size = fdcan_get_rxfifo_size(canport, fifo_id);
+	element_size = fdcan_get_fifo_element_size(canport, fifo_id);
+	base = (const uint8_t *)fdcan_get_rxfifo_addr(canport, fifo_id, 0);
+
+	n = (pending_frames < count) ? pending_frames : count;
+	for (unsigned i = 0; i < n; i++) {
+		const struct fdcan_rx_fifo_element *fifo =
+			(const struct fdcan_rx_fifo_element *)
+			(base + get_index * element_size);
+
+		fdcan_rxfifo_to_frame(fifo, &frames[i]);
+
+		if (i + 1 < n && ++get_index == size) {
+			get_index = 0;
+		}
+	}
+
+	/* Acknowledging the last index releases all older messages as well. */
+	FDCAN_RXFIA(canport, fifo_id) = get_index << FDCAN_RXFIFO_AI_SHIFT;
+
+	return n;
+}
+
+/** Transmit burst of messages using FDCAN
+ *
+ * Writes up to @p count messages into free transmit buffers and requests
+ * their transmission by a single write to the add request register. In FIFO
+ * mode the free level and put index are read once and the buffers are filled
+ * in FIFO order. In queue mode, set up by tx_queue_mode of
+ * @ref fdcan_set_can, pending requests are read once, any free buffer is used
+ * and the frames are sent in order of their ID.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @param [in] frames Array of frames to send.
+ * @param [in] count Number of frames in @p frames array.
+ * @returns Number of frames queued. Less than @p count if transmit buffers
+ * ran out or a frame with invalid length was found.
+ */
+unsigned fdcan_tx_burst(uint32_t canport, const struct fdcan_frame *frames,
+		unsigned count)
+{
+	unsigned size = fdcan_get_txfifo_size(canport);
+	unsigned element_size = fdcan_get_txbuf_element_size(canport);
+	uint8_t *base = (uint8_t *)fdcan_get_txbuf_addr(canport, 0);
+	uint32_t pending = 0, request = 0;
+	unsigned n = 0, idx, slots;
+
+	if (FDCAN_TXBC(canport) & FDCAN_TXBC_TFQM) {
+		pending = FDCAN_TXBRP(canport);
+		idx = 0;
+		slots = size;
+	} else {
+		uint32_t txfqs = FDCAN_TXFQS(canport);
+
+		idx = (txfqs >> FDCAN_TXFQS_TFQPI_SHIFT) & FDCAN_TXFQS_TFQPI_MASK;
+		slots = (txfqs >> FDCAN_TXFQS_TFFL_SHIFT) & FDCAN_TXFQS_TFFL_MASK;
+	}
+
+	for (; slots && n < count; slots--) {
+		if ((pending & (1U << idx)) == 0) {
+			struct fdcan_tx_buffer_element *tx_buffer =
+				(struct fdcan_tx_buffer_element *)
+				(base + idx * element_size);
+
+			if (fdcan_frame_to_txbuf(&frames[n], tx_buffer) != FDCAN_E_OK) {
+				break;
+			}
+			request |= 1U << idx;
+			n++;
+		}
+		if (++idx == size) {
+			idx = 0;
+		}
+	}
+
+	if (request) {
+		FDCAN_TXBAR(canport) = request;
+	}
+
+	return n;
+}
+
+/** Peek at messages in FDCAN receive FIFO
+ *
+ * Provides pointers to up to @p count pending messages directly in message
+ * RAM, in reception order, without copying them. Fill level of the FIFO is
+ * read once. Message RAM can only be accessed in 32bit quantities. The
+ * messages stay valid until they are released using @ref fdcan_rx_release.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @param [in] fifo_id FIFO id.
+ * @param [out] elements Array receiving pointers to FIFO elements.
+ * @param [in] count Size of @p elements array.
+ * @returns Number of pointers stored, 0 if FIFO is empty.
+ */
+unsigned fdcan_rx_peek(uint32_t canport, uint8_t fifo_id,
+		const struct fdcan_rx_fifo_element **elements, unsigned count)
+{
+	unsigned pending_frames, get_index, size, element_size, n;
+	const uint8_t *base;
+
+	fdcan_get_fill_rxfifo(canport, fifo_id, &get_index, &pending_frames);
+	if (pending_frames == 0) {
+		return 0;
+	}
+
+	size = fdcan_get_rxfifo_size(canport, fifo_id);
+	element_size = fdcan_get_fifo_element_size(canport, fifo_id);
+	base = (const uint8_t *)fdcan_get_rxfifo_addr(canport, fifo_id, 0);
+
+	n = (pending_frames < count) ? pending_frames : count;
+	for (unsigned i = 0; i < n; i++) {
+		elements[i] = (const struct fdcan_rx_fifo_element *)
+			(base + get_index * element_size);
+		if (++get_index == size) {
+			get_index = 0;
+		}
+	}
+
+	return n;
+}
+
+/** Release messages in FDCAN receive FIFO
+ *
+ * Releases the oldest @p count messages of receive FIFO with a single write
+ * to the acknowledge register. Used after @ref fdcan_rx_peek.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @param [in] fifo_id FIFO id.
+ * @param [in] count Number of messages to release. Must not exceed the
+ * number of pending messages.
+ */
+void fdcan_rx_release(uint32_t canport, uint8_t fifo_id, unsigned count)
+{
+	unsigned pending_frames, get_index, size;
+
+	if (count == 0) {
+		return;
+	}
+
+	fdcan_get_fill_rxfifo(canport, fifo_id, &get_index, &pending_frames);
+	size = fdcan_get_rxfifo_size(canport, fifo_id);
+
+	/* Acknowledging an index releases all older messages as well. */
+	get_index += count - 1;
+	if (get_index >= size) {
+		get_index -= size;
+	}
+	FDCAN_RXFIA(canport, fifo_id) = get_index << FDCAN_RXFIFO_AI_SHIFT;
+}
+
 /**@}*/
 
 
@@ -24,8 +24,14 @@
 
 /**@{*/
 
+#include <stddef.h>
+#include <libopencm3/cm3/dwt.h>
 #include <libopencm3/stm32/flash.h>
 
+#define FLASH_SR_PROGRAM_ERRORS	(FLASH_SR_SEQERR | FLASH_SR_PGPERR | \
+				 FLASH_SR_PGAERR | FLASH_SR_WRPERR | \
+				 FLASH_SR_OPERR)
+
 /*---------------------------------------------------------------------------*/
 /** @brief Set the Program Parallelism Size
 
@@ -190,6 +196,122 @@ void flash_program_byte(uint32_t address, uint8_t data)
 	FLASH_CR &= ~FLASH_CR_PG;		/* Disable the PG bit. */
 }
 
+/*---------------------------------------------------------------------------*/
+/** @brief Get the Widest Program Parallelism
+
+Get the widest programming word width allowed at a supply voltage, following
+the table in the programming manual.
+
+@param[in] vdd_mv Lowest supply voltage in mV during programming
+@param[in] vpp An external programming voltage is applied to VPP
+@returns The programming word width, one of: @ref flash_cr_program_width
+*/
+
+uint32_t flash_get_program_size(uint16_t vdd_mv, bool vpp)
+{
+	if (vdd_mv >= 2700) {
+		return vpp ? FLASH_CR_PROGRAM_X64 : FLASH_CR_PROGRAM_X32;
+	}
+	if (vdd_mv >= 2100) {
+		return FLASH_CR_PROGRAM_X16;
+	}
+	return FLASH_CR_PROGRAM_X8;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Program a Data Block to FLASH with Wide Words
+
+This programs an arbitrary length data block to FLASH memory, using flash
+words of up to the given width. Unaligned head and tail bytes are programmed
+with narrower words. The program size is only changed at these boundaries and
+programming stays enabled for the whole block, so each flash word costs one
+write and one busy wait.
+
+Programming stops at the first error. The flash must be unlocked and erased.
+
+@param[in] address Starting address in Flash.
+@param[in] data Pointer to start of data block.
+@param[in] len Length of data block.
+@param[in] program_size Widest programming word width allowed by the supply
+voltage, one of: @ref flash_cr_program_width, see flash_get_program_size().
+@param[out] stats Statistics of the block, or NULL
+@returns 0, or the error flags of FLASH_SR that stopped programming.
+*/
+
+uint32_t flash_program_bulk(uint32_t address, const uint8_t *data,
+			    uint32_t len, uint32_t program_size,
+			    struct flash_program_stats *stats)
+{
+	uint32_t start = dwt_read_cycle_counter();
+	uint32_t psize = 0xff;
+	uint32_t ops = 0;
+	uint32_t done = 0;
+	uint32_t sr = 0;
+
+	flash_wait_for_last_operation();
+	FLASH_SR = FLASH_SR_PROGRAM_ERRORS;
+	FLASH_CR |= FLASH_CR_PG;
+
+	while (len) {
+		uint32_t w = 1 << program_size;
+		uint32_t lo = 0, hi = 0;
+		uint32_t ps = program_size;
+		uint32_t i;
+
+		while (w > 1 && ((address & (w - 1)) || len < w)) {
+			w >>= 1;
+			ps--;
+		}
+		if (ps != psize) {
+			flash_set_program_size(ps);
+			psize = ps;
+		}
+
+		for (i = 0; i < w; i++) {
+			if (i < 4) {
+				lo |= (uint32_t)data[i] << (8 * i);
+			} else {
+				hi |= (uint32_t)data[i] << (8 * (i - 4));
+			}
+		}
+		switch (w) {
+		case 8:
+			MMIO32(address) = lo;
+			MMIO32(address + 4) = hi;
+			break;
+		case 4:
+			MMIO32(address) = lo;
+			break;
+		case 2:
+			MMIO16(address) = lo;
+			break;
+		default:
+			MMIO8(address) = lo;
+			break;
+		}
+
+		flash_wait_for_last_operation();
+		sr = FLASH_SR & FLASH_SR_PROGRAM_ERRORS;
+		if (sr) {
+			break;
+		}
+		address += w;
+		data += w;
+		len -= w;
+		done += w;
+		ops++;
+	}
+
+	FLASH_CR &= ~FLASH_CR_PG;
+
+	if (stats) {
+		stats->bytes = done;
+		stats->operations = ops;
+		stats->cycles = dwt_read_cycle_counter() - start;
+	}
+	return sr;
+}
+
 /*---------------------------------------------------------------------------*/
 /** @brief Program a Data Block to FLASH
 
@@ -197,6 +319,9 @@ This programs an arbitrary length data block to FLASH memory.
 The program error flag should be checked separately for the event that memory
 was not properly erased.
 
+Bytes are programmed one at a time, which is allowed at any supply voltage.
+Use flash_program_bulk() to program with wider words.
+
 @param[in] address Starting address in Flash.
 @param[in] data Pointer to start of data block.
 @param[in] len Length of data block.
@@ -204,13 +329,7 @@ was not properly erased.
 
 void flash_program(uint32_t address, const uint8_t *data, uint32_t len)
 {
-	/* TODO: Use dword and word size program operations where possible for
-	 * turbo speed.
-	 */
-	uint32_t i;
-	for (i = 0; i < len; i++) {
-		flash_program_byte(address+i, data[i]);
-	}
+	flash_program_bulk(address, data, len, FLASH_CR_PROGRAM_X8, NULL);
 }
 
 /*---------------------------------------------------------------------------*/
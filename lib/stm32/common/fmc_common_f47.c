@@ -28,6 +28,7 @@ STM32F7xx series of ARM Cortex Microcontrollers by ST Microelectronics.
 
 #include <stdint.h>
 #include <libopencm3/stm32/fsmc.h>
+#include <libopencm3/stm32/rcc.h>
 
 /**@{*/
 
@@ -108,4 +109,148 @@ sdram_command(enum fmc_sdram_bank bank,
 	FMC_SDCMR = tmp_reg;
 }
 
+/* Clock cycles needed to cover ns nanoseconds at f Hz, rounded up. */
+static int sdram_cycles(uint32_t ns, uint32_t f)
+{
+	uint32_t n = ((uint64_t)ns * f + 999999999) / 1000000000;
+
+	return (n < 1) ? 1 : ((n > 17) ? 17 : n);
+}
+
+/* Current HCLK, the FMC kernel clock. */
+static uint32_t sdram_hclk(void)
+{
+#if defined(STM32H7)
+	return rcc_get_bus_clk_freq(RCC_AHBCLK);
+#else
+	return rcc_ahb_frequency;
+#endif
+}
+
+static void sdram_delay_us(uint32_t us)
+{
+	/* At least one HCLK cycle per loop iteration. */
+	uint32_t n = us * (sdram_hclk() / 1000000);
+
+	while (n--) {
+		__asm__("nop");
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief SDRAM Setup
+
+Configure an SDRAM bank from the device data sheet values and run the JEDEC
+initialisation sequence: clock enable, power up delay, precharge all, eight
+auto refresh cycles and the mode register load. The refresh timer is then
+programmed for the refresh period.
+
+The SDRAM clock is the fastest of HCLK/2 and HCLK/3 that the device supports,
+and all cycle counts are computed from the current HCLK (rcc_ahb_frequency,
+or the AHB clock of rcc_get_bus_clk_freq() on H7), so this must be called
+after the system clock has been set up. The GPIOs and the FMC clock must be
+enabled.
+
+Read bursts let the controller fetch the following data of a row while the
+AHB is still busy, which helps sequential readers such as the LTDC and the
+DMA2D. The read pipe delays the sampling of read data for fast HCLKs.
+
+@param[in] bank SDRAM_BANK1 or SDRAM_BANK2
+@param[in] dev Device description
+@returns 0, or -1 if the device is too slow for HCLK/3, a timing does not fit
+the 4 bit fields or the geometry is invalid.
+*/
+int sdram_setup(enum fmc_sdram_bank bank, const struct sdram_device *dev)
+{
+	struct sdram_timing t;
+	uint32_t hclk = sdram_hclk();
+	uint32_t f, cr, tr, count, mode;
+	int i = (bank == SDRAM_BANK2) ? 1 : 0;
+	int div;
+
+	if (bank == SDRAM_BOTH_BANKS || dev->columns < 8 ||
+	    dev->columns > 11 || dev->rows < 11 || dev->rows > 13 ||
+	    dev->cas < 1 || dev->cas > 3 || dev->read_pipe > 2 ||
+	    dev->refresh_rows == 0) {
+		return -1;
+	}
+
+	for (div = 2; div <= 3; div++) {
+		if (hclk / div <= dev->max_clock) {
+			break;
+		}
+	}
+	if (div > 3) {
+		return -1;
+	}
+	f = hclk / div;
+
+	t.trcd = sdram_cycles(dev->trcd_ns, f);
+	t.trp = sdram_cycles(dev->trp_ns, f);
+	t.trc = sdram_cycles(dev->trc_ns, f);
+	t.tras = sdram_cycles(dev->tras_ns, f);
+	t.txsr = sdram_cycles(dev->txsr_ns, f);
+	t.tmrd = dev->tmrd;
+	/* The controller requires TWR >= TRAS - TRCD and
+	 * TWR >= TRC - TRCD - TRP. */
+	t.twr = sdram_cycles(dev->twr_ns, f);
+	if (t.twr < t.tras - t.trcd) {
+		t.twr = t.tras - t.trcd;
+	}
+	if (t.twr < t.trc - t.trcd - t.trp) {
+		t.twr = t.trc - t.trcd - t.trp;
+	}
+	if (t.trcd > 16 || t.trp > 16 || t.twr > 16 || t.trc > 16 ||
+	    t.tras > 16 || t.txsr > 16 || t.tmrd > 16) {
+		return -1;
+	}
+	if (t.tmrd < 1) {
+		t.tmrd = 1;
+	}
+
+	cr = ((dev->columns - 8) << FMC_SDCR_NC_SHIFT) |
+	     ((dev->rows - 11) << FMC_SDCR_NR_SHIFT) |
+	     ((dev->width == 32) ? FMC_SDCR_MWID_32b :
+	      (dev->width == 16) ? FMC_SDCR_MWID_16b : FMC_SDCR_MWID_8b) |
+	     ((dev->banks == 4) ? FMC_SDCR_NB4 : FMC_SDCR_NB2) |
+	     ((uint32_t)dev->cas << FMC_SDCR_CAS_SHIFT) |
+	     ((uint32_t)div << FMC_SDCR_SDCLK_SHIFT) |
+	     ((uint32_t)dev->read_pipe << FMC_SDCR_RPIPE_SHIFT);
+	if (dev->read_burst) {
+		cr |= FMC_SDCR_RBURST;
+	}
+	tr = sdram_timing(&t);
+
+	if (i == 1) {
+		/* Clock, burst and pipe, TRP and TRC only exist in bank 1. */
+		FMC_SDCR1 = (FMC_SDCR1 & ~FMC_SDCR_DNC_MASK) |
+			    (cr & FMC_SDCR_DNC_MASK);
+		FMC_SDTR1 = (FMC_SDTR1 & ~FMC_SDTR_DNC_MASK) |
+			    (tr & FMC_SDTR_DNC_MASK);
+	}
+	FMC_SDCR(i) = cr;
+	FMC_SDTR(i) = tr;
+
+	sdram_command(bank, SDRAM_CLK_CONF, 0, 0);
+	sdram_delay_us(dev->power_up_us);
+	sdram_command(bank, SDRAM_PALL, 0, 0);
+	sdram_command(bank, SDRAM_AUTO_REFRESH, 7, 0);
+	mode = SDRAM_MODE_BURST_LENGTH_1 | SDRAM_MODE_BURST_TYPE_SEQUENTIAL |
+	       ((uint32_t)dev->cas << 4) | SDRAM_MODE_OPERATING_MODE_STANDARD |
+	       SDRAM_MODE_WRITEBURST_MODE_SINGLE;
+	sdram_command(bank, SDRAM_LOAD_MODE, 0, mode);
+
+	/* Refresh rate minus a margin of 20 cycles, as in the reference
+	 * manual. */
+	count = (uint64_t)dev->refresh_ms * f / 1000 / dev->refresh_rows;
+	count = (count > 61) ? count - 20 : 41;
+	if (count > 0x1fff) {
+		count = 0x1fff;
+	}
+	while (FMC_SDSR & FMC_SDSR_BUSY);
+	FMC_SDRTR = (FMC_SDRTR & ~FMC_SDRTR_COUNT_MASK) |
+		    (count << FMC_SDRTR_COUNT_SHIFT);
+	return 0;
+}
+
 /**@}*/
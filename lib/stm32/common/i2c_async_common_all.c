@@ -0,0 +1,326 @@
+/** @addtogroup i2c_async_file I2C asynchronous master
+
+@ingroup STM32F_files
+
+@brief <b>libopencm3 STM32 I2C asynchronous master engine</b>
+
+@version 1.0.0
+
+Transactions are queued with i2c_async_submit() and executed back to back by
+an interrupt driven state machine. Each transaction is a write followed by a
+read with a repeated start in between and completes with a status and a call
+of its callback from interrupt context; the CPU is free while the bytes are on
+the bus.
+
+On the I2C peripheral with TIMINGR the data phases can be offloaded to DMA.
+The event interrupt is then only taken at the start, at every 255 byte reload
+and at the end of each transaction.
+
+A transaction that is not acknowledged is terminated with a stop condition
+and reported as @ref I2C_ASYNC_NACK. Bus errors and lost arbitration reset the
+peripheral. If the application calls i2c_async_tick() periodically, a
+transaction that does not finish within its timeout is aborted and the bus is
+freed by clocking out a slave that holds SDA low.
+
+The I2C must be configured for master mode with its clock and speed set up,
+and its event and error interrupts (a single one on F0/G0/L0) must be enabled
+in the NVIC and call i2c_async_irq(). When DMA is used, its streams/channels
+are claimed from the @ref dma_mgr_defines "DMA manager". Their interrupts need
+not be enabled; if they are, at the priority of the I2C interrupts and calling
+dma_mgr_irq(), a DMA transfer error ends the transaction at once instead of at
+its timeout.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/rcc.h>
+#include "i2c_async_private.h"
+
+/* Start the transaction at the head of the queue, if any. */
+static void i2c_async_run(struct i2c_async *ia)
+{
+	struct i2c_async_xfer *xfer;
+
+	CM_CRITICAL_BLOCK() {
+		xfer = ia->head;
+		if (xfer == NULL) {
+			ia->busy = false;
+		} else {
+			ia->ticks = xfer->timeout;
+		}
+	}
+	if (xfer) {
+		i2c_async_hw_start(ia, xfer);
+	}
+}
+
+/* Finish the transaction at the head of the queue and start the next one. */
+void i2c_async_done(struct i2c_async *ia, int status)
+{
+	struct i2c_async_xfer *xfer = ia->head;
+
+	CM_CRITICAL_BLOCK() {
+		ia->head = xfer->next;
+		if (ia->head == NULL) {
+			ia->tail = NULL;
+		}
+		ia->ticks = 0;
+	}
+
+	switch (status) {
+	case I2C_ASYNC_NACK:
+		ia->nacks++;
+		break;
+	case I2C_ASYNC_BUS_ERROR:
+	case I2C_ASYNC_ARB_LOST:
+		ia->bus_errors++;
+		break;
+	case I2C_ASYNC_TIMEOUT:
+		ia->timeouts++;
+		break;
+	default:
+		break;
+	}
+
+	xfer->status = status;
+	if (xfer->callback) {
+		xfer->callback(ia, xfer);
+	}
+	i2c_async_run(ia);
+}
+
+/* Roughly a quarter of a 100 kHz clock period. */
+static void i2c_async_delay(void)
+{
+	uint32_t i;
+
+	for (i = rcc_ahb_frequency / 800000; i > 0; i--) {
+		__asm__("nop");
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief I2C Async Initialise Engine
+
+Set up the event and error interrupts of the I2C and, if enabled, claim and
+configure the DMA streams/channels. The queue is emptied and the statistics
+are reset.
+
+@param[in] ia Engine, the configuration members must be filled in.
+@returns 0, or the error of dma_mgr_claim() when DMA is used.
+*/
+
+int i2c_async_init(struct i2c_async *ia)
+{
+	ia->head = NULL;
+	ia->tail = NULL;
+	ia->busy = false;
+	ia->nacks = 0;
+	ia->bus_errors = 0;
+	ia->timeouts = 0;
+
+	return i2c_async_hw_init(ia);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief I2C Async Submit Transaction
+
+Append a transaction to the queue. If the engine is idle the transaction is
+started immediately. May be called from interrupt context, including
+completion callbacks.
+
+@param[in] ia Engine
+@param[in] xfer Transaction, owned by the caller until its callback has run.
+*/
+
+void i2c_async_submit(struct i2c_async *ia, struct i2c_async_xfer *xfer)
+{
+	bool start = false;
+
+	xfer->next = NULL;
+	xfer->status = I2C_ASYNC_OK;
+
+	CM_CRITICAL_BLOCK() {
+		if (ia->tail) {
+			ia->tail->next = xfer;
+		} else {
+			ia->head = xfer;
+		}
+		ia->tail = xfer;
+
+		if (!ia->busy) {
+			ia->busy = true;
+			start = true;
+		}
+	}
+
+	if (start) {
+		i2c_async_run(ia);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief I2C Async Timeout Tick
+
+Call periodically, for example from the systick handler, to enforce the
+transaction timeouts. A transaction that times out is aborted, the bus is
+recovered and the next transaction is started.
+
+@param[in] ia Engine
+*/
+
+void i2c_async_tick(struct i2c_async *ia)
+{
+	bool expired = false;
+
+	CM_CRITICAL_BLOCK() {
+		if (ia->busy && ia->ticks && --ia->ticks == 0) {
+			/* Stop the transaction, so that its interrupt cannot
+			 * finish it as well. */
+			i2c_async_hw_abort(ia);
+			expired = true;
+		}
+	}
+
+	if (expired) {
+		i2c_async_bus_recover(ia);
+		i2c_async_done(ia, I2C_ASYNC_TIMEOUT);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief I2C Async Engine Busy
+
+@param[in] ia Engine
+@returns true while transactions are queued or in progress.
+*/
+
+bool i2c_async_busy(struct i2c_async *ia)
+{
+	return ia->busy;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief I2C Async Recover Bus
+
+Free a bus that is held low by a slave which lost track of a transfer, for
+example after a reset of the master in the middle of a read. SCL is toggled as
+an open drain output up to nine times until the slave releases SDA, followed
+by a stop condition. The pins are returned to their alternate function
+afterwards.
+
+Called automatically after a timeout. Does nothing if no SCL port is set. The
+I2C peripheral must not be in the middle of a transaction.
+
+@param[in] ia Engine
+*/
+
+void i2c_async_bus_recover(struct i2c_async *ia)
+{
+	uint32_t scl_mode, sda_mode;
+#if defined(STM32F1)
+	volatile uint32_t *scl_reg, *sda_reg;
+	uint32_t scl_af = 0, sda_af = 0;
+#else
+	uint32_t scl_mask = 0, scl_out = 0, sda_mask = 0, sda_out = 0;
+#endif
+	int i;
+
+	if (ia->scl_port == 0) {
+		return;
+	}
+
+	gpio_set(ia->scl_port, ia->scl_pin);
+	gpio_set(ia->sda_port, ia->sda_pin);
+
+#if defined(STM32F1)
+	/* The pins must already be alternate function open drain, only the
+	 * CNF bit selecting the alternate function has to change. */
+	scl_reg = (ia->scl_pin & 0xff) ?
+		  &GPIO_CRL(ia->scl_port) : &GPIO_CRH(ia->scl_port);
+	sda_reg = (ia->sda_pin & 0xff) ?
+		  &GPIO_CRL(ia->sda_port) : &GPIO_CRH(ia->sda_port);
+	for (i = 0; i < 8; i++) {
+		if (ia->scl_pin & (0x0101 << i)) {
+			scl_af = 0x8 << (4 * i);
+		}
+		if (ia->sda_pin & (0x0101 << i)) {
+			sda_af = 0x8 << (4 * i);
+		}
+	}
+	scl_mode = *scl_reg;
+	sda_mode = *sda_reg;
+	*scl_reg &= ~scl_af;
+	*sda_reg &= ~sda_af;
+#else
+	for (i = 0; i < 16; i++) {
+		if (ia->scl_pin & (1 << i)) {
+			scl_mask = GPIO_MODE_MASK(i);
+			scl_out = GPIO_MODE(i, GPIO_MODE_OUTPUT);
+		}
+		if (ia->sda_pin & (1 << i)) {
+			sda_mask = GPIO_MODE_MASK(i);
+			sda_out = GPIO_MODE(i, GPIO_MODE_OUTPUT);
+		}
+	}
+	/* The output type must already be open drain for the I2C. */
+	scl_mode = GPIO_MODER(ia->scl_port);
+	sda_mode = GPIO_MODER(ia->sda_port);
+	GPIO_MODER(ia->scl_port) = (GPIO_MODER(ia->scl_port) & ~scl_mask) |
+				   scl_out;
+	GPIO_MODER(ia->sda_port) = (GPIO_MODER(ia->sda_port) & ~sda_mask) |
+				   sda_out;
+#endif
+
+	for (i = 0; i < 9 && !gpio_get(ia->sda_port, ia->sda_pin); i++) {
+		gpio_clear(ia->scl_port, ia->scl_pin);
+		i2c_async_delay();
+		i2c_async_delay();
+		gpio_set(ia->scl_port, ia->scl_pin);
+		i2c_async_delay();
+		i2c_async_delay();
+	}
+
+	/* Stop condition: SDA rises while SCL is high. */
+	gpio_clear(ia->scl_port, ia->scl_pin);
+	i2c_async_delay();
+	gpio_clear(ia->sda_port, ia->sda_pin);
+	i2c_async_delay();
+	gpio_set(ia->scl_port, ia->scl_pin);
+	i2c_async_delay();
+	gpio_set(ia->sda_port, ia->sda_pin);
+	i2c_async_delay();
+
+	/* SCL and SDA may share a port and mode register, so restore in
+	 * reverse order. */
+#if defined(STM32F1)
+	*sda_reg = sda_mode;
+	*scl_reg = scl_mode;
+#else
+	GPIO_MODER(ia->sda_port) = sda_mode;
+	GPIO_MODER(ia->scl_port) = scl_mode;
+#endif
+}
+
+/**@}*/
@@ -0,0 +1,248 @@
+/** @addtogroup i2c_async_file I2C asynchronous master
+
+@ingroup STM32F_files
+
+@brief <b>libopencm3 STM32 I2C asynchronous master engine, SR1/SR2
+peripheral</b>
+
+@version 1.0.0
+
+The peripheral has no byte counter, so the data is moved from the interrupt
+and the acknowledge and stop bits are timed for the last bytes of a read as
+described in the reference manual. The DMA members of @ref i2c_async are not
+used.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include "i2c_async_private.h"
+
+#define I2C_ASYNC_ERRORS	(I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_AF | \
+				 I2C_SR1_OVR)
+
+int i2c_async_hw_init(struct i2c_async *ia)
+{
+	I2C_CR2(ia->i2c) &= ~I2C_CR2_ITBUFEN;
+	I2C_CR2(ia->i2c) |= I2C_CR2_ITEVTEN | I2C_CR2_ITERREN;
+	return 0;
+}
+
+void i2c_async_hw_start(struct i2c_async *ia, struct i2c_async_xfer *xfer)
+{
+	/* The stop condition of the previous transaction must be sent. */
+	while (I2C_CR1(ia->i2c) & I2C_CR1_STOP);
+
+	ia->pos = 0;
+	ia->phase = (xfer->wn || !xfer->rn) ?
+		    I2C_ASYNC_PHASE_WRITE : I2C_ASYNC_PHASE_READ;
+	I2C_CR1(ia->i2c) &= ~(I2C_CR1_POS | I2C_CR1_ACK);
+	if (ia->phase == I2C_ASYNC_PHASE_READ && xfer->rn > 1) {
+		I2C_CR1(ia->i2c) |= I2C_CR1_ACK;
+	}
+	I2C_CR1(ia->i2c) |= I2C_CR1_START;
+}
+
+void i2c_async_hw_abort(struct i2c_async *ia)
+{
+	uint32_t cr1 = I2C_CR1(ia->i2c) & ~(I2C_CR1_START | I2C_CR1_STOP |
+					    I2C_CR1_ACK | I2C_CR1_POS);
+	uint32_t cr2 = I2C_CR2(ia->i2c) & ~I2C_CR2_ITBUFEN;
+	uint32_t oar1 = I2C_OAR1(ia->i2c);
+	uint32_t ccr = I2C_CCR(ia->i2c);
+	uint32_t trise = I2C_TRISE(ia->i2c);
+
+	/* A software reset clears the configuration as well. */
+	I2C_CR1(ia->i2c) = I2C_CR1_SWRST;
+	I2C_CR1(ia->i2c) = 0;
+	I2C_CR2(ia->i2c) = cr2;
+	I2C_OAR1(ia->i2c) = oar1;
+	I2C_CCR(ia->i2c) = ccr;
+	I2C_TRISE(ia->i2c) = trise;
+	I2C_CR1(ia->i2c) = cr1 | I2C_CR1_PE;
+}
+
+static void i2c_async_error(struct i2c_async *ia, uint32_t errs)
+{
+	uint32_t i2c = ia->i2c;
+
+	/* The error flags are cleared by writing zero. */
+	I2C_SR1(i2c) = ~errs;
+	I2C_CR2(i2c) &= ~I2C_CR2_ITBUFEN;
+
+	if (errs & I2C_SR1_ARLO) {
+		/* The peripheral has already fallen back to slave mode. */
+		i2c_async_done(ia, I2C_ASYNC_ARB_LOST);
+	} else if (errs & I2C_SR1_AF) {
+		I2C_CR1(i2c) |= I2C_CR1_STOP;
+		i2c_async_done(ia, I2C_ASYNC_NACK);
+	} else {
+		i2c_async_hw_abort(ia);
+		i2c_async_done(ia, I2C_ASYNC_BUS_ERROR);
+	}
+}
+
+static void i2c_async_addr(struct i2c_async *ia, struct i2c_async_xfer *xfer)
+{
+	uint32_t i2c = ia->i2c;
+
+	if (ia->phase == I2C_ASYNC_PHASE_WRITE) {
+		(void)I2C_SR2(i2c);
+		if (xfer->wn == 0) {
+			/* Address probe. */
+			I2C_CR1(i2c) |= I2C_CR1_STOP;
+			i2c_async_done(ia, I2C_ASYNC_OK);
+		} else {
+			I2C_CR2(i2c) |= I2C_CR2_ITBUFEN;
+		}
+		return;
+	}
+
+	/* The acknowledge of the first bytes is set up before ADDR is
+	 * cleared by reading SR2. */
+	if (xfer->rn == 1) {
+		I2C_CR1(i2c) &= ~I2C_CR1_ACK;
+		(void)I2C_SR2(i2c);
+		I2C_CR1(i2c) |= I2C_CR1_STOP;
+		I2C_CR2(i2c) |= I2C_CR2_ITBUFEN;
+	} else if (xfer->rn == 2) {
+		I2C_CR1(i2c) |= I2C_CR1_POS;
+		I2C_CR1(i2c) &= ~I2C_CR1_ACK;
+		(void)I2C_SR2(i2c);
+		I2C_CR2(i2c) &= ~I2C_CR2_ITBUFEN;
+	} else {
+		(void)I2C_SR2(i2c);
+		if (xfer->rn > 3) {
+			I2C_CR2(i2c) |= I2C_CR2_ITBUFEN;
+		} else {
+			I2C_CR2(i2c) &= ~I2C_CR2_ITBUFEN;
+		}
+	}
+}
+
+static void i2c_async_write(struct i2c_async *ia, struct i2c_async_xfer *xfer,
+			    uint32_t sr1)
+{
+	uint32_t i2c = ia->i2c;
+
+	if ((sr1 & I2C_SR1_TxE) && ia->pos < xfer->wn) {
+		I2C_DR(i2c) = xfer->w[ia->pos++];
+		if (ia->pos == xfer->wn) {
+			/* Wait for BTF of the last byte. */
+			I2C_CR2(i2c) &= ~I2C_CR2_ITBUFEN;
+		}
+		return;
+	}
+
+	if (!(sr1 & I2C_SR1_BTF)) {
+		return;
+	}
+
+	if (xfer->rn) {
+		ia->phase = I2C_ASYNC_PHASE_READ;
+		ia->pos = 0;
+		if (xfer->rn > 1) {
+			I2C_CR1(i2c) |= I2C_CR1_ACK;
+		}
+		I2C_CR1(i2c) |= I2C_CR1_START;
+	} else {
+		I2C_CR1(i2c) |= I2C_CR1_STOP;
+		i2c_async_done(ia, I2C_ASYNC_OK);
+	}
+}
+
+static void i2c_async_read(struct i2c_async *ia, struct i2c_async_xfer *xfer,
+			   uint32_t sr1)
+{
+	uint32_t i2c = ia->i2c;
+	uint16_t left = xfer->rn - ia->pos;
+
+	if (sr1 & I2C_SR1_BTF) {
+		if (left == 3) {
+			/* Byte N-2 in DR, N-1 in the shift register. */
+			I2C_CR1(i2c) &= ~I2C_CR1_ACK;
+			xfer->r[ia->pos++] = I2C_DR(i2c);
+			return;
+		}
+		if (left == 2) {
+			I2C_CR1(i2c) |= I2C_CR1_STOP;
+			xfer->r[ia->pos++] = I2C_DR(i2c);
+			xfer->r[ia->pos++] = I2C_DR(i2c);
+			I2C_CR1(i2c) &= ~I2C_CR1_POS;
+			i2c_async_done(ia, I2C_ASYNC_OK);
+			return;
+		}
+	}
+
+	if ((sr1 & I2C_SR1_RxNE) && (I2C_CR2(i2c) & I2C_CR2_ITBUFEN)) {
+		xfer->r[ia->pos++] = I2C_DR(i2c);
+		left--;
+		if (left == 0) {
+			I2C_CR2(i2c) &= ~I2C_CR2_ITBUFEN;
+			i2c_async_done(ia, I2C_ASYNC_OK);
+		} else if (left == 3) {
+			/* The last three bytes are handled on BTF. */
+			I2C_CR2(i2c) &= ~I2C_CR2_ITBUFEN;
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief I2C Async Interrupt Handler
+
+Must be called from both the event and the error interrupt of the I2C.
+
+@param[in] ia Engine
+*/
+
+void i2c_async_irq(struct i2c_async *ia)
+{
+	uint32_t sr1 = I2C_SR1(ia->i2c);
+	struct i2c_async_xfer *xfer = ia->head;
+
+	if (!ia->busy) {
+		I2C_SR1(ia->i2c) = ~(sr1 & I2C_ASYNC_ERRORS);
+		return;
+	}
+
+	if (sr1 & I2C_ASYNC_ERRORS) {
+		i2c_async_error(ia, sr1 & I2C_ASYNC_ERRORS);
+		return;
+	}
+
+	if (sr1 & I2C_SR1_SB) {
+		I2C_DR(ia->i2c) = (xfer->addr << 1) |
+				  (ia->phase == I2C_ASYNC_PHASE_READ);
+		return;
+	}
+
+	if (sr1 & I2C_SR1_ADDR) {
+		i2c_async_addr(ia, xfer);
+		return;
+	}
+
+	if (ia->phase == I2C_ASYNC_PHASE_WRITE) {
+		i2c_async_write(ia, xfer, sr1);
+	} else {
+		i2c_async_read(ia, xfer, sr1);
+	}
+}
+
+/**@}*/
@@ -0,0 +1,267 @@
+/** @addtogroup i2c_async_file I2C asynchronous master
+
+@ingroup STM32F_files
+
+@brief <b>libopencm3 STM32 I2C asynchronous master engine, TIMINGR
+peripheral</b>
+
+@version 1.0.0
+
+The byte counter of the peripheral runs each phase of a transaction, reloaded
+every 255 bytes, and generates the repeated start and the stop condition. If
+a DMA controller is configured the data is moved by two DMA
+streams/channels, otherwise from the TXIS and RXNE interrupts.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <libopencm3/stm32/dma_mgr.h>
+#include "i2c_async_private.h"
+
+#define I2C_ASYNC_ERRORS	(I2C_ISR_BERR | I2C_ISR_ARLO | I2C_ISR_OVR)
+#define I2C_ASYNC_DATA		(I2C_CR1_TXIE | I2C_CR1_RXIE | \
+				 I2C_CR1_TXDMAEN | I2C_CR1_RXDMAEN)
+#define I2C_ASYNC_ICR_ALL	(I2C_ICR_OVRCF | I2C_ICR_ARLOCF | \
+				 I2C_ICR_BERRCF | I2C_ICR_STOPCF | \
+				 I2C_ICR_NACKCF | I2C_ICR_ADDRCF)
+#define I2C_ASYNC_MAX_NBYTES	255
+
+/* Stop moving data for the current phase. */
+static void i2c_async_data_stop(struct i2c_async *ia)
+{
+	I2C_CR1(ia->i2c) &= ~I2C_ASYNC_DATA;
+	if (ia->dma) {
+		dma_xfer_stop(ia->dma, ia->tx_channel);
+		dma_xfer_stop(ia->dma, ia->rx_channel);
+	}
+}
+
+/* Program NBYTES for the next chunk of the current phase. */
+static uint32_t i2c_async_chunk(struct i2c_async *ia,
+				struct i2c_async_xfer *xfer)
+{
+	uint16_t n = ia->remaining;
+	uint32_t cr2;
+
+	if (n > I2C_ASYNC_MAX_NBYTES) {
+		n = I2C_ASYNC_MAX_NBYTES;
+	}
+	ia->remaining -= n;
+
+	cr2 = n << I2C_CR2_NBYTES_SHIFT;
+	if (ia->remaining) {
+		cr2 |= I2C_CR2_RELOAD;
+	} else if (ia->phase == I2C_ASYNC_PHASE_READ || xfer->rn == 0) {
+		/* Last phase: the stop condition follows the last byte. */
+		cr2 |= I2C_CR2_AUTOEND;
+	}
+	return cr2;
+}
+
+/* Start the current phase with a (repeated) start condition. */
+static void i2c_async_phase(struct i2c_async *ia, struct i2c_async_xfer *xfer)
+{
+	bool read = ia->phase == I2C_ASYNC_PHASE_READ;
+	uint16_t n = read ? xfer->rn : xfer->wn;
+	uint32_t cr2;
+
+	ia->pos = 0;
+	ia->remaining = n;
+	cr2 = i2c_async_chunk(ia, xfer);
+	cr2 |= (xfer->addr << I2C_CR2_SADD_7BIT_SHIFT) & I2C_CR2_SADD_7BIT_MASK;
+	if (read) {
+		cr2 |= I2C_CR2_RD_WRN;
+	}
+
+	I2C_CR1(ia->i2c) &= ~I2C_ASYNC_DATA;
+	if (n && ia->dma) {
+		if (read) {
+			dma_xfer_restart(ia->dma, ia->rx_channel,
+					 (uint32_t)xfer->r, n);
+			I2C_CR1(ia->i2c) |= I2C_CR1_RXDMAEN;
+		} else {
+			dma_xfer_restart(ia->dma, ia->tx_channel,
+					 (uint32_t)xfer->w, n);
+			I2C_CR1(ia->i2c) |= I2C_CR1_TXDMAEN;
+		}
+	} else if (n) {
+		I2C_CR1(ia->i2c) |= read ? I2C_CR1_RXIE : I2C_CR1_TXIE;
+	}
+
+	I2C_CR2(ia->i2c) = cr2 | I2C_CR2_START;
+}
+
+/* DMA manager callback: a transfer error ends the transaction at once. */
+static void i2c_async_dma_event(uint32_t dma, uint8_t channel, uint32_t flags,
+				void *arg)
+{
+	struct i2c_async *ia = arg;
+
+	(void)dma;
+	(void)channel;
+	if ((flags & DMA_TEIF) && ia->busy) {
+		i2c_async_hw_abort(ia);
+		i2c_async_done(ia, I2C_ASYNC_BUS_ERROR);
+	}
+}
+
+int i2c_async_hw_init(struct i2c_async *ia)
+{
+	const struct dma_xfer_config rx_cfg = {
+		.dma = ia->dma,
+		.channel = ia->rx_channel,
+		.request = ia->rx_request,
+		.dir = DMA_XFER_PERIPH_TO_MEM,
+		.paddr = (uint32_t)&I2C_RXDR(ia->i2c),
+		.psize = 1,
+		.msize = 1,
+		.minc = true,
+		.priority = DMA_XFER_PRIORITY_HIGH,
+		.irq = DMA_XFER_IRQ_TE,
+	};
+	const struct dma_xfer_config tx_cfg = {
+		.dma = ia->dma,
+		.channel = ia->tx_channel,
+		.request = ia->tx_request,
+		.dir = DMA_XFER_MEM_TO_PERIPH,
+		.paddr = (uint32_t)&I2C_TXDR(ia->i2c),
+		.psize = 1,
+		.msize = 1,
+		.minc = true,
+		.priority = DMA_XFER_PRIORITY_HIGH,
+		.irq = DMA_XFER_IRQ_TE,
+	};
+	struct dma_xfer xfer;
+	int ret;
+
+	if (ia->dma) {
+		ret = dma_mgr_claim(ia->dma, ia->rx_channel, ia);
+		if (ret != DMA_MGR_E_OK) {
+			return ret;
+		}
+		ret = dma_mgr_claim(ia->dma, ia->tx_channel, ia);
+		if (ret != DMA_MGR_E_OK) {
+			dma_mgr_release(ia->dma, ia->rx_channel, ia);
+			return ret;
+		}
+		dma_xfer_prepare(&xfer, &rx_cfg);
+		dma_xfer_commit(&xfer);
+		dma_xfer_prepare(&xfer, &tx_cfg);
+		dma_xfer_commit(&xfer);
+		dma_mgr_set_callback(ia->dma, ia->rx_channel,
+				     i2c_async_dma_event, ia);
+		dma_mgr_set_callback(ia->dma, ia->tx_channel,
+				     i2c_async_dma_event, ia);
+	}
+
+	I2C_ICR(ia->i2c) = I2C_ASYNC_ICR_ALL;
+	I2C_CR1(ia->i2c) &= ~I2C_ASYNC_DATA;
+	I2C_CR1(ia->i2c) |= I2C_CR1_ERRIE | I2C_CR1_TCIE | I2C_CR1_STOPIE |
+			    I2C_CR1_NACKIE;
+	return 0;
+}
+
+void i2c_async_hw_start(struct i2c_async *ia, struct i2c_async_xfer *xfer)
+{
+	ia->status = I2C_ASYNC_OK;
+	ia->phase = (xfer->wn || !xfer->rn) ?
+		    I2C_ASYNC_PHASE_WRITE : I2C_ASYNC_PHASE_READ;
+	i2c_async_phase(ia, xfer);
+}
+
+void i2c_async_hw_abort(struct i2c_async *ia)
+{
+	i2c_async_data_stop(ia);
+
+	/* PE must read back as zero before the peripheral is reset. */
+	I2C_CR1(ia->i2c) &= ~I2C_CR1_PE;
+	while (I2C_CR1(ia->i2c) & I2C_CR1_PE);
+	I2C_CR1(ia->i2c) |= I2C_CR1_PE;
+	I2C_ICR(ia->i2c) = I2C_ASYNC_ICR_ALL;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief I2C Async Interrupt Handler
+
+Must be called from both the event and the error interrupt of the I2C, or
+from the combined interrupt on parts that have only one.
+
+@param[in] ia Engine
+*/
+
+void i2c_async_irq(struct i2c_async *ia)
+{
+	uint32_t i2c = ia->i2c;
+	uint32_t isr = I2C_ISR(i2c);
+	struct i2c_async_xfer *xfer = ia->head;
+
+	if (!ia->busy) {
+		I2C_ICR(i2c) = I2C_ASYNC_ICR_ALL;
+		return;
+	}
+
+	if (isr & I2C_ASYNC_ERRORS) {
+		i2c_async_hw_abort(ia);
+		i2c_async_done(ia, (isr & I2C_ISR_ARLO) ?
+			       I2C_ASYNC_ARB_LOST : I2C_ASYNC_BUS_ERROR);
+		return;
+	}
+
+	if (isr & I2C_ISR_NACKF) {
+		I2C_ICR(i2c) = I2C_ICR_NACKCF;
+		ia->status = I2C_ASYNC_NACK;
+		i2c_async_data_stop(ia);
+		if (!(I2C_CR2(i2c) & I2C_CR2_AUTOEND)) {
+			I2C_CR2(i2c) |= I2C_CR2_STOP;
+		}
+		/* Flush a byte that was written ahead. */
+		I2C_ISR(i2c) = I2C_ISR_TXE;
+		return;
+	}
+
+	if (isr & I2C_ISR_STOPF) {
+		I2C_ICR(i2c) = I2C_ICR_STOPCF;
+		i2c_async_data_stop(ia);
+		i2c_async_done(ia, ia->status);
+		return;
+	}
+
+	if ((isr & I2C_ISR_TXIS) && (I2C_CR1(i2c) & I2C_CR1_TXIE)) {
+		I2C_TXDR(i2c) = xfer->w[ia->pos++];
+	}
+	if ((isr & I2C_ISR_RXNE) && (I2C_CR1(i2c) & I2C_CR1_RXIE)) {
+		xfer->r[ia->pos++] = I2C_RXDR(i2c);
+	}
+
+	if (isr & I2C_ISR_TCR) {
+		/* Writing NBYTES clears TCR. */
+		I2C_CR2(i2c) = (I2C_CR2(i2c) & ~(I2C_CR2_NBYTES_MASK |
+						 I2C_CR2_RELOAD |
+						 I2C_CR2_AUTOEND)) |
+			       i2c_async_chunk(ia, xfer);
+	} else if (isr & I2C_ISR_TC) {
+		/* End of the write phase, continue with the read. */
+		ia->phase = I2C_ASYNC_PHASE_READ;
+		i2c_async_phase(ia, xfer);
+	}
+}
+
+/**@}*/
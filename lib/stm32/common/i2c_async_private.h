@@ -0,0 +1,42 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Interface between the queue handling in i2c_async_common_all.c and the
+ * peripheral specific state machines in i2c_async_common_v1.c and
+ * i2c_async_common_v2.c.
+ *
+ * THIS FILE IS NOT PART OF THE PUBLIC API.
+ */
+
+#ifndef LIBOPENCM3_STM32_I2C_ASYNC_PRIVATE_H
+#define LIBOPENCM3_STM32_I2C_ASYNC_PRIVATE_H
+
+#include <libopencm3/stm32/i2c_async.h>
+
+#define I2C_ASYNC_PHASE_WRITE	0
+#define I2C_ASYNC_PHASE_READ	1
+
+/* Provided by the peripheral specific file. */
+int i2c_async_hw_init(struct i2c_async *ia);
+void i2c_async_hw_start(struct i2c_async *ia, struct i2c_async_xfer *xfer);
+void i2c_async_hw_abort(struct i2c_async *ia);
+
+/* Provided by i2c_async_common_all.c */
+void i2c_async_done(struct i2c_async *ia, int status);
+
+#endif
@@ -21,6 +21,7 @@
 
 #include <libopencm3/stm32/i2c.h>
 #include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/syscfg.h>
 
 /**@{*/
 
@@ -409,42 +410,272 @@ void i2c_transfer7(uint32_t i2c, uint8_t addr, const uint8_t *w, size_t wn, uint
 }
 
 
+/* Bus timing limits of the I2C specification, in ns. */
+struct i2c_timing_spec {
+	uint32_t max_speed;
+	uint16_t low_min;
+	uint16_t high_min;
+	uint16_t setup_min;
+	uint16_t valid_max;
+};
+
+static const struct i2c_timing_spec i2c_timing_specs[] = {
+	{ 100000, 4700, 4000, 250, 3450 },
+	{ 400000, 1300, 600, 100, 900 },
+	{ 1000000, 500, 260, 50, 450 },
+};
+
+/* Input delay of the analog filter, in ns. */
+#define I2C_ANALOG_FILTER_MIN	50
+#define I2C_ANALOG_FILTER_MAX	260
+
+static uint32_t i2c_div_ceil(int32_t a, uint32_t b)
+{
+	return (a <= 0) ? 0 : ((uint32_t)a + b - 1) / b;
+}
+
+/**
+ * Compute the TIMINGR value for a master clock.
+ *
+ * All prescalers are searched for the SCL low and high periods that give the
+ * frequency closest to, but not above, the requested one while meeting the
+ * low/high period, data hold and data setup limits of the speed mode. The
+ * synchronisation delays of the peripheral and the filter delays are taken
+ * into account as described in the reference manual.
+ *
+ * All times are calculated in ps, the kernel clock must be at least 1 MHz.
+ *
+ * @param timing bus and filter parameters
+ * @param[out] timingr value for I2C_TIMINGR
+ * @returns false if the clock is too slow for the requested speed
+ */
+bool i2c_timing_compute(const struct i2c_timing *timing, uint32_t *timingr)
+{
+	const struct i2c_timing_spec *spec = NULL;
+	uint32_t tclk, tpresc, target, best_err = UINT32_MAX;
+	int32_t tr, tf, taf_min, taf_max, tdnf, tsync, del_min, del_max;
+	uint32_t presc, scll, tlow, tscl, low_min, high_min;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(i2c_timing_specs) / sizeof(*spec); i++) {
+		if (timing->speed <= i2c_timing_specs[i].max_speed) {
+			spec = &i2c_timing_specs[i];
+			break;
+		}
+	}
+	if (spec == NULL || timing->speed == 0 || timing->clock < 1000000 ||
+	    timing->digital_filter > 15) {
+		return false;
+	}
+
+	tclk = 1000000000 / (timing->clock / 1000);
+	target = 1000000000 / (timing->speed / 1000);
+	tr = timing->rise_ns * 1000;
+	tf = timing->fall_ns * 1000;
+	taf_min = timing->analog_filter ? I2C_ANALOG_FILTER_MIN * 1000 : 0;
+	taf_max = timing->analog_filter ? I2C_ANALOG_FILTER_MAX * 1000 : 0;
+	tdnf = timing->digital_filter * tclk;
+	tsync = taf_min + tdnf + 2 * tclk;
+
+	/* The kernel clock period must stay below a quarter of the SCL low
+	 * period less the filter delays, and below the SCL high period. Fail
+	 * if even the longest low period that reaches the rate is too short. */
+	if ((int32_t)(4 * tclk) >= (int32_t)(target - spec->high_min * 1000) -
+				   taf_min - tdnf) {
+		return false;
+	}
+	low_min = spec->low_min * 1000;
+	if (low_min <= 4 * tclk + taf_min + tdnf) {
+		low_min = 4 * tclk + taf_min + tdnf + 1;
+	}
+	high_min = spec->high_min * 1000;
+	if (high_min <= tclk) {
+		high_min = tclk + 1;
+	}
+
+	/* Data hold: SDA must not change before SCL has fallen and must be
+	 * valid within tVD;DAT. */
+	del_min = tf - taf_min - tdnf - 3 * (int32_t)tclk;
+	del_max = spec->valid_max * 1000 - taf_max - tdnf - 4 * (int32_t)tclk;
+
+	for (presc = 0; presc < 16 && best_err; presc++) {
+		uint32_t dmin, dmax, cdel, lmin, hmin;
+
+		tpresc = (presc + 1) * tclk;
+
+		dmin = i2c_div_ceil(del_min, tpresc);
+		/* The filter and synchronisation delays alone may exceed
+		 * tVD;DAT on a slow clock, there is no way around that. */
+		dmax = (del_max > 0) ? (uint32_t)del_max / tpresc : 0;
+		cdel = i2c_div_ceil(tr + spec->setup_min * 1000, tpresc);
+		cdel = cdel ? cdel - 1 : 0;
+		if (dmin > 15 || dmin > dmax || cdel > 15) {
+			continue;
+		}
+
+		/* The low and high periods include the SCL edges. */
+		lmin = i2c_div_ceil((int32_t)low_min - tsync - tf, tpresc);
+		hmin = i2c_div_ceil((int32_t)high_min - tsync - tr, tpresc);
+		lmin = lmin ? lmin - 1 : 0;
+		hmin = hmin ? hmin - 1 : 0;
+
+		for (scll = lmin; scll < 256 && best_err; scll++) {
+			uint32_t h;
+
+			/* Shortest high period that reaches the period. */
+			tlow = (scll + 1) * tpresc + tsync;
+			h = i2c_div_ceil((int32_t)(target - tlow) - tsync - tr - tf,
+					 tpresc);
+			h = (h > hmin + 1) ? h - 1 : hmin;
+			if (h > 255) {
+				continue;
+			}
+
+			tscl = tlow + (h + 1) * tpresc + tsync + tr + tf;
+			if (tscl - target < best_err) {
+				best_err = tscl - target;
+				*timingr = (presc << I2C_TIMINGR_PRESC_SHIFT) |
+					   (cdel << I2C_TIMINGR_SCLDEL_SHIFT) |
+					   (dmin << I2C_TIMINGR_SDADEL_SHIFT) |
+					   (h << I2C_TIMINGR_SCLH_SHIFT) |
+					   (scll << I2C_TIMINGR_SCLL_SHIFT);
+			}
+			if (h == hmin) {
+				/* Longer low periods only add to the error. */
+				break;
+			}
+		}
+	}
+
+	return best_err != UINT32_MAX;
+}
+
+/**
+ * Set the timing register, the peripheral must be disabled.
+ * @param i2c peripheral, eg I2C1
+ * @param timingr value computed by i2c_timing_compute()
+ */
+void i2c_set_timing(uint32_t i2c, uint32_t timingr)
+{
+	I2C_TIMINGR(i2c) = timingr;
+}
+
+#if defined(STM32F0) || defined(STM32F3) || defined(STM32G0) || \
+	defined(STM32G4) || defined(STM32L4)
+#define I2C_FMP_REG		SYSCFG_CFGR1
+#define I2C_FMP_I2C1		SYSCFG_CFGR1_I2C1_FMP
+#define I2C_FMP_I2C2		SYSCFG_CFGR1_I2C2_FMP
+#elif defined(STM32F7)
+#define I2C_FMP_REG		SYSCFG_PMC
+#define I2C_FMP_I2C1		SYSCFG_PMC_I2C1_FMP
+#define I2C_FMP_I2C2		SYSCFG_PMC_I2C2_FMP
+#elif defined(STM32L0)
+#define I2C_FMP_REG		SYSCFG_CFGR2
+#define I2C_FMP_I2C1		SYSCFG_CFGR2_I2C1_FMP
+#define I2C_FMP_I2C2		SYSCFG_CFGR2_I2C2_FMP
+#endif
+
+#ifdef I2C_FMP_REG
+static uint32_t i2c_fmp_bit(uint32_t i2c)
+{
+	switch (i2c) {
+	case I2C1:
+		return I2C_FMP_I2C1;
+	case I2C2:
+		return I2C_FMP_I2C2;
+#if defined(STM32L0)
+	case I2C3:
+		return SYSCFG_CFGR2_I2C3_FMP;
+#elif defined(STM32F3) || defined(STM32G4) || defined(STM32L4)
+	case I2C3:
+		return SYSCFG_CFGR1_I2C3_FMP;
+#elif defined(STM32F7)
+	case I2C3:
+		return SYSCFG_PMC_I2C3_FMP;
+	case I2C4:
+		return SYSCFG_PMC_I2C4_FMP;
+#endif
+#if defined(STM32G4)
+	case I2C4:
+		return SYSCFG_CFGR1_I2C4_FMP;
+#endif
+	default:
+		return 0;
+	}
+}
+#endif
+
+/**
+ * Enable the Fast-mode Plus drive of the SCL and SDA pins of a peripheral.
+ *
+ * Required for 1 MHz operation. The SYSCFG clock must be enabled.
+ * @param i2c peripheral, eg I2C1
+ */
+void i2c_enable_fast_mode_plus(uint32_t i2c)
+{
+#ifdef I2C_FMP_REG
+	I2C_FMP_REG |= i2c_fmp_bit(i2c);
+#else
+	(void)i2c;
+#endif
+}
+
+/**
+ * Disable the Fast-mode Plus drive of the SCL and SDA pins of a peripheral.
+ * @param i2c peripheral, eg I2C1
+ */
+void i2c_disable_fast_mode_plus(uint32_t i2c)
+{
+#ifdef I2C_FMP_REG
+	I2C_FMP_REG &= ~i2c_fmp_bit(i2c);
+#else
+	(void)i2c;
+#endif
+}
+
 /**
  * Set the i2c communication speed.
- * NOTE: 1MHz mode not yet implemented!
- * Min clock speed: 8MHz for FM, 2Mhz for SM,
+ *
+ * The timing is computed by i2c_timing_compute() for the filter setup in
+ * CR1, assuming 100 ns rise and 10 ns fall times. For 1 MHz the Fast-mode
+ * Plus drive is enabled as well. Use i2c_timing_compute() and
+ * i2c_set_timing() directly to account for the actual bus load.
+ * Min clock speed: 8MHz for FM+, 4MHz for FM, 2Mhz for SM. TIMINGR is left
+ * unchanged if the clock is too slow.
  * @param i2c peripheral, eg I2C1
  * @param speed one of the listed speed modes @ref i2c_speeds
  * @param clock_megahz i2c peripheral clock speed in MHz. Usually, rcc_apb1_frequency / 1e6
  */
 void i2c_set_speed(uint32_t i2c, enum i2c_speeds speed, uint32_t clock_megahz)
 {
-	int prescaler;
-	switch(speed) {
+	struct i2c_timing timing = {
+		.clock = clock_megahz * 1000000,
+		.speed = 100000,
+		.rise_ns = 100,
+		.fall_ns = 10,
+		.analog_filter = !(I2C_CR1(i2c) & I2C_CR1_ANFOFF),
+		.digital_filter = (I2C_CR1(i2c) >> I2C_CR1_DNF_SHIFT) &
+				  I2C_CR1_DNF_MASK,
+	};
+	uint32_t timingr;
+
+	switch (speed) {
 	case i2c_speed_fmp_1m:
-		/* FIXME - add support for this mode! */
+		timing.speed = 1000000;
+		i2c_enable_fast_mode_plus(i2c);
 		break;
 	case i2c_speed_fm_400k:
-		/* target 8Mhz input, so tpresc = 125ns */
-		prescaler = clock_megahz / 8 - 1;
-		i2c_set_prescaler(i2c, prescaler);
-		i2c_set_scl_low_period(i2c, 10-1); // 1250ns
-		i2c_set_scl_high_period(i2c, 4-1); // 500ns
-		i2c_set_data_hold_time(i2c, 3); // 375ns
-		i2c_set_data_setup_time(i2c, 4-1); // 500ns
+		timing.speed = 400000;
 		break;
 	default:
 		/* fall back to standard mode */
 	case i2c_speed_sm_100k:
-		/* target 4Mhz input, so tpresc = 250ns */
-		prescaler = (clock_megahz / 4) - 1;
-		i2c_set_prescaler(i2c, prescaler);
-		i2c_set_scl_low_period(i2c, 20-1); // 5usecs
-		i2c_set_scl_high_period(i2c, 16-1); // 4usecs
-		i2c_set_data_hold_time(i2c, 2); // 0.5usecs
-		i2c_set_data_setup_time(i2c, 5-1); // 1.25usecs
 		break;
 	}
+
+	if (i2c_timing_compute(&timing, &timingr)) {
+		i2c_set_timing(i2c, timingr);
+	}
 }
 
 /**@}*/
@@ -12,6 +12,13 @@
  * This library supports the LCD controller (LTDC) in the STM32F4xx and
  * STM32F7xx series of ARM Cortex Microcontrollers by ST Microelectronics.
  *
+ * The swap manager rotates each layer through two or three framebuffers.
+ * A presented buffer is written to the shadow address register and applied
+ * by a vertical blanking reload, so the scan never shows half of a frame.
+ * With three buffers drawing continues while a frame waits for the reload,
+ * and a newer frame replaces a waiting one. The line interrupt counts
+ * refreshes for the frame time statistics and can be used for beam racing.
+ *
  * LGPL License Terms @ref lgpl_license
  */
 
@@ -36,6 +43,7 @@
 
 /**@{*/
 
+#include <libopencm3/cm3/cortex.h>
 #include <libopencm3/stm32/common/ltdc_common_f47.h>
 
 void ltdc_set_tft_sync_timings(uint16_t sync_width,    uint16_t sync_height,
@@ -88,5 +96,226 @@ void ltdc_setup_windowing(uint8_t layer_number, uint16_t h_back_porch,
 		(v_back_porch + v_sync) << LTDC_LxWVPCR_WVSTPOS_SHIFT;
 }
 
-/**@}*/
+/* Account for a completed vertical blanking reload. */
+static void ltdc_swap_flip(struct ltdc_swap *ls)
+{
+	bool flipped = false;
+	uint32_t t;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		struct ltdc_swap_layer *l = &ls->layer[i];
+
+		if (l->count && l->queued != LTDC_SWAP_NONE) {
+			l->front = l->queued;
+			l->queued = LTDC_SWAP_NONE;
+			flipped = true;
+		}
+	}
+	if (!flipped) {
+		return;
+	}
+
+	t = ls->refreshes - ls->last_swap;
+	ls->last_swap = ls->refreshes;
+	if (ls->swaps) {
+		ls->frame_time = t;
+		if (t < ls->frame_time_min) {
+			ls->frame_time_min = t;
+		}
+		if (t > ls->frame_time_max) {
+			ls->frame_time_max = t;
+		}
+	}
+	ls->swaps++;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief LTDC Swap Manager Initialise
+
+Show the first framebuffer of each managed layer, program the line interrupt
+and enable the line, reload, FIFO underrun and transfer error interrupts. The
+layers must be configured otherwise.
+
+@param[in] ls Swap manager, the configuration members must be filled in.
+*/
+void ltdc_swap_init(struct ltdc_swap *ls)
+{
+	uint16_t line = ls->line;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		struct ltdc_swap_layer *l = &ls->layer[i];
+
+		l->front = 0;
+		l->queued = LTDC_SWAP_NONE;
+		l->draw = LTDC_SWAP_NONE;
+		if (l->count) {
+			LTDC_LxCFBAR(i + 1) = l->fb[0];
+		}
+	}
+
+	if (line == 0) {
+		line = ((LTDC_AWCR >> LTDC_AWCR_AAH_SHIFT) &
+			LTDC_AWCR_AAH_MASK) + 1;
+	}
 
+	ls->refreshes = 0;
+	ls->last_swap = 0;
+	ls->swaps = 0;
+	ls->frame_time = 0;
+	ls->frame_time_min = 0xffffffff;
+	ls->frame_time_max = 0;
+	ls->dropped = 0;
+	ls->underruns = 0;
+	ls->transfer_errors = 0;
+
+	LTDC_LIPCR = line & LTDC_LIPCR_LIPOS_MASK;
+	LTDC_ICR = LTDC_ICR_CRRIF | LTDC_ICR_CTERRIF | LTDC_ICR_CFUIF |
+		   LTDC_ICR_CLIF;
+	LTDC_IER |= LTDC_IER_RRIE | LTDC_IER_TERRIE | LTDC_IER_FUIE |
+		    LTDC_IER_LIE;
+	LTDC_SRCR = LTDC_SRCR_IMR;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief LTDC Swap Manager Get Back Buffer
+
+Get a framebuffer to draw the next frame into. The same buffer is returned
+until it is presented.
+
+@param[in] ls Swap manager
+@param[in] layer @ref ltdc_layer_num
+@returns Framebuffer address, or 0 if all buffers are shown or waiting to be
+shown. This only happens with double buffering, until the next vertical
+blanking.
+*/
+uint32_t ltdc_swap_back_buffer(struct ltdc_swap *ls, uint8_t layer)
+{
+	struct ltdc_swap_layer *l = &ls->layer[layer - 1];
+	uint8_t i;
+
+	if (l->draw != LTDC_SWAP_NONE) {
+		return l->fb[l->draw];
+	}
+	for (i = 0; i < l->count; i++) {
+		if (i != l->front && i != l->queued) {
+			l->draw = i;
+			return l->fb[i];
+		}
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief LTDC Swap Manager Present
+
+Queue the back buffer to be shown from the next vertical blanking on. A frame
+that is still waiting is replaced and counted as dropped.
+
+@param[in] ls Swap manager
+@param[in] layer @ref ltdc_layer_num
+@returns false if no back buffer has been taken with ltdc_swap_back_buffer().
+*/
+bool ltdc_swap_present(struct ltdc_swap *ls, uint8_t layer)
+{
+	struct ltdc_swap_layer *l = &ls->layer[layer - 1];
+
+	if (l->draw == LTDC_SWAP_NONE) {
+		return false;
+	}
+
+	CM_CRITICAL_CONTEXT();
+
+	/* The reload may have happened with its interrupt still pending:
+	 * flip here and clear it, so the interrupt does not flip again. */
+	if (!(LTDC_SRCR & LTDC_SRCR_VBR)) {
+		ltdc_swap_flip(ls);
+		LTDC_ICR = LTDC_ICR_CRRIF;
+	}
+	if (l->queued != LTDC_SWAP_NONE) {
+		ls->dropped++;
+	}
+	l->queued = l->draw;
+	l->draw = LTDC_SWAP_NONE;
+	LTDC_LxCFBAR(layer) = l->fb[l->queued];
+	LTDC_SRCR = LTDC_SRCR_VBR;
+	return true;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief LTDC Swap Manager Interrupt Handler
+
+Must be called from the LTDC interrupt, and from the LTDC error interrupt.
+
+@param[in] ls Swap manager
+*/
+void ltdc_swap_irq(struct ltdc_swap *ls)
+{
+	uint32_t isr = LTDC_ISR;
+
+	LTDC_ICR = isr;
+	if (isr & LTDC_ISR_LIF) {
+		ls->refreshes++;
+		if (ls->callback) {
+			ls->callback(ls);
+		}
+	}
+	/* A reload requested by ltdc_swap_present() after this one is still
+	 * pending, and its frame is not shown yet. */
+	if ((isr & LTDC_ISR_RRIF) && !(LTDC_SRCR & LTDC_SRCR_VBR)) {
+		ltdc_swap_flip(ls);
+	}
+	if (isr & LTDC_ISR_FUIF) {
+		ls->underruns++;
+	}
+	if (isr & LTDC_ISR_TERRIF) {
+		ls->transfer_errors++;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief LTDC Load CLUT
+
+Write the colour lookup table of a layer and enable it from the next vertical
+blanking on.
+
+@param[in] layer @ref ltdc_layer_num
+@param[in] clut Entries, RGB888
+@param[in] n Number of entries, up to 256
+*/
+void ltdc_set_clut(uint8_t layer, const uint32_t *clut, uint16_t n)
+{
+	uint16_t i;
+
+	for (i = 0; i < n && i < 256; i++) {
+		LTDC_LxCLUTWR(layer) = ((uint32_t)i <<
+					LTDC_LxCLUTWR_CLUTADD_SHIFT) |
+				       (clut[i] & 0xffffff);
+	}
+	LTDC_LxCR(layer) |= LTDC_LxCR_COLTAB_ENABLE;
+	LTDC_SRCR = LTDC_SRCR_VBR;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief LTDC Set Color Keying
+
+Make the pixels of a layer with the key colour transparent, from the next
+vertical blanking on.
+
+@param[in] layer @ref ltdc_layer_num
+@param[in] enable Enable or disable color keying
+@param[in] rgb888 Key colour
+*/
+void ltdc_set_color_keying(uint8_t layer, bool enable, uint32_t rgb888)
+{
+	LTDC_LxCKCR(layer) = rgb888 & 0xffffff;
+	if (enable) {
+		LTDC_LxCR(layer) |= LTDC_LxCR_COLKEY_ENABLE;
+	} else {
+		LTDC_LxCR(layer) &= ~LTDC_LxCR_COLKEY_ENABLE;
+	}
+	LTDC_SRCR = LTDC_SRCR_VBR;
+}
+
+/**@}*/
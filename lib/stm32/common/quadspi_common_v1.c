@@ -9,4 +9,213 @@ void quadspi_enable(void)
 void quadspi_disable(void)
 {
 	QUADSPI_CR &= ~QUADSPI_CR_EN;
-}
\ No newline at end of file
+}
+
+/* Communication configuration register value, without the functional mode. */
+static uint32_t quadspi_ccr(const struct quadspi_command *cmd)
+{
+	uint32_t ccr;
+
+	ccr = ((uint32_t)cmd->instruction << QUADSPI_CCR_INST_SHIFT) |
+	      ((uint32_t)cmd->imode << QUADSPI_CCR_IMODE_SHIFT) |
+	      ((uint32_t)cmd->admode << QUADSPI_CCR_ADMODE_SHIFT) |
+	      ((uint32_t)cmd->abmode << QUADSPI_CCR_ABMODE_SHIFT) |
+	      ((uint32_t)(cmd->dummy & QUADSPI_CCR_DCYC_MASK) <<
+	       QUADSPI_CCR_DCYC_SHIFT) |
+	      ((uint32_t)cmd->dmode << QUADSPI_CCR_DMODE_SHIFT);
+	if (cmd->admode) {
+		ccr |= (uint32_t)((cmd->adsize - 1) & QUADSPI_CCR_ADSIZE_MASK) <<
+		       QUADSPI_CCR_ADSIZE_SHIFT;
+	}
+	if (cmd->abmode) {
+		ccr |= (uint32_t)((cmd->absize - 1) & QUADSPI_CCR_ABSIZE_MASK) <<
+		       QUADSPI_CCR_ABSIZE_SHIFT;
+	}
+	if (cmd->ddr) {
+		ccr |= QUADSPI_CCR_DDRM | QUADSPI_CCR_DHHC;
+	}
+	if (cmd->sioo) {
+		ccr |= QUADSPI_CCR_SIOO;
+	}
+	return ccr;
+}
+
+/*
+ * Program a command. It starts with the write of the last register it needs:
+ * the address, or the configuration register without an address phase.
+ */
+static void quadspi_wait_idle(void)
+{
+	while (QUADSPI_SR & QUADSPI_SR_BUSY);
+}
+
+static void quadspi_issue(const struct quadspi_command *cmd, uint32_t address,
+			  uint32_t len, uint8_t fmode)
+{
+	quadspi_wait_idle();
+
+	QUADSPI_FCR = QUADSPI_FCR_CTOF | QUADSPI_FCR_CSMF | QUADSPI_FCR_CTCF |
+		      QUADSPI_FCR_CTEF;
+	if (cmd->dmode) {
+		QUADSPI_DLR = len - 1;
+	}
+	if (cmd->abmode) {
+		QUADSPI_ABR = cmd->alternate;
+	}
+	QUADSPI_CCR = quadspi_ccr(cmd) |
+		      ((uint32_t)fmode << QUADSPI_CCR_FMODE_SHIFT);
+	if (cmd->admode && fmode != QUADSPI_CCR_FMODE_MEMMAP) {
+		QUADSPI_AR = address;
+	}
+}
+
+void quadspi_setup(uint8_t prescaler, uint8_t size_log2, uint8_t cs_high,
+		   bool sample_shift)
+{
+	uint32_t cr;
+
+	quadspi_disable();
+	QUADSPI_DCR = ((uint32_t)((size_log2 - 1) & QUADSPI_DCR_FSIZE_MASK) <<
+		       QUADSPI_DCR_FSIZE_SHIFT) |
+		      ((uint32_t)((cs_high - 1) & QUADSPI_DCR_CSHT_MASK) <<
+		       QUADSPI_DCR_CSHT_SHIFT);
+	/* The FIFO threshold flag is set on a full word. */
+	cr = ((uint32_t)prescaler << QUADSPI_CR_PRESCALE_SHIFT) |
+	     (3 << QUADSPI_CR_FTHRES_SHIFT);
+	if (sample_shift) {
+		cr |= QUADSPI_CR_SSHIFT;
+	}
+	QUADSPI_CR = cr;
+	quadspi_enable();
+}
+
+void quadspi_abort(void)
+{
+	QUADSPI_CR |= QUADSPI_CR_ABORT;
+	while (QUADSPI_CR & QUADSPI_CR_ABORT);
+}
+
+int quadspi_wait(void)
+{
+	uint32_t sr;
+
+	do {
+		sr = QUADSPI_SR;
+	} while (!(sr & (QUADSPI_SR_TCF | QUADSPI_SR_TEF)));
+	QUADSPI_FCR = QUADSPI_FCR_CTCF | QUADSPI_FCR_CTEF;
+#if !defined(STM32H7)
+	QUADSPI_CR &= ~QUADSPI_CR_DMAEN;
+#endif
+	return (sr & QUADSPI_SR_TEF) ? -1 : 0;
+}
+
+int quadspi_command(const struct quadspi_command *cmd, uint32_t address)
+{
+	quadspi_issue(cmd, address, 0, QUADSPI_CCR_FMODE_IWRITE);
+	return quadspi_wait();
+}
+
+int quadspi_read(const struct quadspi_command *cmd, uint32_t address,
+		 void *buf, uint32_t len)
+{
+	uint8_t *p = buf;
+
+	quadspi_issue(cmd, address, len, QUADSPI_CCR_FMODE_IREAD);
+	while (len) {
+		uint32_t sr = QUADSPI_SR;
+
+		if (sr & QUADSPI_SR_TEF) {
+			break;
+		}
+		if (len >= 4 && (sr & QUADSPI_SR_FTF) && !((uint32_t)p & 3)) {
+			*(uint32_t *)p = QUADSPI_DR;
+			p += 4;
+			len -= 4;
+		} else if ((sr >> QUADSPI_SR_FLEVEL_SHIFT) &
+			   QUADSPI_SR_FLEVEL_MASK) {
+			*p++ = QUADSPI_BYTE_DR;
+			len--;
+		}
+	}
+	return quadspi_wait();
+}
+
+int quadspi_write(const struct quadspi_command *cmd, uint32_t address,
+		  const void *buf, uint32_t len)
+{
+	const uint8_t *p = buf;
+
+	quadspi_issue(cmd, address, len, QUADSPI_CCR_FMODE_IWRITE);
+	while (len) {
+		uint32_t sr = QUADSPI_SR;
+
+		if (sr & QUADSPI_SR_TEF) {
+			break;
+		}
+		if (len >= 4 && (sr & QUADSPI_SR_FTF) && !((uint32_t)p & 3)) {
+			QUADSPI_DR = *(const uint32_t *)p;
+			p += 4;
+			len -= 4;
+		} else if (((sr >> QUADSPI_SR_FLEVEL_SHIFT) &
+			    QUADSPI_SR_FLEVEL_MASK) < 32) {
+			QUADSPI_BYTE_DR = *p++;
+			len--;
+		}
+	}
+	return quadspi_wait();
+}
+
+#if !defined(STM32H7)
+void quadspi_start_dma(const struct quadspi_command *cmd, uint32_t address,
+		       uint32_t len, bool write)
+{
+	quadspi_issue(cmd, address, len, write ? QUADSPI_CCR_FMODE_IWRITE :
+		      QUADSPI_CCR_FMODE_IREAD);
+	QUADSPI_CR |= QUADSPI_CR_DMAEN;
+}
+#endif
+
+int quadspi_poll(const struct quadspi_command *cmd, uint32_t mask,
+		 uint32_t match, uint16_t interval, uint32_t max_loops)
+{
+	uint32_t len = 1;
+	uint32_t sr;
+
+	while (len < 4 && (mask >> (8 * len))) {
+		len++;
+	}
+
+	/* The polling registers may not be written while a command runs. */
+	quadspi_wait_idle();
+	QUADSPI_PSMKR = mask;
+	QUADSPI_PSMAR = match;
+	QUADSPI_PIR = interval;
+	QUADSPI_CR = (QUADSPI_CR & ~QUADSPI_CR_PMM) | QUADSPI_CR_APMS;
+	quadspi_issue(cmd, 0, len, QUADSPI_CCR_FMODE_APOLL);
+
+	do {
+		sr = QUADSPI_SR;
+		if (sr & (QUADSPI_SR_SMF | QUADSPI_SR_TEF)) {
+			break;
+		}
+	} while (!max_loops || --max_loops);
+
+	if (!(sr & (QUADSPI_SR_SMF | QUADSPI_SR_TEF))) {
+		quadspi_abort();
+		return -1;
+	}
+	QUADSPI_FCR = QUADSPI_FCR_CSMF | QUADSPI_FCR_CTCF | QUADSPI_FCR_CTEF;
+	return (sr & QUADSPI_SR_TEF) ? -1 : 0;
+}
+
+void quadspi_memory_mapped(const struct quadspi_command *cmd,
+			   uint16_t timeout)
+{
+	if (timeout) {
+		QUADSPI_LPTR = timeout;
+		QUADSPI_CR |= QUADSPI_CR_TCEN;
+	} else {
+		QUADSPI_CR &= ~QUADSPI_CR_TCEN;
+	}
+	quadspi_issue(cmd, 0, 0, QUADSPI_CCR_FMODE_MEMMAP);
+}
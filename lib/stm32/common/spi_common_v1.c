@@ -124,4 +124,42 @@ void spi_set_dff_16bit(uint32_t spi)
 	SPI_CR1(spi) |= SPI_CR1_DFF;
 }
 
+/*---------------------------------------------------------------------------*/
+/** @brief SPI Transfer a Buffer
+
+Full duplex transfer of a buffer of 8 bit frames in master mode. The next
+frame is written to the data register while the previous one is shifting out,
+so the clock runs without gaps between frames. An interrupt that delays the
+loop by more than one frame time causes a receive overrun.
+
+@param[in] spi Unsigned int32. SPI peripheral identifier @ref spi_reg_base.
+@param[in] tx Data to send, or NULL to send 0xff.
+@param[out] rx Buffer for received data, or NULL to discard it.
+@param[in] len Number of bytes to transfer.
+*/
+
+void spi_transfer(uint32_t spi, const uint8_t *tx, uint8_t *rx,
+		  uint16_t len)
+{
+	uint16_t i;
+	uint8_t data;
+
+	if (len == 0) {
+		return;
+	}
+
+	SPI_DR(spi) = tx ? tx[0] : 0xff;
+	for (i = 0; i < len; i++) {
+		if (i + 1 < len) {
+			while (!(SPI_SR(spi) & SPI_SR_TXE));
+			SPI_DR(spi) = tx ? tx[i + 1] : 0xff;
+		}
+		while (!(SPI_SR(spi) & SPI_SR_RXNE));
+		data = SPI_DR(spi);
+		if (rx) {
+			rx[i] = data;
+		}
+	}
+}
+
 /**@}*/
@@ -166,4 +166,55 @@ void spi_fifo_reception_threshold_16bit(uint32_t spi)
 	SPI_CR2(spi) &= ~SPI_CR2_FRXTH;
 }
 
+/*---------------------------------------------------------------------------*/
+/** @brief SPI Transfer a Buffer
+
+Full duplex transfer of a buffer of 8 bit frames in master mode. Pairs of
+frames are packed into one 16 bit access of the data register with the
+reception threshold set to 16 bits, which halves the number of register
+accesses. The first byte of each pair goes out first. The reception threshold
+is restored on return.
+
+@param[in] spi Unsigned int32. SPI peripheral identifier @ref spi_reg_base.
+@param[in] tx Data to send, or NULL to send 0xff.
+@param[out] rx Buffer for received data, or NULL to discard it.
+@param[in] len Number of bytes to transfer.
+*/
+
+void spi_transfer(uint32_t spi, const uint8_t *tx, uint8_t *rx,
+		  uint16_t len)
+{
+	uint32_t frxth = SPI_CR2(spi) & SPI_CR2_FRXTH;
+	uint16_t i;
+	uint16_t data;
+
+	SPI_CR2(spi) &= ~SPI_CR2_FRXTH;
+	for (i = 0; i + 1 < len; i += 2) {
+		data = tx ? (tx[i] | (tx[i + 1] << 8)) : 0xffff;
+		while (!(SPI_SR(spi) & SPI_SR_TXE));
+		SPI_DR16(spi) = data;
+		while (!(SPI_SR(spi) & SPI_SR_RXNE));
+		data = SPI_DR16(spi);
+		if (rx) {
+			rx[i] = data;
+			rx[i + 1] = data >> 8;
+		}
+	}
+
+	SPI_CR2(spi) |= SPI_CR2_FRXTH;
+	if (i < len) {
+		while (!(SPI_SR(spi) & SPI_SR_TXE));
+		SPI_DR8(spi) = tx ? tx[i] : 0xff;
+		while (!(SPI_SR(spi) & SPI_SR_RXNE));
+		data = SPI_DR8(spi);
+		if (rx) {
+			rx[i] = data;
+		}
+	}
+
+	if (!frxth) {
+		SPI_CR2(spi) &= ~SPI_CR2_FRXTH;
+	}
+}
+
 /**@}*/
@@ -0,0 +1,262 @@
+/** @defgroup dma_copy_file DMA memory copy and fill
+
+@ingroup STM32F_files
+
+@brief <b>libopencm3 STM32 DMA memory copy and fill service</b>
+
+@version 1.0.0
+
+dma_memcpy_async() and dma_memset_async() run a memory to memory transfer in
+the background and call a completion callback from the DMA interrupt.
+
+Each request is split into transfers of the widest data size the alignment
+of the addresses allows, and into at most 65520 items per transfer, the
+counter being 16 bits wide. On F2/F4/F7, word transfers between 16 byte
+aligned addresses use 4 beat bursts through the FIFO, which never cross a
+1 KiB boundary at that alignment.
+
+Requests shorter than dma_copy::threshold are done by the CPU before the call
+returns.
+
+The stream/channel interrupt must be enabled in the NVIC and call
+dma_mgr_irq(). On parts with a data cache, the source must be cleaned and
+the destination invalidated by the application.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/stm32/dma_copy.h>
+
+/* Largest counter value that is a multiple of every burst length. */
+#define DMA_COPY_MAX_ITEMS	65520
+
+static void dma_copy_next(struct dma_copy *dc)
+{
+	struct dma_xfer_config cfg = {
+		.dma = dc->dma,
+		.channel = dc->channel,
+		.dir = DMA_XFER_MEM_TO_MEM,
+		.minc = true,
+		.pinc = !dc->fill,
+		.priority = dc->priority,
+		.irq = DMA_XFER_IRQ_TC | DMA_XFER_IRQ_TE,
+	};
+	struct dma_xfer xfer;
+	uint32_t src = dc->fill ? (uint32_t)&dc->pattern : (uint32_t)dc->src;
+	uint32_t addr = (uint32_t)dc->dst | (dc->fill ? 0 : src);
+	uint32_t width = 4;
+	uint32_t items;
+
+	while (width > 1 && ((addr & (width - 1)) || dc->remaining < width)) {
+		width >>= 1;
+	}
+	items = dc->remaining / width;
+	if (items > DMA_COPY_MAX_ITEMS) {
+		items = DMA_COPY_MAX_ITEMS;
+	}
+	if (width == 4 && !(addr & 15) && items >= 4) {
+		cfg.burst = 4;
+		items &= ~3;
+	}
+
+	cfg.paddr = src;
+	cfg.maddr = (uint32_t)dc->dst;
+	cfg.count = items;
+	cfg.psize = width;
+	cfg.msize = width;
+
+	dc->dst += items * width;
+	if (!dc->fill) {
+		dc->src += items * width;
+	}
+	dc->remaining -= items * width;
+
+	dma_xfer_prepare(&xfer, &cfg);
+	dma_xfer_start(&xfer);
+}
+
+static void dma_copy_done(struct dma_copy *dc, int status)
+{
+	dc->busy = false;
+	if (dc->callback) {
+		dc->callback(dc, status, dc->arg);
+	}
+}
+
+static void dma_copy_irq(uint32_t dma, uint8_t channel, uint32_t flags,
+			 void *arg)
+{
+	struct dma_copy *dc = arg;
+
+	if (flags & DMA_TEIF) {
+		dc->dma_errors++;
+		dma_xfer_stop(dma, channel);
+		dma_copy_done(dc, -1);
+	} else if (flags & DMA_TCIF) {
+		if (dc->remaining) {
+			dma_copy_next(dc);
+		} else {
+			dma_copy_done(dc, 0);
+		}
+	}
+}
+
+static void dma_copy_cpu(struct dma_copy *dc)
+{
+	uint8_t *dst = dc->dst;
+	const uint8_t *src = dc->src;
+	uint32_t n = dc->remaining;
+
+	if (!(((uint32_t)dst | (dc->fill ? 0 : (uint32_t)src)) & 3)) {
+		for (; n >= 4; n -= 4, dst += 4) {
+			*(uint32_t *)dst = dc->fill ? dc->pattern :
+				*(const uint32_t *)src;
+			if (!dc->fill) {
+				src += 4;
+			}
+		}
+	}
+	for (; n; n--) {
+		*dst++ = dc->fill ? (uint8_t)dc->pattern : *src++;
+	}
+	dc->remaining = 0;
+}
+
+/* Take the engine for a request, returns false if it is busy. */
+static bool dma_copy_claim(struct dma_copy *dc)
+{
+	CM_CRITICAL_CONTEXT();
+
+	if (dc->busy) {
+		return false;
+	}
+	dc->busy = true;
+	return true;
+}
+
+static int dma_copy_submit(struct dma_copy *dc, uint32_t n,
+			   dma_copy_callback callback, void *arg)
+{
+	dc->remaining = n;
+	dc->callback = callback;
+	dc->arg = arg;
+
+	if (n < dc->threshold || n == 0) {
+		dma_copy_cpu(dc);
+		dma_copy_done(dc, 0);
+	} else {
+		dma_copy_next(dc);
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Copy Initialize
+
+Claim the stream/channel from the @ref dma_mgr_defines "DMA manager" and
+register the completion handling.
+
+@param[in] dc Copy engine, the configuration members must be filled in.
+@returns DMA_MGR_E_OK, or the error of dma_mgr_claim().
+*/
+
+int dma_copy_init(struct dma_copy *dc)
+{
+	int ret = dma_mgr_claim(dc->dma, dc->channel, dc);
+
+	if (ret != DMA_MGR_E_OK) {
+		return ret;
+	}
+	dc->busy = false;
+	dc->dma_errors = 0;
+	dma_mgr_set_callback(dc->dma, dc->channel, dma_copy_irq, dc);
+	return DMA_MGR_E_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Copy Memory
+
+Start copying @p n bytes from @p src to @p dst. The areas must not overlap
+and must stay valid until the callback has run.
+
+@param[in] dc Copy engine
+@param[in] dst Destination
+@param[in] src Source
+@param[in] n Number of bytes
+@param[in] callback Completion callback, or NULL
+@param[in] arg Argument of the callback
+@returns 0, or -1 if the engine is busy with another request.
+*/
+
+int dma_memcpy_async(struct dma_copy *dc, void *dst, const void *src,
+		     uint32_t n, dma_copy_callback callback, void *arg)
+{
+	if (!dma_copy_claim(dc)) {
+		return -1;
+	}
+	dc->fill = false;
+	dc->dst = dst;
+	dc->src = src;
+	return dma_copy_submit(dc, n, callback, arg);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Fill Memory
+
+Start setting @p n bytes at @p dst to @p c.
+
+@param[in] dc Copy engine
+@param[in] dst Destination
+@param[in] c Fill value
+@param[in] n Number of bytes
+@param[in] callback Completion callback, or NULL
+@param[in] arg Argument of the callback
+@returns 0, or -1 if the engine is busy with another request.
+*/
+
+int dma_memset_async(struct dma_copy *dc, void *dst, uint8_t c, uint32_t n,
+		     dma_copy_callback callback, void *arg)
+{
+	if (!dma_copy_claim(dc)) {
+		return -1;
+	}
+	dc->fill = true;
+	dc->dst = dst;
+	dc->src = NULL;
+	dc->pattern = c * 0x01010101U;
+	return dma_copy_submit(dc, n, callback, arg);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Copy Busy
+
+@param[in] dc Copy engine
+@returns true while a request is in progress.
+*/
+
+bool dma_copy_busy(const struct dma_copy *dc)
+{
+	return dc->busy;
+}
+
+/**@}*/
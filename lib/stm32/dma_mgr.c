@@ -0,0 +1,233 @@
+/** @defgroup dma_mgr_file DMA resource manager
+
+@ingroup STM32F_files
+
+@brief <b>libopencm3 STM32 DMA resource manager</b>
+
+@version 1.0.0
+
+Keeps track of the owner of every DMA stream or channel and dispatches its
+interrupt events to a registered callback.
+
+Drivers either claim the stream/channel their request is wired to with
+dma_mgr_claim(), or, on parts where any channel can serve any request through
+the DMAMUX, take the first free one with dma_mgr_alloc() and route the request
+with the @ref dma_xfer_defines calls. The same allocation serves memory to
+memory transfers on all families.
+
+The stream/channel interrupt handlers stay in the application: each one that
+is enabled in the NVIC must call dma_mgr_irq(), e.g.
+
+@code
+void dma1_stream5_isr(void)
+{
+	dma_mgr_irq(DMA1, DMA_STREAM5);
+}
+@endcode
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/stm32/dma_mgr.h>
+
+#define DMA_MGR_SLOTS	8
+
+struct dma_mgr_slot {
+	const void *owner;
+	dma_mgr_callback callback;
+	void *arg;
+};
+
+static struct dma_mgr_slot dma_mgr_slots[2][DMA_MGR_SLOTS];
+
+static uint8_t dma_mgr_channels(uint32_t dma)
+{
+	return (dma == DMA1) ? DMA_XFER_DMA1_CHANNELS : DMA_XFER_DMA2_CHANNELS;
+}
+
+static struct dma_mgr_slot *dma_mgr_slot(uint32_t dma, uint8_t channel)
+{
+	/* Wraps around for channel 0 of the channel controller. */
+	uint8_t n = channel - DMA_MGR_FIRST;
+
+	if (n >= dma_mgr_channels(dma) || n >= DMA_MGR_SLOTS) {
+		return NULL;
+	}
+	return &dma_mgr_slots[(dma == DMA1) ? 0 : 1][n];
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Manager Claim
+
+Take ownership of a given stream/channel.
+
+@param[in] dma DMA controller base address
+@param[in] channel Stream or channel number
+@param[in] owner Owner, any unique non NULL pointer, usually the driver state
+@returns DMA_MGR_E_OK, or DMA_MGR_E_BUSY if it is owned by someone else, or
+DMA_MGR_E_NONE if it does not exist.
+*/
+
+int dma_mgr_claim(uint32_t dma, uint8_t channel, const void *owner)
+{
+	struct dma_mgr_slot *slot = dma_mgr_slot(dma, channel);
+
+	if (!slot) {
+		return DMA_MGR_E_NONE;
+	}
+
+	CM_CRITICAL_CONTEXT();
+
+	if (slot->owner && slot->owner != owner) {
+		return DMA_MGR_E_BUSY;
+	}
+	slot->owner = owner;
+	return DMA_MGR_E_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Manager Allocate
+
+Take ownership of the free stream/channel with the highest number, leaving the
+low numbered ones, which have the higher fixed arbitration priority, for
+requests wired to them.
+
+@param[in] dma DMA controller base address
+@param[in] owner Owner, any unique non NULL pointer
+@returns Stream or channel number, or DMA_MGR_E_NONE if all are in use.
+*/
+
+int dma_mgr_alloc(uint32_t dma, const void *owner)
+{
+	int n = dma_mgr_channels(dma);
+
+	if (n > DMA_MGR_SLOTS) {
+		n = DMA_MGR_SLOTS;
+	}
+
+	CM_CRITICAL_CONTEXT();
+
+	while (n-- > 0) {
+		struct dma_mgr_slot *slot =
+			&dma_mgr_slots[(dma == DMA1) ? 0 : 1][n];
+
+		if (!slot->owner) {
+			slot->owner = owner;
+			slot->callback = NULL;
+			return n + DMA_MGR_FIRST;
+		}
+	}
+	return DMA_MGR_E_NONE;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Manager Release
+
+Stop the stream/channel and give it up. Does nothing unless it is owned by
+@p owner.
+
+@param[in] dma DMA controller base address
+@param[in] channel Stream or channel number
+@param[in] owner Owner given to dma_mgr_claim() or dma_mgr_alloc()
+*/
+
+void dma_mgr_release(uint32_t dma, uint8_t channel, const void *owner)
+{
+	struct dma_mgr_slot *slot = dma_mgr_slot(dma, channel);
+
+	if (!slot) {
+		return;
+	}
+
+	CM_CRITICAL_CONTEXT();
+
+	if (slot->owner == owner) {
+		dma_xfer_stop(dma, channel);
+		slot->callback = NULL;
+		slot->owner = NULL;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Manager Get Owner
+
+@param[in] dma DMA controller base address
+@param[in] channel Stream or channel number
+@returns Owner, or NULL if the stream/channel is free or does not exist.
+*/
+
+const void *dma_mgr_owner(uint32_t dma, uint8_t channel)
+{
+	struct dma_mgr_slot *slot = dma_mgr_slot(dma, channel);
+
+	return slot ? slot->owner : NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Manager Set Callback
+
+Register the event callback of an owned stream/channel. The events passed are
+those enabled in its configuration, see @ref dma_xfer_irq.
+
+@param[in] dma DMA controller base address
+@param[in] channel Stream or channel number
+@param[in] callback Callback, or NULL to only acknowledge the events
+@param[in] arg Argument of the callback
+*/
+
+void dma_mgr_set_callback(uint32_t dma, uint8_t channel,
+			  dma_mgr_callback callback, void *arg)
+{
+	struct dma_mgr_slot *slot = dma_mgr_slot(dma, channel);
+
+	if (!slot) {
+		return;
+	}
+
+	CM_CRITICAL_CONTEXT();
+
+	slot->callback = callback;
+	slot->arg = arg;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief DMA Manager Interrupt Handler
+
+Read and acknowledge the events of a stream/channel and pass them to its
+callback. To be called from the stream/channel interrupt handler.
+
+@param[in] dma DMA controller base address
+@param[in] channel Stream or channel number
+*/
+
+void dma_mgr_irq(uint32_t dma, uint8_t channel)
+{
+	struct dma_mgr_slot *slot = dma_mgr_slot(dma, channel);
+	uint32_t flags = dma_xfer_get_flags(dma, channel);
+
+	if (flags && slot && slot->callback) {
+		slot->callback(dma, channel, flags, slot->arg);
+	}
+}
+
+/**@}*/
@@ -47,7 +47,9 @@
 
 /**@{*/
 
+#include <libopencm3/stm32/desig.h>
 #include <libopencm3/stm32/flash.h>
+#include <libopencm3/stm32/syscfg.h>
 
 void flash_wait_for_last_operation(void)
 {
@@ -79,5 +81,107 @@ void flash_clear_status_flags(void)
 	flash_clear_eop_flag();
 }
 
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash is Dual Bank
+
+2 MiB parts are always dual bank, 1 MiB F42x/F43x parts when the DB1M option
+is set.
+
+@returns true when the flash is split into two banks.
+*/
+
+bool flash_is_dual_bank(void)
+{
+	uint16_t kib = desig_get_flash_size();
+
+	return kib == 2048 || (kib == 1024 && (FLASH_OPTCR & FLASH_OPTCR_DB1M));
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Get the Size of a Flash Bank
+
+@returns Size of a bank in bytes, or of the whole flash on single bank parts.
+Bank 2 starts at FLASH_BASE plus this size.
+*/
+
+uint32_t flash_bank_size(void)
+{
+	uint32_t size = (uint32_t)desig_get_flash_size() * 1024;
+
+	return flash_is_dual_bank() ? size / 2 : size;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Get the Active Flash Bank
+
+The SYSCFG clock must be enabled.
+
+@returns Physical bank mapped at FLASH_BASE, 1 or 2. The other bank is
+mapped at FLASH_BASE + flash_bank_size(), and can be programmed without
+stalling code running from the active one.
+*/
+
+uint8_t flash_bank_active(void)
+{
+	return (SYSCFG_MEMRM & SYSCFG_MEMRM_UFB_MODE) ? 2 : 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Erase a Flash Bank
+
+@param[in] bank Physical bank, 1 or 2
+@param[in] program_size Programming word width, one of:
+@ref flash_cr_program_width
+*/
+
+void flash_erase_bank(uint8_t bank, uint32_t program_size)
+{
+	uint32_t mer = (bank == 2) ? FLASH_CR_MER1 : FLASH_CR_MER;
+
+	flash_wait_for_last_operation();
+	FLASH_CR = (FLASH_CR &
+		    ~(FLASH_CR_PROGRAM_MASK << FLASH_CR_PROGRAM_SHIFT)) |
+		   (program_size << FLASH_CR_PROGRAM_SHIFT);
+
+	FLASH_CR |= mer;
+	FLASH_CR |= FLASH_CR_STRT;
+
+	flash_wait_for_last_operation();
+	FLASH_CR &= ~mer;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Get the Boot Bank Option
+
+@returns true when the BFB2 option selects booting from bank 2.
+*/
+
+bool flash_bank_swap_get(void)
+{
+	return FLASH_OPTCR & FLASH_OPTCR_BFB2;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Set the Boot Bank Option
+
+Program the BFB2 option. It takes effect at the next reset, when the bank
+selected by it is mapped at FLASH_BASE.
+
+@param[in] swap Boot from bank 2
+*/
+
+void flash_bank_swap_set(bool swap)
+{
+	uint32_t optcr = FLASH_OPTCR & ~(FLASH_OPTCR_BFB2 |
+					 FLASH_OPTCR_OPTSTRT |
+					 FLASH_OPTCR_OPTLOCK);
+
+	if (swap) {
+		optcr |= FLASH_OPTCR_BFB2;
+	}
+	flash_program_option_bytes(optcr);
+}
+
 /**@}*/
 
@@ -792,8 +792,9 @@ void rcc_clock_setup_pll(const struct rcc_clock_scale *clock)
 	rcc_osc_on(RCC_HSI);
 	rcc_wait_for_osc_ready(RCC_HSI);
 
-	/* Select HSI as SYSCLK source. */
+	/* Select HSI as SYSCLK source, the PLL cannot be stopped before. */
 	rcc_set_sysclk_source(RCC_CFGR_SW_HSI);
+	rcc_wait_for_sysclk_status(RCC_HSI);
 
 	/* Enable external high-speed oscillator (HSE). */
 	if (clock->pll_source == RCC_CFGR_PLLSRC_HSE_CLK) {
@@ -801,10 +802,6 @@ void rcc_clock_setup_pll(const struct rcc_clock_scale *clock)
 		rcc_wait_for_osc_ready(RCC_HSE);
 	}
 
-	/* Set the VOS scale mode */
-	rcc_periph_clock_enable(RCC_PWR);
-	pwr_set_vos_scale(clock->voltage_scale);
-
 	/*
 	 * Set prescalers for AHB, ADC, APB1, APB2.
 	 * Do this before touching the PLL (TODO: why?).
@@ -816,6 +813,13 @@ void rcc_clock_setup_pll(const struct rcc_clock_scale *clock)
 	/* Disable PLL oscillator before changing its configuration. */
 	rcc_osc_off(RCC_PLL);
 
+	/*
+	 * Set the VOS scale mode. Some parts only accept a change while the
+	 * PLL is off, which also allows switching at runtime.
+	 */
+	rcc_periph_clock_enable(RCC_PWR);
+	pwr_set_vos_scale(clock->voltage_scale);
+
 	/* Configure the PLL oscillator. */
 	if (clock->pll_source == RCC_CFGR_PLLSRC_HSE_CLK) {
 		rcc_set_main_pll_hse(clock->pllm, clock->plln,
@@ -828,6 +832,7 @@ void rcc_clock_setup_pll(const struct rcc_clock_scale *clock)
 	/* Enable PLL oscillator and wait for it to stabilize. */
 	rcc_osc_on(RCC_PLL);
 	rcc_wait_for_osc_ready(RCC_PLL);
+	while (!(PWR_CSR & PWR_CSR_VOSRDY));
 
 	/* Configure flash settings. */
 	if (clock->flash_config & FLASH_ACR_DCEN) {
@@ -859,6 +864,247 @@ void rcc_clock_setup_pll(const struct rcc_clock_scale *clock)
 	}
 }
 
+/* PLL limits common to the F4 parts. */
+#define RCC_PLL_IN_MIN		1000000
+#define RCC_PLL_IN_MAX		2000000
+#define RCC_PLL_VCO_MIN		100000000
+#define RCC_PLL_VCO_MAX		432000000
+#define RCC_PLL_N_MIN		50
+#define RCC_PLL_N_MAX		432
+#define RCC_PLL_M_MAX		63
+#define RCC_PLL_Q_MAX		15
+#define RCC_PLL_USB_FREQ	48000000
+#define RCC_HSI_FREQ		16000000
+
+struct rcc_pll_candidate {
+	uint8_t m;
+	uint16_t n;
+	uint8_t p;
+	uint8_t q;
+	uint32_t sysclk;
+	uint32_t vco;
+};
+
+/* Keep the candidate closest to the target. Ties go to the lowest M, whose
+ * higher VCO input has the least jitter, then to the lowest VCO frequency,
+ * which draws the least power. */
+static void rcc_pll_consider(struct rcc_pll_candidate *best,
+			     const struct rcc_pll_candidate *c)
+{
+	if (c->sysclk > best->sysclk ||
+	    (c->sysclk == best->sysclk && c->m < best->m) ||
+	    (c->sysclk == best->sysclk && c->m == best->m &&
+	     c->vco < best->vco)) {
+		*best = *c;
+	}
+}
+
+/* Smallest APB prescaler keeping the bus at or below max. */
+static uint8_t rcc_ppre_solve(uint32_t hclk, uint32_t max, uint32_t *freq)
+{
+	uint8_t ppre = RCC_CFGR_PPRE_NODIV;
+	uint32_t div = 1;
+
+	while (hclk / div > max && div < 16) {
+		div *= 2;
+		ppre = (ppre == RCC_CFGR_PPRE_NODIV) ? RCC_CFGR_PPRE_DIV2 :
+			ppre + 1;
+	}
+	*freq = hclk / div;
+	return ppre;
+}
+
+/**
+ * Compute a clock configuration at runtime.
+ *
+ * Searches the main PLL settings for the SYSCLK closest to, and not above,
+ * the requested one, with exactly 48 MHz on the Q output if USB is needed.
+ * Among equal results the highest VCO input frequency (2 MHz, as recommended
+ * by ST against jitter) and then the lowest VCO frequency are preferred.
+ *
+ * The AHB runs at SYSCLK, the APB prescalers are the smallest within the
+ * given limits, the flash wait states follow the supply voltage and the
+ * lowest voltage scale allowed on every F4 part is chosen. Both are valid on
+ * every F4 part, at the cost of an extra wait state on some. The result can
+ * be passed to rcc_clock_setup_pll().
+ *
+ * The SYSCLK limit of the part (84 to 180 MHz) is not checked, and 180 MHz
+ * on the F42x/F43x also needs the over-drive mode.
+ *
+ * @param[in] req clock targets.
+ * @param[out] clock clock information structure.
+ * @returns true if a configuration was found, false otherwise.
+ */
+bool rcc_clock_scale_solve(const struct rcc_clock_request *req,
+			   struct rcc_clock_scale *clock)
+{
+	static const uint8_t pdiv[] = { 2, 4, 6, 8 };
+	struct rcc_pll_candidate best = { .sysclk = 0 };
+	struct rcc_pll_candidate c;
+	uint32_t src = req->hse_frequency ? req->hse_frequency : RCC_HSI_FREQ;
+	uint32_t target = req->sysclk_frequency;
+	uint16_t mv = req->vdd_mv ? req->vdd_mv : 3300;
+	uint32_t step;
+	uint64_t n;
+	unsigned int i;
+
+	for (c.m = 2; c.m <= RCC_PLL_M_MAX; c.m++) {
+		if (src < (uint64_t)RCC_PLL_IN_MIN * c.m ||
+		    src > (uint64_t)RCC_PLL_IN_MAX * c.m) {
+			continue;
+		}
+
+		if (req->usb) {
+			/* The VCO must be a multiple of 48 MHz. */
+			for (c.q = 2; c.q <= RCC_PLL_Q_MAX; c.q++) {
+				c.vco = RCC_PLL_USB_FREQ * c.q;
+				if (c.vco < RCC_PLL_VCO_MIN ||
+				    c.vco > RCC_PLL_VCO_MAX) {
+					continue;
+				}
+				n = (uint64_t)c.vco * c.m;
+				if (n % src || n / src < RCC_PLL_N_MIN ||
+				    n / src > RCC_PLL_N_MAX) {
+					continue;
+				}
+				c.n = n / src;
+				for (i = 0; i < sizeof(pdiv); i++) {
+					c.p = pdiv[i];
+					c.sysclk = c.vco / c.p;
+					if (c.sysclk <= target) {
+						rcc_pll_consider(&best, &c);
+						break;
+					}
+				}
+			}
+			continue;
+		}
+
+		for (i = 0; i < sizeof(pdiv); i++) {
+			c.p = pdiv[i];
+			n = (uint64_t)target * c.m * c.p / src;
+			if (n > (uint64_t)RCC_PLL_VCO_MAX * c.m / src) {
+				n = (uint64_t)RCC_PLL_VCO_MAX * c.m / src;
+			}
+			if (n > RCC_PLL_N_MAX) {
+				n = RCC_PLL_N_MAX;
+			}
+			if (n < RCC_PLL_N_MIN) {
+				continue;
+			}
+			c.n = n;
+			c.vco = RCC_PLL_FREQUENCY(src, c.m, c.n, 1);
+			if (c.vco < RCC_PLL_VCO_MIN) {
+				continue;
+			}
+			c.sysclk = c.vco / c.p;
+			/* Keep the 48 MHz clock at or below 48 MHz. */
+			c.q = (c.vco + RCC_PLL_USB_FREQ - 1) / RCC_PLL_USB_FREQ;
+			if (c.q < 2) {
+				c.q = 2;
+			}
+			rcc_pll_consider(&best, &c);
+		}
+	}
+
+	if (!best.sysclk) {
+		return false;
+	}
+
+	clock->pllm = best.m;
+	clock->plln = best.n;
+	clock->pllp = best.p;
+	clock->pllq = best.q;
+	clock->pllr = 0;
+	clock->pll_source = req->hse_frequency ? RCC_CFGR_PLLSRC_HSE_CLK :
+			    RCC_CFGR_PLLSRC_HSI_CLK;
+	clock->hpre = RCC_CFGR_HPRE_NODIV;
+	clock->ahb_frequency = best.sysclk;
+	clock->ppre1 = rcc_ppre_solve(best.sysclk,
+				      req->apb1_max ? req->apb1_max : 42000000,
+				      &clock->apb1_frequency);
+	clock->ppre2 = rcc_ppre_solve(best.sysclk,
+				      req->apb2_max ? req->apb2_max : 84000000,
+				      &clock->apb2_frequency);
+
+	/* Scale 3 is good to 60 MHz on every part, scale 2 to 84 MHz. */
+	if (best.sysclk <= 60000000) {
+		clock->voltage_scale = PWR_SCALE3;
+	} else if (best.sysclk <= 84000000) {
+		clock->voltage_scale = PWR_SCALE2;
+	} else {
+		clock->voltage_scale = PWR_SCALE1;
+	}
+
+	/*
+	 * HCLK per wait state for each supply range. Below 2.4 V the
+	 * F401/F411/F412/F413 need more wait states than the F40x/F42x, take
+	 * theirs.
+	 */
+	if (mv >= 2700) {
+		step = 30000000;
+	} else if (mv >= 2400) {
+		step = 24000000;
+	} else if (mv >= 2100) {
+		step = 18000000;
+	} else {
+		step = 16000000;
+	}
+	clock->flash_config = FLASH_ACR_DCEN | FLASH_ACR_ICEN |
+			      FLASH_ACR_LATENCY((best.sysclk - 1) / step);
+
+	return true;
+}
+
+/**
+ * Compute the settings of an auxiliary PLL.
+ *
+ * The PLLI2S and PLLSAI share the input divider M of the main PLL. This
+ * searches their multiplier N and one output divider for the frequency
+ * closest to the requested one, e.g. a multiple of an audio sample rate.
+ * Among equal results the highest VCO frequency is preferred, which also
+ * meets the PLLI2SN >= 192 limit of the F40x/F41x.
+ *
+ * @param[in] clock main PLL configuration, for M.
+ * @param[in] src_frequency PLL input frequency in Hz (HSE or 16 MHz HSI).
+ * @param[in] frequency wanted output frequency in Hz.
+ * @param[in] div_min smallest output divider, 2 for PLLI2SR and PLLSAIQ.
+ * @param[in] div_max largest output divider, 7 for PLLI2SR, 15 for PLLSAIQ.
+ * @param[out] n multiplier, for rcc_plli2s_config() or rcc_pllsai_config().
+ * @param[out] div output divider.
+ * @returns the output frequency in Hz, or 0 if none is possible.
+ */
+uint32_t rcc_pll_aux_solve(const struct rcc_clock_scale *clock,
+			   uint32_t src_frequency, uint32_t frequency,
+			   uint8_t div_min, uint8_t div_max,
+			   uint16_t *n, uint8_t *div)
+{
+	uint32_t best = 0, best_err = UINT32_MAX;
+	uint32_t out, err, vco;
+	uint16_t k;
+	uint8_t d;
+
+	for (k = RCC_PLL_N_MAX; k >= RCC_PLL_N_MIN; k--) {
+		vco = RCC_PLL_FREQUENCY(src_frequency, clock->pllm, k, 1);
+		if (vco < RCC_PLL_VCO_MIN || vco > RCC_PLL_VCO_MAX) {
+			continue;
+		}
+		for (d = div_min; d <= div_max; d++) {
+			out = RCC_PLL_FREQUENCY(src_frequency, clock->pllm,
+						k, d);
+			err = out > frequency ? out - frequency :
+			      frequency - out;
+			if (err < best_err) {
+				best = out;
+				best_err = err;
+				*n = k;
+				*div = d;
+			}
+		}
+	}
+	return best;
+}
+
 /**
  * Setup clocks with the HSE.
  *
@@ -26,7 +26,12 @@
 
 /**@{*/
 
+#include <libopencm3/stm32/dbgmcu.h>
+#include <libopencm3/stm32/desig.h>
 #include <libopencm3/stm32/flash.h>
+#include <libopencm3/stm32/syscfg.h>
+
+#define DBGMCU_IDCODE_DEV_ID_STM32F76X_77X	0x451
 
 /*---------------------------------------------------------------------------*/
 /** @brief Issue Pipeline Stall
@@ -103,4 +108,75 @@ void flash_art_reset(void)
 	FLASH_ACR |= FLASH_ACR_ARTRST;
 }
 
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash is Dual Bank
+
+Only F76x/F77x parts can be split into two banks, with the nDBANK option
+cleared. The bit is reserved and reads 0 on the other parts.
+
+@returns true when the flash is split into two banks.
+*/
+
+bool flash_is_dual_bank(void)
+{
+	if ((DBGMCU_IDCODE & DBGMCU_IDCODE_DEV_ID_MASK) !=
+	    DBGMCU_IDCODE_DEV_ID_STM32F76X_77X) {
+		return false;
+	}
+	return !(FLASH_OPTCR & FLASH_OPTCR_NDBANK);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Get the Size of a Flash Bank
+
+@returns Size of a bank in bytes, or of the whole flash on single bank parts.
+Bank 2 starts at FLASH_BASE plus this size.
+*/
+
+uint32_t flash_bank_size(void)
+{
+	uint32_t size = (uint32_t)desig_get_flash_size() * 1024;
+
+	return flash_is_dual_bank() ? size / 2 : size;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Get the Active Flash Bank
+
+The SYSCFG clock must be enabled. The boot bank is selected with the boot
+address options, there is no bank swap option.
+
+@returns Physical bank mapped at FLASH_BASE, 1 or 2.
+*/
+
+uint8_t flash_bank_active(void)
+{
+	return (SYSCFG_MEMRM & SYSCFG_MEMRM_SWP_FB) ? 2 : 1;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Erase a Flash Bank
+
+@param[in] bank Physical bank, 1 or 2
+@param[in] program_size Programming word width, one of:
+@ref flash_cr_program_width
+*/
+
+void flash_erase_bank(uint8_t bank, uint32_t program_size)
+{
+	uint32_t mer = (bank == 2) ? FLASH_CR_MER1 : FLASH_CR_MER;
+
+	flash_wait_for_last_operation();
+	FLASH_CR = (FLASH_CR &
+		    ~(FLASH_CR_PROGRAM_MASK << FLASH_CR_PROGRAM_SHIFT)) |
+		   (program_size << FLASH_CR_PROGRAM_SHIFT);
+
+	FLASH_CR |= mer;
+	FLASH_CR |= FLASH_CR_STRT;
+
+	flash_wait_for_last_operation();
+	FLASH_CR &= ~mer;
+}
+
 /**@}*/
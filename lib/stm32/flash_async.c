@@ -0,0 +1,399 @@
+/** @defgroup flash_async_file Asynchronous flash engine
+
+@ingroup STM32F_files
+
+@brief <b>libopencm3 STM32 interrupt driven flash erase and program
+engine</b>
+
+@version 1.0.0
+
+Sector/page erase and program jobs are queued with flash_async_submit() and
+run back to back from the flash end of operation and error interrupts: each
+interrupt finishes one flash operation and starts the next, so nothing waits
+on the busy flag.
+
+The CPU stalls on any flash access while an operation is in progress. Code
+that must keep running meanwhile has to be in RAM: the interrupt handler
+calling flash_async_irq(), the job callbacks, the control loops and their
+interrupt handlers, and the vector table itself (see SCB_VTOR). The engine's
+interrupt path is placed in the .ramtext section of the linker script for
+that purpose, and @ref FLASH_ASYNC_RAMFUNC does the same for application
+code.
+
+The flash must be unlocked before the first job is submitted, and the flash
+interrupt enabled in the NVIC. On F1 XL density parts, only the first bank
+is supported.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/stm32/flash_async.h>
+
+/*
+ * Controller specific parts. All of them run from the flash interrupt and
+ * are placed in RAM with it.
+ */
+#if defined(STM32F2) || defined(STM32F4) || defined(STM32F7)
+
+#define FLASH_ASYNC_CR		FLASH_CR
+#define FLASH_ASYNC_IRQS	(FLASH_CR_EOPIE | FLASH_CR_ERRIE)
+#define FLASH_ASYNC_ERRORS	(FLASH_SR_SEQERR | FLASH_SR_PGPERR | \
+				 FLASH_SR_PGAERR | FLASH_SR_WRPERR | \
+				 FLASH_SR_OPERR)
+#define FLASH_ASYNC_OPS		(FLASH_CR_SER | FLASH_CR_PG | \
+				 (FLASH_CR_SNB_MASK << FLASH_CR_SNB_SHIFT))
+#define FLASH_ASYNC_PAD		0xff
+
+FLASH_ASYNC_RAMFUNC
+static void flash_async_set_psize(uint32_t psize)
+{
+	FLASH_CR = (FLASH_CR &
+		    ~(FLASH_CR_PROGRAM_MASK << FLASH_CR_PROGRAM_SHIFT)) |
+		   (psize << FLASH_CR_PROGRAM_SHIFT);
+}
+
+FLASH_ASYNC_RAMFUNC
+static void flash_async_start_erase(struct flash_async *fa, uint32_t sector)
+{
+	/* Sector numbering is not contiguous internally! */
+	if (sector >= 12) {
+		sector += 4;
+	}
+	flash_async_set_psize(fa->program_size);
+	FLASH_CR |= FLASH_CR_SER |
+		    ((sector & FLASH_CR_SNB_MASK) << FLASH_CR_SNB_SHIFT);
+	FLASH_CR |= FLASH_CR_STRT;
+}
+
+FLASH_ASYNC_RAMFUNC
+static void flash_async_start_program(struct flash_async *fa)
+{
+	fa->unit = 0;
+	FLASH_CR |= FLASH_CR_PG;
+}
+
+/* Widest flash word allowed by the program size, alignment and length. */
+FLASH_ASYNC_RAMFUNC
+static uint8_t flash_async_width(struct flash_async *fa, uint32_t address,
+				 uint32_t len)
+{
+	uint8_t w = 1 << fa->program_size;
+	uint8_t ps = fa->program_size;
+
+	while (w > 1 && ((address & (w - 1)) || len < w)) {
+		w >>= 1;
+		ps--;
+	}
+	if (w != fa->unit) {
+		flash_async_set_psize(ps);
+	}
+	return w;
+}
+
+#elif defined(STM32F0) || defined(STM32F1)
+
+#define FLASH_ASYNC_CR		FLASH_CR
+#define FLASH_ASYNC_IRQS	(FLASH_CR_EOPIE | FLASH_CR_ERRIE)
+#define FLASH_ASYNC_ERRORS	(FLASH_SR_PGERR | FLASH_SR_WRPRTERR)
+#define FLASH_ASYNC_OPS		(FLASH_CR_PER | FLASH_CR_PG)
+#define FLASH_ASYNC_PAD		0xff
+
+FLASH_ASYNC_RAMFUNC
+static void flash_async_start_erase(struct flash_async *fa, uint32_t page)
+{
+	(void)fa;
+	FLASH_CR |= FLASH_CR_PER;
+	FLASH_AR = page;
+	FLASH_CR |= FLASH_CR_STRT;
+}
+
+FLASH_ASYNC_RAMFUNC
+static void flash_async_start_program(struct flash_async *fa)
+{
+	(void)fa;
+	FLASH_CR |= FLASH_CR_PG;
+}
+
+FLASH_ASYNC_RAMFUNC
+static uint8_t flash_async_width(struct flash_async *fa, uint32_t address,
+				 uint32_t len)
+{
+	(void)fa;
+	(void)address;
+	(void)len;
+	return 2;
+}
+
+#elif defined(STM32L0) || defined(STM32L1)
+
+#define FLASH_ASYNC_CR		FLASH_PECR
+#define FLASH_ASYNC_IRQS	(FLASH_PECR_EOPIE | FLASH_PECR_ERRIE)
+#define FLASH_ASYNC_ERRORS	(FLASH_SR_WRPERR | FLASH_SR_PGAERR | \
+				 FLASH_SR_SIZEERR)
+#define FLASH_ASYNC_OPS		(FLASH_PECR_ERASE | FLASH_PECR_PROG)
+/* Erased flash reads as zero */
+#define FLASH_ASYNC_PAD		0x00
+
+FLASH_ASYNC_RAMFUNC
+static void flash_async_start_erase(struct flash_async *fa, uint32_t page)
+{
+	(void)fa;
+	FLASH_PECR |= FLASH_PECR_ERASE | FLASH_PECR_PROG;
+	MMIO32(page) = 0;
+}
+
+FLASH_ASYNC_RAMFUNC
+static void flash_async_start_program(struct flash_async *fa)
+{
+	/* Single words are written without any mode bit. */
+	(void)fa;
+}
+
+FLASH_ASYNC_RAMFUNC
+static uint8_t flash_async_width(struct flash_async *fa, uint32_t address,
+				 uint32_t len)
+{
+	(void)fa;
+	(void)address;
+	(void)len;
+	return 4;
+}
+
+#else
+#error "Asynchronous flash engine not supported on this family."
+#endif
+
+/* Program the next flash word of the head job. */
+FLASH_ASYNC_RAMFUNC
+static void flash_async_program_next(struct flash_async *fa,
+				     struct flash_async_job *job)
+{
+	uint32_t address = job->address + job->done;
+	uint32_t left = job->len - job->done;
+	const uint8_t *data = job->data + job->done;
+	uint32_t lo = 0, hi = 0;
+	uint8_t w, i;
+
+	w = flash_async_width(fa, address, left);
+	fa->unit = w;
+
+	for (i = 0; i < w; i++) {
+		uint32_t b = (i < left) ? data[i] : FLASH_ASYNC_PAD;
+
+		if (i < 4) {
+			lo |= b << (8 * i);
+		} else {
+			hi |= b << (8 * (i - 4));
+		}
+	}
+	switch (w) {
+	case 8:
+		MMIO32(address) = lo;
+		MMIO32(address + 4) = hi;
+		break;
+	case 4:
+		MMIO32(address) = lo;
+		break;
+	case 2:
+		MMIO16(address) = lo;
+		break;
+	default:
+		MMIO8(address) = lo;
+		break;
+	}
+}
+
+/* Remove the head job and run its callback. */
+FLASH_ASYNC_RAMFUNC
+static void flash_async_finish(struct flash_async *fa, uint32_t status)
+{
+	struct flash_async_job *job = fa->head;
+
+	FLASH_ASYNC_CR &= ~FLASH_ASYNC_OPS;
+	/* CM_CRITICAL_CONTEXT() would run from the flash. */
+	CM_ATOMIC_BLOCK() {
+		fa->head = job->next;
+		if (fa->head == NULL) {
+			fa->tail = NULL;
+		}
+	}
+	if (status) {
+		fa->errors++;
+	} else {
+		fa->jobs++;
+	}
+
+	job->status = status;
+	if (job->callback) {
+		job->callback(fa, job);
+	}
+}
+
+/* Start the first operation of the head job, or stop when idle. */
+FLASH_ASYNC_RAMFUNC
+static void flash_async_run(struct flash_async *fa)
+{
+	struct flash_async_job *job;
+
+	for (;;) {
+		CM_ATOMIC_BLOCK() {
+			job = fa->head;
+			if (job == NULL) {
+				FLASH_ASYNC_CR &= ~FLASH_ASYNC_IRQS;
+				fa->busy = false;
+			}
+		}
+		if (job == NULL) {
+			return;
+		}
+
+		if (job->op == FLASH_ASYNC_ERASE) {
+			flash_async_start_erase(fa, job->address);
+			return;
+		}
+		if (job->len) {
+			flash_async_start_program(fa);
+			flash_async_program_next(fa, job);
+			return;
+		}
+		flash_async_finish(fa, 0);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash Initialise Job Queue
+
+@param[out] fa Queue
+@param[in] program_size Widest programming word width allowed by the supply
+voltage on F2/F4/F7, one of: @ref flash_cr_program_width. Ignored elsewhere.
+*/
+
+void flash_async_init(struct flash_async *fa, uint32_t program_size)
+{
+	fa->program_size = program_size;
+	fa->head = NULL;
+	fa->tail = NULL;
+	fa->busy = false;
+	fa->unit = 0;
+	fa->jobs = 0;
+	fa->errors = 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash Submit Job
+
+Queue a job, starting it if the queue is idle. The erase and program errors
+of a program job that starts on an idle queue are acknowledged first.
+
+@param[in] fa Queue
+@param[in] job Job, owned by the caller until its callback has run
+*/
+
+void flash_async_submit(struct flash_async *fa, struct flash_async_job *job)
+{
+	CM_CRITICAL_CONTEXT();
+
+	job->next = NULL;
+	job->status = 0;
+	job->done = 0;
+	if (fa->tail) {
+		fa->tail->next = job;
+	} else {
+		fa->head = job;
+	}
+	fa->tail = job;
+
+	if (!fa->busy) {
+		fa->busy = true;
+		FLASH_SR = FLASH_SR_EOP | FLASH_ASYNC_ERRORS;
+		FLASH_ASYNC_CR |= FLASH_ASYNC_IRQS;
+		flash_async_run(fa);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash Interrupt Handler
+
+Must be called from the flash interrupt. Programs the next flash word of the
+current job, or completes it and starts the next one. Runs from RAM.
+
+@param[in] fa Queue
+*/
+
+FLASH_ASYNC_RAMFUNC
+void flash_async_irq(struct flash_async *fa)
+{
+	uint32_t sr = FLASH_SR;
+	uint32_t errors = sr & FLASH_ASYNC_ERRORS;
+	struct flash_async_job *job = fa->head;
+
+	FLASH_SR = sr & (FLASH_SR_EOP | FLASH_ASYNC_ERRORS);
+	if (job == NULL) {
+		return;
+	}
+
+	if (errors) {
+		flash_async_finish(fa, errors);
+		flash_async_run(fa);
+	} else if (sr & FLASH_SR_EOP) {
+		if (job->op == FLASH_ASYNC_PROGRAM) {
+			job->done += fa->unit;
+			if (job->done < job->len) {
+				flash_async_program_next(fa, job);
+				return;
+			}
+			job->done = job->len;
+		}
+		flash_async_finish(fa, 0);
+		flash_async_run(fa);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash Wait for Job Queue
+
+Wait until all queued jobs have completed. Runs from RAM, so interrupts are
+served while waiting.
+
+@param[in] fa Queue
+*/
+
+FLASH_ASYNC_RAMFUNC
+void flash_async_wait(struct flash_async *fa)
+{
+	while (fa->busy);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash Job Queue Busy
+
+@param[in] fa Queue
+@returns true while jobs are queued or running.
+*/
+
+bool flash_async_busy(struct flash_async *fa)
+{
+	return fa->busy;
+}
+
+/**@}*/
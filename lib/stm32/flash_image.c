@@ -0,0 +1,207 @@
+/** @defgroup flash_image_file Flash image writer
+
+@ingroup STM32F_files
+
+@brief <b>libopencm3 STM32 streaming flash image writer</b>
+
+@version 1.0.0
+
+Writes a firmware image received in chunks of any size, such as packets of an
+update protocol, to an erased flash area. Chunks are assembled into 8 byte
+flash words, each programmed and read back as soon as it is complete, and a
+CRC-32 of the data is kept along the way. flash_image_finish() programs the
+last partial word, checks the CRC of the flash content against it and
+against the CRC expected by the caller.
+
+On dual bank parts the image is typically written to the inactive bank at
+FLASH_BASE + flash_bank_size(), erased with flash_erase_bank(), while the
+application keeps running from the active bank without stalling. The bank
+swap option then boots the new image at the next reset.
+
+The CRC is the common CRC-32 (polynomial 0x04C11DB7 reflected, as used by
+zlib and Ethernet), computed in software so that it matches host tools.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/stm32/flash.h>
+#include <libopencm3/stm32/flash_image.h>
+
+static const uint32_t flash_image_crc_table[16] = {
+	0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+	0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+	0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+	0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+/* Program the buffered flash word at the given offset and read it back. */
+static int flash_image_program(struct flash_image *img, uint32_t offset)
+{
+	uint32_t address = img->base + offset;
+	uint32_t lo = 0, hi = 0;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		lo |= (uint32_t)img->word[i] << (8 * i);
+		hi |= (uint32_t)img->word[i + 4] << (8 * i);
+	}
+
+#if defined(STM32F2) || defined(STM32F4) || defined(STM32F7)
+	flash_program_bulk(address, img->word, 8, img->program_size, NULL);
+#else
+	flash_program_double_word(address, ((uint64_t)hi << 32) | lo);
+#endif
+
+	if (MMIO32(address) != lo || MMIO32(address + 4) != hi) {
+		return FLASH_IMAGE_E_PROGRAM;
+	}
+	return FLASH_IMAGE_E_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash Image CRC-32
+
+Continue a CRC-32 over a block of data.
+
+@param[in] crc CRC of the preceding data, 0 to start
+@param[in] data Data
+@param[in] len Number of bytes
+@returns CRC of the preceding data and the block.
+*/
+
+uint32_t flash_image_crc32(uint32_t crc, const void *data, uint32_t len)
+{
+	const uint8_t *p = data;
+
+	crc = ~crc;
+	while (len--) {
+		crc ^= *p++;
+		crc = (crc >> 4) ^ flash_image_crc_table[crc & 0xf];
+		crc = (crc >> 4) ^ flash_image_crc_table[crc & 0xf];
+	}
+	return ~crc;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash Image Begin
+
+Start writing an image. The area must be erased and the flash unlocked.
+
+@param[out] img Writer state
+@param[in] base First address of the area, 8 byte aligned
+@param[in] size Size of the area in bytes
+@param[in] program_size Programming word width on F2/F4/F7, one of:
+@ref flash_cr_program_width. Ignored elsewhere.
+*/
+
+void flash_image_begin(struct flash_image *img, uint32_t base, uint32_t size,
+		       uint32_t program_size)
+{
+	img->base = base;
+	img->size = size;
+	img->program_size = program_size;
+	img->offset = 0;
+	img->crc = 0;
+	img->status = FLASH_IMAGE_E_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash Image Write
+
+Append a chunk to the image. Once an error has occurred, it is returned by
+all further calls.
+
+@param[in] img Writer state
+@param[in] data Chunk
+@param[in] len Number of bytes
+@returns 0 or one of @ref flash_image_error
+*/
+
+int flash_image_write(struct flash_image *img, const void *data,
+		      uint32_t len)
+{
+	const uint8_t *p = data;
+
+	if (img->status) {
+		return img->status;
+	}
+	if (len > img->size - img->offset) {
+		img->status = FLASH_IMAGE_E_SIZE;
+		return img->status;
+	}
+
+	img->crc = flash_image_crc32(img->crc, data, len);
+	while (len--) {
+		img->word[img->offset & 7] = *p++;
+		img->offset++;
+		if ((img->offset & 7) == 0) {
+			img->status = flash_image_program(img,
+							  img->offset - 8);
+			if (img->status) {
+				break;
+			}
+		}
+	}
+	return img->status;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash Image Finish
+
+Program the last partial flash word, padded with 0xff, and verify the
+image: the CRC of the flash content must match the CRC of the written data,
+which must match the expected CRC.
+
+@param[in] img Writer state
+@param[in] crc Expected CRC-32 of the image
+@returns 0 or one of @ref flash_image_error
+*/
+
+int flash_image_finish(struct flash_image *img, uint32_t crc)
+{
+	uint32_t fill = img->offset & 7;
+	uint32_t i;
+
+	if (img->status) {
+		return img->status;
+	}
+
+	if (fill) {
+		for (i = fill; i < 8; i++) {
+			img->word[i] = 0xff;
+		}
+		img->status = flash_image_program(img, img->offset - fill);
+		if (img->status) {
+			return img->status;
+		}
+	}
+
+	if (flash_image_crc32(0, (const void *)img->base, img->offset) !=
+	    img->crc) {
+		img->status = FLASH_IMAGE_E_VERIFY;
+	} else if (img->crc != crc) {
+		img->status = FLASH_IMAGE_E_CRC;
+	}
+	return img->status;
+}
+
+/**@}*/
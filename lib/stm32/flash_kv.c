@@ -0,0 +1,677 @@
+/** @defgroup flash_kv_file Flash key-value store
+
+@ingroup STM32F_files
+
+@brief <b>libopencm3 STM32 log-structured flash key-value store</b>
+
+@version 1.0.0
+
+Small values, such as configuration and calibration data, are stored as an
+append-only log of records spread over two or more flash areas (sectors or
+pages). Setting a value appends a new record, so each flash word is only
+programmed once and the wear is spread over all areas. A RAM index holding
+the address of the latest record of each key, rebuilt by replaying the log
+at flash_kv_init(), makes reads O(1).
+
+Each area starts with a header holding a sequence number that gives the
+order of the log. A record is a header with the key, length and CRC-32,
+the value padded to 8 bytes, and a commit marker programmed last; records
+interrupted by a power failure have no valid marker and are ignored, as are
+areas whose header was not completely written or whose erase was
+interrupted.
+
+When the area being written is full and only one erased area is left, the
+oldest area is collected: its live records are copied to the erased area and
+it is erased. With two areas, the oldest area is the full one itself. A
+collection copies at most one area and erases one, which bounds the pause;
+flash_kv_compact() runs it ahead of time, from idle time. Tombstones are
+dropped when their area is collected, as no older record can exist by then.
+
+All flash writes are whole 8 byte words, the widest program granularity
+shared by the supported families.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <string.h>
+#include <libopencm3/stm32/flash.h>
+#include <libopencm3/stm32/flash_image.h>
+#include <libopencm3/stm32/flash_kv.h>
+
+/* Area header and record framing */
+#define FLASH_KV_MAGIC		0x314b5646
+#define FLASH_KV_COMMIT		0x544d4d43
+#define FLASH_KV_TOMBSTONE	0x8000
+/* Key of the record ending a collection */
+#define FLASH_KV_DONE		0xffff
+#define FLASH_KV_WORD		8
+
+static uint32_t flash_kv_get32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void flash_kv_put32(uint8_t *p, uint32_t v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+/* Size of a record, from the header to the commit marker. */
+static uint32_t flash_kv_size(uint16_t len)
+{
+	return FLASH_KV_WORD + (((len & FLASH_KV_MAX_LEN) + 7) & ~7) +
+	       FLASH_KV_WORD;
+}
+
+static uint32_t flash_kv_free(const struct flash_kv_area *a)
+{
+	return a->address + a->size - a->end;
+}
+
+static bool flash_kv_blank(struct flash_kv *kv, const uint8_t *b)
+{
+	int i;
+
+	for (i = 0; i < FLASH_KV_WORD; i++) {
+		if (b[i] != kv->ops->erased) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static uint8_t flash_kv_erased_areas(struct flash_kv *kv)
+{
+	uint8_t i, n = 0;
+
+	for (i = 0; i < kv->count; i++) {
+		if (kv->areas[i].seq == 0) {
+			n++;
+		}
+	}
+	return n;
+}
+
+/*
+ * Read and check the record at an address. Returns its size, 0 at the end of
+ * the log, or -1 for a record that was not completely written.
+ */
+static int32_t flash_kv_check(struct flash_kv *kv,
+			      const struct flash_kv_area *a, uint32_t addr,
+			      uint16_t *key, uint16_t *len)
+{
+	uint32_t limit = a->address + a->size;
+	uint8_t b[FLASH_KV_WORD];
+	uint32_t size, crc, off, n;
+
+	if (addr + 2 * FLASH_KV_WORD > limit) {
+		return 0;
+	}
+	kv->ops->read(kv, addr, b, FLASH_KV_WORD);
+	if (flash_kv_blank(kv, b)) {
+		return 0;
+	}
+
+	*key = b[0] | (b[1] << 8);
+	*len = b[2] | (b[3] << 8);
+	size = flash_kv_size(*len);
+	if (size > limit - addr) {
+		return -1;
+	}
+
+	crc = flash_image_crc32(0, b, 4);
+	n = *len & FLASH_KV_MAX_LEN;
+	for (off = 0; off < n; off += FLASH_KV_WORD) {
+		uint32_t c = (n - off < FLASH_KV_WORD) ? n - off :
+			     FLASH_KV_WORD;
+		uint8_t d[FLASH_KV_WORD];
+
+		kv->ops->read(kv, addr + FLASH_KV_WORD + off, d, c);
+		crc = flash_image_crc32(crc, d, c);
+	}
+	if (crc != flash_kv_get32(b + 4)) {
+		return -1;
+	}
+
+	kv->ops->read(kv, addr + size - FLASH_KV_WORD, b, 4);
+	if (flash_kv_get32(b) != FLASH_KV_COMMIT) {
+		return -1;
+	}
+	return size;
+}
+
+/* Start writing an erased area. */
+static int flash_kv_open(struct flash_kv *kv, uint8_t i)
+{
+	struct flash_kv_area *a = &kv->areas[i];
+	uint8_t b[FLASH_KV_WORD];
+
+	kv->seq++;
+	flash_kv_put32(b, FLASH_KV_MAGIC);
+	flash_kv_put32(b + 4, kv->seq);
+	a->seq = kv->seq;
+	a->end = a->address + FLASH_KV_WORD;
+	kv->head = i;
+	return kv->ops->program(kv, a->address, b) ? FLASH_KV_E_FLASH : 0;
+}
+
+static int flash_kv_erase(struct flash_kv *kv, struct flash_kv_area *a)
+{
+	a->seq = 0;
+	a->end = a->address;
+	return kv->ops->erase(kv, a) ? FLASH_KV_E_FLASH : 0;
+}
+
+/*
+ * Append a record to the head area, which must have room for it. The value
+ * is taken from data, or read from the flash at src when data is NULL.
+ */
+static int flash_kv_append(struct flash_kv *kv, uint16_t key, uint16_t len,
+			   uint32_t crc, const uint8_t *data, uint32_t src,
+			   uint32_t *addr)
+{
+	struct flash_kv_area *a = &kv->areas[kv->head];
+	uint32_t at = a->end;
+	uint32_t n = len & FLASH_KV_MAX_LEN;
+	uint8_t b[FLASH_KV_WORD];
+	uint32_t off;
+	int err = 0;
+
+	/* Space is consumed even if programming fails. */
+	a->end += flash_kv_size(len);
+
+	b[0] = key;
+	b[1] = key >> 8;
+	b[2] = len;
+	b[3] = len >> 8;
+	flash_kv_put32(b + 4, crc);
+	err |= kv->ops->program(kv, at, b);
+
+	for (off = 0; off < n && !err; off += FLASH_KV_WORD) {
+		uint32_t c = (n - off < FLASH_KV_WORD) ? n - off :
+			     FLASH_KV_WORD;
+
+		memset(b, kv->ops->erased, FLASH_KV_WORD);
+		if (data) {
+			memcpy(b, data + off, c);
+		} else {
+			kv->ops->read(kv, src + off, b, c);
+		}
+		err |= kv->ops->program(kv, at + FLASH_KV_WORD + off, b);
+	}
+
+	flash_kv_put32(b, FLASH_KV_COMMIT);
+	flash_kv_put32(b + 4, ~FLASH_KV_COMMIT);
+	if (!err) {
+		err = kv->ops->program(kv, a->end - FLASH_KV_WORD, b);
+	}
+	if (err) {
+		return FLASH_KV_E_FLASH;
+	}
+	*addr = at;
+	return 0;
+}
+
+/*
+ * Copy the live records of the oldest area to an erased one, mark the copy
+ * complete, then erase the oldest area. The head itself is the oldest area
+ * when it is the only one written, as with a store of two areas.
+ */
+static int flash_kv_collect(struct flash_kv *kv)
+{
+	struct flash_kv_area *old = NULL;
+	uint8_t i, fresh = kv->count;
+	uint8_t b[FLASH_KV_WORD];
+	uint32_t addr;
+	int err;
+
+	for (i = 0; i < kv->count; i++) {
+		struct flash_kv_area *a = &kv->areas[i];
+
+		if (a->seq == 0) {
+			fresh = i;
+		} else if (!old || a->seq < old->seq) {
+			old = a;
+		}
+	}
+	if (!old || fresh == kv->count) {
+		return FLASH_KV_E_FULL;
+	}
+
+	err = flash_kv_open(kv, fresh);
+	if (err) {
+		return err;
+	}
+
+	addr = old->address + FLASH_KV_WORD;
+	while (addr < old->end) {
+		uint16_t key, len;
+		int32_t size = flash_kv_check(kv, old, addr, &key, &len);
+		uint32_t to;
+
+		if (size <= 0) {
+			break;
+		}
+		if (key < kv->keys && kv->index[key] == addr) {
+			if (flash_kv_free(&kv->areas[kv->head]) <
+			    (uint32_t)size + 2 * FLASH_KV_WORD) {
+				return FLASH_KV_E_FULL;
+			}
+			kv->ops->read(kv, addr, b, FLASH_KV_WORD);
+			err = flash_kv_append(kv, key, len,
+					      flash_kv_get32(b + 4), NULL,
+					      addr + FLASH_KV_WORD, &to);
+			if (err) {
+				return err;
+			}
+			kv->index[key] = to;
+		}
+		addr += size;
+	}
+
+	b[0] = FLASH_KV_DONE & 0xff;
+	b[1] = FLASH_KV_DONE >> 8;
+	b[2] = 0;
+	b[3] = 0;
+	err = flash_kv_append(kv, FLASH_KV_DONE, 0, flash_image_crc32(0, b, 4),
+			      NULL, 0, &addr);
+	if (err) {
+		return err;
+	}
+
+	kv->collections++;
+	return flash_kv_erase(kv, old);
+}
+
+/* Make room for a record in the head area. */
+static int flash_kv_reserve(struct flash_kv *kv, uint32_t size)
+{
+	uint8_t tries, i;
+	int err;
+
+	if (size > kv->areas[kv->head].size - FLASH_KV_WORD) {
+		return FLASH_KV_E_FULL;
+	}
+
+	for (tries = 0; tries <= kv->count; tries++) {
+		if (flash_kv_free(&kv->areas[kv->head]) >= size) {
+			return 0;
+		}
+		if (flash_kv_erased_areas(kv) >= 2) {
+			i = 0;
+			while (kv->areas[i].seq) {
+				i++;
+			}
+			err = flash_kv_open(kv, i);
+		} else {
+			err = flash_kv_collect(kv);
+		}
+		if (err) {
+			return err;
+		}
+	}
+	return FLASH_KV_E_FULL;
+}
+
+/* Read the area headers, erasing areas that are neither valid nor blank. */
+static int flash_kv_scan(struct flash_kv *kv)
+{
+	uint8_t i;
+	int err;
+
+	kv->seq = 0;
+	kv->head = 0;
+	for (i = 0; i < kv->count; i++) {
+		struct flash_kv_area *a = &kv->areas[i];
+		uint8_t b[FLASH_KV_WORD];
+		uint32_t addr;
+
+		kv->ops->read(kv, a->address, b, FLASH_KV_WORD);
+		a->seq = 0;
+		a->end = a->address;
+		if (flash_kv_get32(b) == FLASH_KV_MAGIC &&
+		    flash_kv_get32(b + 4) != 0) {
+			a->seq = flash_kv_get32(b + 4);
+			if (a->seq > kv->seq) {
+				kv->seq = a->seq;
+				kv->head = i;
+			}
+			continue;
+		}
+
+		for (addr = a->address; addr < a->address + a->size;
+		     addr += FLASH_KV_WORD) {
+			kv->ops->read(kv, addr, b, FLASH_KV_WORD);
+			if (!flash_kv_blank(kv, b)) {
+				break;
+			}
+		}
+		if (addr < a->address + a->size) {
+			err = flash_kv_erase(kv, a);
+			if (err) {
+				return err;
+			}
+		}
+	}
+	return 0;
+}
+
+/*
+ * Rebuild the index by replaying the areas in log order. Returns true when
+ * the newest area ends a collection.
+ */
+static bool flash_kv_replay(struct flash_kv *kv)
+{
+	uint32_t last = 0;
+	bool done = false;
+	uint16_t i;
+
+	for (i = 0; i < kv->keys; i++) {
+		kv->index[i] = 0;
+	}
+
+	for (;;) {
+		struct flash_kv_area *a = NULL;
+		uint32_t addr;
+
+		for (i = 0; i < kv->count; i++) {
+			if (kv->areas[i].seq > last &&
+			    (!a || kv->areas[i].seq < a->seq)) {
+				a = &kv->areas[i];
+			}
+		}
+		if (!a) {
+			break;
+		}
+		last = a->seq;
+
+		addr = a->address + FLASH_KV_WORD;
+		for (;;) {
+			uint16_t key, len;
+			int32_t size = flash_kv_check(kv, a, addr, &key, &len);
+
+			if (size == 0) {
+				break;
+			}
+			if (size < 0) {
+				/* Never program over a torn record. */
+				addr = a->address + a->size;
+				break;
+			}
+			if (key < kv->keys) {
+				kv->index[key] = (len & FLASH_KV_TOMBSTONE) ?
+						 0 : addr;
+			} else if (key == FLASH_KV_DONE) {
+				done = (a->seq == kv->seq);
+			}
+			addr += size;
+		}
+		a->end = addr;
+	}
+	return done;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash Key-Value Store Initialise
+
+Rebuild the index by replaying the log, erasing the areas left incomplete
+by a power failure. Empty areas are initialised on the first start.
+
+@param[in] kv Store, with the backend, areas and index set
+@returns 0 or one of @ref flash_kv_error
+*/
+
+int flash_kv_init(struct flash_kv *kv)
+{
+	struct flash_kv_area *a;
+	uint8_t i;
+	bool done;
+	int err;
+
+	kv->collections = 0;
+	err = flash_kv_scan(kv);
+	if (err) {
+		return err;
+	}
+	done = flash_kv_replay(kv);
+
+	if (kv->seq == 0) {
+		return flash_kv_open(kv, 0);
+	}
+	if (flash_kv_erased_areas(kv)) {
+		return 0;
+	}
+
+	/*
+	 * A collection was cut short: finish it by erasing the collected
+	 * area if the copy is complete, otherwise drop the copy.
+	 */
+	a = &kv->areas[kv->head];
+	if (done) {
+		for (i = 0; i < kv->count; i++) {
+			if (kv->areas[i].seq < a->seq) {
+				a = &kv->areas[i];
+			}
+		}
+	}
+	err = flash_kv_erase(kv, a);
+	if (err) {
+		return err;
+	}
+	return flash_kv_init(kv);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash Key-Value Store Get
+
+@param[in] kv Store
+@param[in] key Key
+@param[out] data Value, truncated to @p size bytes
+@param[in] size Size of @p data
+@returns Length of the value, or one of @ref flash_kv_error
+*/
+
+int flash_kv_get(struct flash_kv *kv, uint16_t key, void *data,
+		 uint16_t size)
+{
+	uint8_t b[FLASH_KV_WORD];
+	uint16_t len;
+
+	if (key >= kv->keys) {
+		return FLASH_KV_E_KEY;
+	}
+	if (kv->index[key] == 0) {
+		return FLASH_KV_E_NOKEY;
+	}
+
+	kv->ops->read(kv, kv->index[key], b, FLASH_KV_WORD);
+	len = b[2] | (b[3] << 8);
+	kv->ops->read(kv, kv->index[key] + FLASH_KV_WORD, data,
+		      (len < size) ? len : size);
+	return len;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash Key-Value Store Set
+
+Append a value, collecting an area first if needed.
+
+@param[in] kv Store
+@param[in] key Key
+@param[in] data Value
+@param[in] len Length of the value, up to @ref FLASH_KV_MAX_LEN
+@returns 0 or one of @ref flash_kv_error
+*/
+
+int flash_kv_set(struct flash_kv *kv, uint16_t key, const void *data,
+		 uint16_t len)
+{
+	uint8_t b[4];
+	uint32_t crc, addr;
+	int err;
+
+	if (key >= kv->keys) {
+		return FLASH_KV_E_KEY;
+	}
+	if (len > FLASH_KV_MAX_LEN) {
+		return FLASH_KV_E_SIZE;
+	}
+
+	err = flash_kv_reserve(kv, flash_kv_size(len));
+	if (err) {
+		return err;
+	}
+
+	b[0] = key;
+	b[1] = key >> 8;
+	b[2] = len;
+	b[3] = len >> 8;
+	crc = flash_image_crc32(flash_image_crc32(0, b, 4), data, len);
+	err = flash_kv_append(kv, key, len, crc, data, 0, &addr);
+	if (err) {
+		return err;
+	}
+	kv->index[key] = addr;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash Key-Value Store Delete
+
+@param[in] kv Store
+@param[in] key Key
+@returns 0 or one of @ref flash_kv_error
+*/
+
+int flash_kv_delete(struct flash_kv *kv, uint16_t key)
+{
+	uint8_t b[4];
+	uint32_t addr;
+	int err;
+
+	if (key >= kv->keys) {
+		return FLASH_KV_E_KEY;
+	}
+	if (kv->index[key] == 0) {
+		return FLASH_KV_E_NOKEY;
+	}
+
+	err = flash_kv_reserve(kv, flash_kv_size(FLASH_KV_TOMBSTONE));
+	if (err) {
+		return err;
+	}
+
+	b[0] = key;
+	b[1] = key >> 8;
+	b[2] = 0;
+	b[3] = FLASH_KV_TOMBSTONE >> 8;
+	err = flash_kv_append(kv, key, FLASH_KV_TOMBSTONE,
+			      flash_image_crc32(0, b, 4), NULL, 0, &addr);
+	if (err) {
+		return err;
+	}
+	kv->index[key] = 0;
+	return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Flash Key-Value Store Compact
+
+Collect the oldest area if the next write could need it: only one erased
+area is left and the area being written is more than three quarters full.
+Call it from idle time to keep collections out of flash_kv_set().
+
+@param[in] kv Store
+@returns 0 or one of @ref flash_kv_error
+*/
+
+int flash_kv_compact(struct flash_kv *kv)
+{
+	const struct flash_kv_area *a = &kv->areas[kv->head];
+
+	if (flash_kv_erased_areas(kv) > 1 || flash_kv_free(a) >= a->size / 4) {
+		return 0;
+	}
+	return flash_kv_collect(kv);
+}
+
+/* Internal flash backend */
+
+#if defined(STM32F2) || defined(STM32F4) || defined(STM32F7)
+#define FLASH_KV_SR_ERRORS	(FLASH_SR_SEQERR | FLASH_SR_PGPERR | \
+				 FLASH_SR_PGAERR | FLASH_SR_WRPERR | \
+				 FLASH_SR_OPERR)
+#else
+#define FLASH_KV_SR_ERRORS	(FLASH_SR_FASTERR | FLASH_SR_MISERR | \
+				 FLASH_SR_PGSERR | FLASH_SR_SIZERR | \
+				 FLASH_SR_PGAERR | FLASH_SR_WRPERR | \
+				 FLASH_SR_PROGERR | FLASH_SR_OPERR)
+#endif
+
+static int flash_kv_flash_erase(struct flash_kv *kv,
+				const struct flash_kv_area *area)
+{
+	/* Errors of earlier operations would block the erase. */
+	FLASH_SR = FLASH_KV_SR_ERRORS;
+#if defined(STM32F2) || defined(STM32F4) || defined(STM32F7)
+	flash_erase_sector(area->erase, kv->program_size);
+#else
+	(void)kv;
+	flash_erase_page(area->erase);
+#endif
+	return (FLASH_SR & FLASH_KV_SR_ERRORS) ? -1 : 0;
+}
+
+static int flash_kv_flash_program(struct flash_kv *kv, uint32_t address,
+				  const uint8_t *data)
+{
+	uint32_t lo = flash_kv_get32(data);
+	uint32_t hi = flash_kv_get32(data + 4);
+
+#if defined(STM32F2) || defined(STM32F4) || defined(STM32F7)
+	flash_program_bulk(address, data, FLASH_KV_WORD, kv->program_size,
+			   NULL);
+#else
+	(void)kv;
+	flash_program_double_word(address, ((uint64_t)hi << 32) | lo);
+#endif
+	return (MMIO32(address) != lo || MMIO32(address + 4) != hi) ? -1 : 0;
+}
+
+static void flash_kv_flash_read(struct flash_kv *kv, uint32_t address,
+				uint8_t *data, uint32_t len)
+{
+	(void)kv;
+	memcpy(data, (const void *)address, len);
+}
+
+const struct flash_kv_ops flash_kv_flash_ops = {
+	.erase = flash_kv_flash_erase,
+	.program = flash_kv_flash_program,
+	.read = flash_kv_flash_read,
+	.erased = 0xff,
+};
+
+/**@}*/
@@ -81,6 +81,32 @@ unsigned fdcan_get_txbuf_element_size(uint32_t canport)
 	return sizeof(struct fdcan_tx_buffer_element);
 }
 
+/** Returns number of elements in receive FIFO.
+ *
+ * For G4 it returns constant value as G4 has FIFO layout hardcoded.
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block. Unused.
+ * @param [in] fifo_id ID of FIFO whose size is queried. Unused.
+ * @returns Number of elements in receive FIFO.
+ */
+unsigned fdcan_get_rxfifo_size(uint32_t canport, unsigned fifo_id)
+{
+	(void) (canport);
+	(void) (fifo_id);
+	return 3;
+}
+
+/** Returns number of elements in transmit queue/FIFO.
+ *
+ * For G4 it returns constant value as G4 has three transmit buffers.
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block. Unused.
+ * @returns Number of elements in transmit queue/FIFO.
+ */
+unsigned fdcan_get_txfifo_size(uint32_t canport)
+{
+	(void) (canport);
+	return 3;
+}
+
 /** Configure amount of filters and initialize filtering block.
  *
  * This function allows to configure global amount of filters present.
@@ -42,7 +42,9 @@
 
 /**@{*/
 
+#include <libopencm3/stm32/desig.h>
 #include <libopencm3/stm32/flash.h>
+#include <libopencm3/stm32/syscfg.h>
 
 /** @brief Wait until Last Operation has Ended
  * This loops indefinitely until an operation (write or erase) has completed
@@ -205,5 +207,75 @@ void flash_program_option_bytes(uint32_t data)
 	FLASH_CR |= FLASH_CR_OPTSTRT;
 	flash_wait_for_last_operation();
 }
+
+/** @brief Flash is Dual Bank
+ * @returns true when the DBANK option splits the flash into two banks.
+ */
+bool flash_is_dual_bank(void)
+{
+	return FLASH_OPTR & FLASH_OPTR_DUALBANK;
+}
+
+/** @brief Get the Size of a Flash Bank
+ * @returns Size of a bank in bytes, or of the whole flash on single bank
+ * parts. Bank 2 starts at FLASH_BASE plus this size.
+ */
+uint32_t flash_bank_size(void)
+{
+	uint32_t size = (uint32_t)desig_get_flash_size() * 1024;
+
+	return flash_is_dual_bank() ? size / 2 : size;
+}
+
+/** @brief Get the Active Flash Bank
+ * The SYSCFG clock must be enabled.
+ * @returns Physical bank mapped at FLASH_BASE, 1 or 2. The other bank is
+ * mapped at FLASH_BASE + flash_bank_size(), and can be programmed without
+ * stalling code running from the active one.
+ */
+uint8_t flash_bank_active(void)
+{
+	return (SYSCFG_MEMRM & SYSCFG_MEMRM_FB_MODE) ? 2 : 1;
+}
+
+/** @brief Erase a Flash Bank
+ * @param[in] bank Physical bank, 1 or 2
+ */
+void flash_erase_bank(uint8_t bank)
+{
+	uint32_t mer = (bank == 2) ? FLASH_CR_MER2 : FLASH_CR_MER1;
+
+	flash_wait_for_last_operation();
+
+	FLASH_CR |= mer;
+	FLASH_CR |= FLASH_CR_START;
+
+	flash_wait_for_last_operation();
+	FLASH_CR &= ~mer;
+}
+
+/** @brief Get the Boot Bank Option
+ * @returns true when the BFB2 option selects booting from bank 2.
+ */
+bool flash_bank_swap_get(void)
+{
+	return FLASH_OPTR & FLASH_OPTR_BFB2;
+}
+
+/** @brief Set the Boot Bank Option
+ * Program the BFB2 option. It takes effect at the next reset or option byte
+ * reload, when the bank selected by it is mapped at FLASH_BASE.
+ * @param[in] swap Boot from bank 2
+ */
+void flash_bank_swap_set(bool swap)
+{
+	uint32_t optr = FLASH_OPTR & ~FLASH_OPTR_BFB2;
+
+	if (swap) {
+		optr |= FLASH_OPTR_BFB2;
+	}
+	flash_program_option_bytes(optr);
+}
+
 /**@}*/
 
@@ -98,6 +98,29 @@ unsigned fdcan_get_txbuf_element_size(uint32_t canport)
 	return 8 + fdcan_dlc_to_length((element_size & FDCAN_TXESC_TBDS_MASK) | 0x8);
 }
 
+/** Returns number of elements in receive FIFO.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @param [in] fifo_id ID of FIFO whose size is queried.
+ * @returns Number of elements configured for receive FIFO.
+ */
+unsigned fdcan_get_rxfifo_size(uint32_t canport, unsigned fifo_id)
+{
+	return (FDCAN_RXFIC(canport, fifo_id) >> FDCAN_RXFIC_FIS_SHIFT)
+		& FDCAN_RXFIC_FIS_MASK;
+}
+
+/** Returns number of elements in transmit queue/FIFO.
+ *
+ * @param [in] canport FDCAN block base address. See @ref fdcan_block.
+ * @returns Number of elements configured for transmit queue/FIFO.
+ */
+unsigned fdcan_get_txfifo_size(uint32_t canport)
+{
+	return (FDCAN_TXBC(canport) >> FDCAN_TXBC_TFQS_SHIFT)
+		& FDCAN_TXBC_TFQS_MASK;
+}
+
 /** Initialize allocation of standard filter block in CAN message RAM.
  *
  * Allows specifying size of standard filtering block (in term of available filtering
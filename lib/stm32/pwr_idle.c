@@ -0,0 +1,422 @@
+/** @defgroup pwr_idle_file Tickless idle
+
+@ingroup STM32F_files
+
+@brief <b>libopencm3 STM32 tickless low power idle manager</b>
+
+@version 1.0.0
+
+Replaces the periodic SysTick interrupt by a single wakeup while the
+application has nothing to do. pwr_idle_enter() is called from the idle loop
+with the number of ticks until the next deadline. Short idle periods are
+spent in sleep mode with the tick running. Longer ones stop the tick, arm a
+wakeup timer that keeps running in stop mode (an LPTIM or the RTC wakeup
+timer) and enter the deepest stop mode whose wakeup latency fits both the
+idle period and the limit set by the drivers. After the wakeup, by the timer
+or any other interrupt, the clocks are restored and the time measured by the
+wakeup timer, including the fraction of a tick that had elapsed before
+sleeping, is added to the tick count, so no time is lost. The same time is
+added to the timebase, see timebase_advance(), whose counter stops with the
+core clocks.
+
+The application counts ticks with pwr_idle_tick() from its SysTick handler
+and enables the wakeup timer interrupt, and for stop mode its EXTI line, in
+the NVIC. The handler only needs to clear the flags.
+
+Available where the PWR_CR stop mode bits of pwr_common_v1 exist: the LPTIM
+backend on F4 and L0, the RTC backend on F4, L0 and L1.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/scb.h>
+#include <libopencm3/cm3/systick.h>
+#include <libopencm3/cm3/timebase.h>
+#include <libopencm3/stm32/pwr.h>
+#include <libopencm3/stm32/rtc.h>
+#include <libopencm3/stm32/pwr_idle.h>
+#if defined(STM32F4) || defined(STM32L0)
+#include <libopencm3/stm32/lptimer.h>
+#endif
+
+/*---------------------------------------------------------------------------*/
+/** @brief Tickless Idle Init
+
+Set up the manager. The public fields must be set, with the backend ones
+filled in by pwr_idle_lptim_init() or pwr_idle_rtc_init() afterwards.
+
+@param[in] idle Idle manager
+*/
+
+void pwr_idle_init(struct pwr_idle *idle)
+{
+	int i;
+
+	idle->ticks = 0;
+	idle->residue = 0;
+	idle->latency_limit = UINT32_MAX;
+	idle->stop_inhibit = 0;
+	for (i = 0; i < 3; i++) {
+		idle->entries[i] = 0;
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Tickless Idle Tick
+
+Count a tick, to be called from the SysTick handler.
+
+@param[in] idle Idle manager
+*/
+
+void pwr_idle_tick(struct pwr_idle *idle)
+{
+	idle->ticks++;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Tickless Idle Get Ticks
+
+@param[in] idle Idle manager
+@returns Number of ticks since pwr_idle_init(), including the idle periods.
+*/
+
+uint32_t pwr_idle_ticks(struct pwr_idle *idle)
+{
+	return idle->ticks;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Tickless Idle Set Latency Limit
+
+Limit the wakeup latency, e.g. while a driver expects data that is not
+buffered by the hardware.
+
+@param[in] idle Idle manager
+@param[in] us Largest allowed latency in us, UINT32_MAX for no limit
+*/
+
+void pwr_idle_set_latency(struct pwr_idle *idle, uint32_t us)
+{
+	idle->latency_limit = us;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Tickless Idle Inhibit Stop
+
+Prevent stop mode, e.g. while a peripheral that stops with its clock is
+active. Calls nest and must be balanced by pwr_idle_stop_allow().
+
+@param[in] idle Idle manager
+*/
+
+void pwr_idle_stop_inhibit(struct pwr_idle *idle)
+{
+	CM_CRITICAL_CONTEXT();
+
+	idle->stop_inhibit++;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Tickless Idle Allow Stop
+
+@param[in] idle Idle manager
+*/
+
+void pwr_idle_stop_allow(struct pwr_idle *idle)
+{
+	CM_CRITICAL_CONTEXT();
+
+	idle->stop_inhibit--;
+}
+
+/* Deepest mode whose latency fits the idle time and the limit. */
+static uint8_t pwr_idle_select(struct pwr_idle *idle, uint32_t idle_ticks)
+{
+	uint64_t us = (uint64_t)idle_ticks * 1000000 / idle->tick_freq;
+
+	if (idle_ticks < 2 || idle->stop_inhibit || !idle->ops) {
+		return PWR_IDLE_SLEEP;
+	}
+	if (idle->stop_lp_latency < us &&
+	    idle->stop_lp_latency <= idle->latency_limit) {
+		return PWR_IDLE_STOP_LP;
+	}
+	if (idle->stop_latency < us &&
+	    idle->stop_latency <= idle->latency_limit) {
+		return PWR_IDLE_STOP;
+	}
+	return PWR_IDLE_SLEEP;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Tickless Idle Enter
+
+Idle until the given number of ticks has elapsed or an interrupt occurs.
+Must be called from thread mode with interrupts enabled. The interrupt that
+ends the idle period runs after the tick count has been updated.
+
+@param[in] idle Idle manager
+@param[in] idle_ticks Number of ticks until the next deadline
+@returns The mode entered, one of @ref pwr_idle_mode
+*/
+
+uint8_t pwr_idle_enter(struct pwr_idle *idle, uint32_t idle_ticks)
+{
+	uint32_t reload, value, latency, elapsed, ticks;
+	uint64_t counts, early, acc;
+	uint8_t mode;
+
+	cm_disable_interrupts();
+
+	mode = pwr_idle_select(idle, idle_ticks);
+	idle->entries[mode]++;
+	if (mode == PWR_IDLE_SLEEP) {
+		/* A pending interrupt wakes the core even while masked. */
+		__asm__ volatile("wfi");
+		cm_enable_interrupts();
+		return mode;
+	}
+
+	/* Wake up early by the latency, the tick then catches up. */
+	latency = (mode == PWR_IDLE_STOP_LP) ? idle->stop_lp_latency :
+		  idle->stop_latency;
+	counts = (uint64_t)idle_ticks * idle->timer_freq / idle->tick_freq;
+	early = (uint64_t)latency * idle->timer_freq / 1000000;
+	counts = (counts > early) ? counts - early : 1;
+	if (counts > idle->timer_max) {
+		counts = idle->timer_max;
+	}
+
+	/* Keep the part of the current tick that has already elapsed. */
+	systick_counter_disable();
+	reload = systick_get_reload();
+	value = systick_get_value();
+	acc = (uint64_t)(reload - value) * idle->timer_freq / (reload + 1);
+
+	idle->ops->start(idle->ctx, counts);
+
+	if (mode == PWR_IDLE_STOP_LP) {
+		pwr_voltage_regulator_low_power_in_stop();
+	} else {
+		pwr_voltage_regulator_on_in_stop();
+	}
+	pwr_set_stop_mode();
+	SCB_SCR |= SCB_SCR_SLEEPDEEP;
+	__asm__ volatile("wfi");
+	SCB_SCR &= ~SCB_SCR_SLEEPDEEP;
+
+	if (idle->restore) {
+		idle->restore();
+	}
+	elapsed = idle->ops->stop(idle->ctx);
+	timebase_advance((uint64_t)elapsed * timebase_frequency() /
+			 idle->timer_freq);
+
+	acc += (uint64_t)elapsed * idle->tick_freq + idle->residue;
+	ticks = acc / idle->timer_freq;
+	idle->residue = acc % idle->timer_freq;
+	idle->ticks += ticks;
+
+	systick_clear();
+	systick_counter_enable();
+
+	cm_enable_interrupts();
+	return mode;
+}
+
+#if defined(STM32F4) || defined(STM32L0)
+
+/* The counter runs on its own clock: read until two reads agree. */
+static uint16_t pwr_idle_lptim_read(struct pwr_idle_lptim *lp)
+{
+	uint16_t a, b;
+
+	b = lptimer_get_counter(lp->lptim);
+	do {
+		a = b;
+		b = lptimer_get_counter(lp->lptim);
+	} while (a != b);
+	return a;
+}
+
+static void pwr_idle_lptim_start(void *ctx, uint32_t counts)
+{
+	struct pwr_idle_lptim *lp = ctx;
+
+	lp->start = pwr_idle_lptim_read(lp);
+	lptimer_clear_flag(lp->lptim, LPTIM_ICR_CMPOKCF | LPTIM_ICR_CMPMCF);
+	lptimer_set_compare(lp->lptim, lp->start + counts);
+	while (!lptimer_get_flag(lp->lptim, LPTIM_ISR_CMPOK));
+}
+
+static uint32_t pwr_idle_lptim_stop(void *ctx)
+{
+	struct pwr_idle_lptim *lp = ctx;
+
+	lptimer_clear_flag(lp->lptim, LPTIM_ICR_CMPMCF);
+	return (uint16_t)(pwr_idle_lptim_read(lp) - lp->start);
+}
+
+static const struct pwr_idle_ops pwr_idle_lptim_ops = {
+	.start = pwr_idle_lptim_start,
+	.stop = pwr_idle_lptim_stop,
+};
+
+/*---------------------------------------------------------------------------*/
+/** @brief Tickless Idle Use LPTIM
+
+Use an LPTIM as wakeup timer. Its kernel clock (LSE or LSI, to run in stop
+mode) and prescaler must be set up and the timer disabled. It is started
+here as a free running counter and the compare match interrupt is enabled;
+the match also occurs once per counter period while not idling, so the
+handler must clear the flag.
+
+@param[in] idle Idle manager
+@param[out] lp LPTIM state
+@param[in] lptim LPTIM base address
+@param[in] freq Counter frequency in Hz
+*/
+
+void pwr_idle_lptim_init(struct pwr_idle *idle, struct pwr_idle_lptim *lp,
+			 uint32_t lptim, uint32_t freq)
+{
+	lp->lptim = lptim;
+	lp->start = 0;
+
+	/* IER can only be written while disabled, ARR only while enabled. */
+	lptimer_enable_irq(lptim, LPTIM_IER_CMPMIE);
+	lptimer_enable(lptim);
+	lptimer_set_period(lptim, 0xffff);
+	lptimer_start_counter(lptim, LPTIM_CR_CNTSTRT);
+
+	idle->ops = &pwr_idle_lptim_ops;
+	idle->ctx = lp;
+	idle->timer_freq = freq;
+	/* Leave room to tell a full period from none. */
+	idle->timer_max = 0xff00;
+}
+
+#endif
+
+/* Counts since midnight: the sub-second counter runs down. Reading RTC_SSR
+ * freezes the shadow registers until RTC_DR is read. */
+static uint32_t pwr_idle_rtc_stamp(struct pwr_idle_rtc *rtc)
+{
+	uint32_t ssr = RTC_SSR;
+	uint32_t tr = RTC_TR;
+	uint32_t secs;
+
+	(void)RTC_DR;
+	secs = ((tr >> RTC_TR_HT_SHIFT) & RTC_TR_HT_MASK) * 36000 +
+	       ((tr >> RTC_TR_HU_SHIFT) & RTC_TR_HU_MASK) * 3600 +
+	       ((tr >> RTC_TR_MNT_SHIFT) & RTC_TR_MNT_MASK) * 600 +
+	       ((tr >> RTC_TR_MNU_SHIFT) & RTC_TR_MNU_MASK) * 60 +
+	       ((tr >> RTC_TR_ST_SHIFT) & RTC_TR_ST_MASK) * 10 +
+	       ((tr >> RTC_TR_SU_SHIFT) & RTC_TR_SU_MASK);
+	return secs * rtc->sync + (rtc->sync - 1 - ssr);
+}
+
+static void pwr_idle_rtc_start(void *ctx, uint32_t counts)
+{
+	struct pwr_idle_rtc *rtc = ctx;
+
+	rtc->start = pwr_idle_rtc_stamp(rtc);
+	rtc_unlock();
+	rtc_set_wakeup_time(counts * rtc->wut_per_count - 1, rtc->wucksel);
+	rtc_clear_wakeup_flag();
+	RTC_CR |= RTC_CR_WUTIE;
+	rtc_lock();
+}
+
+static uint32_t pwr_idle_rtc_stop(void *ctx)
+{
+	struct pwr_idle_rtc *rtc = ctx;
+	uint32_t day = 86400 * rtc->sync;
+
+	rtc_unlock();
+	RTC_CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+	rtc_clear_wakeup_flag();
+	rtc_lock();
+
+	/* The shadow registers are stale after stop mode. */
+	rtc_wait_for_synchro();
+	return (pwr_idle_rtc_stamp(rtc) + day - rtc->start) % day;
+}
+
+static const struct pwr_idle_ops pwr_idle_rtc_ops = {
+	.start = pwr_idle_rtc_start,
+	.stop = pwr_idle_rtc_stop,
+};
+
+/*---------------------------------------------------------------------------*/
+/** @brief Tickless Idle Use RTC
+
+Use the RTC wakeup timer, with the time measured by the calendar and its
+sub-second counter. The RTC must be running in 24 hour format and the backup
+domain write protection disabled. The wakeup timer runs from RTCCLK divided
+by up to 16, so the asynchronous prescaler + 1 should be a multiple of 16,
+as with the usual 127.
+
+@param[in] idle Idle manager
+@param[out] rtc RTC state
+@param[in] rtcclk RTC clock frequency in Hz (32768 for the LSE)
+*/
+
+void pwr_idle_rtc_init(struct pwr_idle *idle, struct pwr_idle_rtc *rtc,
+		       uint32_t rtcclk)
+{
+	uint32_t async = ((RTC_PRER >> RTC_PRER_PREDIV_A_SHIFT) &
+			  RTC_PRER_PREDIV_A_MASK) + 1;
+	uint32_t div = 16;
+
+	while (async % div) {
+		div /= 2;
+	}
+	switch (div) {
+	case 16:
+		rtc->wucksel = RTC_CR_WUCLKSEL_RTC_DIV16;
+		break;
+	case 8:
+		rtc->wucksel = RTC_CR_WUCLKSEL_RTC_DIV8;
+		break;
+	case 4:
+		rtc->wucksel = RTC_CR_WUCLKSEL_RTC_DIV4;
+		break;
+	default:
+		/* Odd prescalers are not supported, use 2. */
+		div = 2;
+		rtc->wucksel = RTC_CR_WUCLKSEL_RTC_DIV2;
+		break;
+	}
+	rtc->wut_per_count = async / div;
+	rtc->sync = ((RTC_PRER >> RTC_PRER_PREDIV_S_SHIFT) &
+		     RTC_PRER_PREDIV_S_MASK) + 1;
+
+	idle->ops = &pwr_idle_rtc_ops;
+	idle->ctx = rtc;
+	idle->timer_freq = rtcclk / async;
+	idle->timer_max = 0x10000 / rtc->wut_per_count;
+}
+
+/**@}*/
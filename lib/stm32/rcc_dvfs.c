@@ -0,0 +1,261 @@
+/** @defgroup rcc_dvfs_file Clock switching
+
+@ingroup STM32F_files
+
+@brief <b>libopencm3 STM32 runtime clock switching service</b>
+
+@version 1.0.0
+
+Changes the system clock at runtime, e.g. to drop to a low frequency while
+idle and boost under load. Peripheral dividers computed from the old bus
+frequencies, such as the USART baud rate, the SysTick reload and the I2C
+timings, would be stale afterwards, so drivers register a notifier that is
+called before the change, to finish or hold transfers, and after it, to
+recompute their dividers from rcc_ahb_frequency, rcc_apb1_frequency and
+rcc_apb2_frequency.
+
+rcc_dvfs_switch() runs the sequence of rcc_clock_setup_pll(): SYSCLK moves to
+the HSI, where any flash latency is valid, while the PLL is off the voltage
+scale is changed, the PLL is restarted and the latency for the new frequency
+is set before SYSCLK moves back to it. Every step is valid for the clock
+running at that time, so interrupts are not masked: handlers keep running,
+from the HSI while the PLL and the regulator settle, for up to a few hundred
+microseconds, longer if the HSE has to start. rcc_ahb_frequency and the APB
+frequencies keep the old values until the end, which is why the notifiers
+hold the drivers that depend on them. The configuration typically comes from
+rcc_clock_scale_solve().
+
+Ready made notifiers keep a USART baud rate, the SysTick rate, an I2C bus
+speed and the timebase. The time counted by the timebase while the switch
+runs from the HSI is off by the ratio of the clocks.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/cm3/systick.h>
+#include <libopencm3/cm3/timebase.h>
+#include <libopencm3/stm32/usart.h>
+#include <libopencm3/stm32/rcc_dvfs.h>
+
+static struct rcc_dvfs_notifier *rcc_dvfs_head;
+
+static void rcc_dvfs_notify(uint8_t event)
+{
+	struct rcc_dvfs_notifier *nb;
+
+	for (nb = rcc_dvfs_head; nb; nb = nb->next) {
+		nb->callback(nb, event);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Clock Switching Register Notifier
+
+@param[in] nb Notifier, with its callback set
+*/
+
+void rcc_dvfs_register(struct rcc_dvfs_notifier *nb)
+{
+	CM_CRITICAL_CONTEXT();
+
+	nb->next = rcc_dvfs_head;
+	rcc_dvfs_head = nb;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Clock Switching Unregister Notifier
+
+@param[in] nb Notifier
+*/
+
+void rcc_dvfs_unregister(struct rcc_dvfs_notifier *nb)
+{
+	struct rcc_dvfs_notifier **p;
+	CM_CRITICAL_CONTEXT();
+
+	for (p = &rcc_dvfs_head; *p; p = &(*p)->next) {
+		if (*p == nb) {
+			*p = nb->next;
+			break;
+		}
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Clock Switching Switch
+
+Change the clocks, calling the notifiers before and after. Must not be called
+from a notifier or an interrupt handler.
+
+@param[in] clock New clock configuration
+*/
+
+void rcc_dvfs_switch(const struct rcc_clock_scale *clock)
+{
+	rcc_dvfs_notify(RCC_DVFS_PRE);
+	rcc_clock_setup_pll(clock);
+	rcc_dvfs_notify(RCC_DVFS_POST);
+}
+
+static void rcc_dvfs_usart_callback(struct rcc_dvfs_notifier *nb,
+				    uint8_t event)
+{
+	struct rcc_dvfs_usart *n = (struct rcc_dvfs_usart *)nb;
+
+	if (event == RCC_DVFS_PRE) {
+		/* Let the last frame leave at the old rate. */
+		while (!usart_get_flag(n->usart, USART_FLAG_TC)) {
+			;
+		}
+	} else {
+		usart_set_baudrate(n->usart, n->baud);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Clock Switching Keep USART Baud Rate
+
+Register a notifier that drains the transmitter before a clock change and
+sets the baud rate again after it.
+
+@param[out] n Notifier
+@param[in] usart USART base address
+@param[in] baud Baud rate
+*/
+
+void rcc_dvfs_usart_register(struct rcc_dvfs_usart *n, uint32_t usart,
+			     uint32_t baud)
+{
+	n->nb.callback = rcc_dvfs_usart_callback;
+	n->usart = usart;
+	n->baud = baud;
+	rcc_dvfs_register(&n->nb);
+}
+
+static void rcc_dvfs_systick_callback(struct rcc_dvfs_notifier *nb,
+				      uint8_t event)
+{
+	struct rcc_dvfs_systick *n = (struct rcc_dvfs_systick *)nb;
+
+	if (event == RCC_DVFS_POST) {
+		systick_set_frequency(n->freq, rcc_ahb_frequency);
+		systick_clear();
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Clock Switching Keep SysTick Rate
+
+Register a notifier that recomputes the SysTick reload value after a clock
+change.
+
+@param[out] n Notifier
+@param[in] freq Interrupt frequency in Hz
+*/
+
+void rcc_dvfs_systick_register(struct rcc_dvfs_systick *n, uint32_t freq)
+{
+	n->nb.callback = rcc_dvfs_systick_callback;
+	n->freq = freq;
+	rcc_dvfs_register(&n->nb);
+}
+
+static void rcc_dvfs_i2c_callback(struct rcc_dvfs_notifier *nb,
+				  uint8_t event)
+{
+	struct rcc_dvfs_i2c *n = (struct rcc_dvfs_i2c *)nb;
+
+	if (event == RCC_DVFS_PRE) {
+		/* Wait for the bus to be released. */
+		while (I2C_SR2(n->i2c) & I2C_SR2_BUSY) {
+			;
+		}
+		return;
+	}
+
+	/* The timings can only be changed while the peripheral is off. */
+	i2c_peripheral_disable(n->i2c);
+	i2c_set_speed(n->i2c, n->speed, rcc_apb1_frequency / 1000000);
+	i2c_peripheral_enable(n->i2c);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Clock Switching Keep I2C Speed
+
+Register a notifier that waits for the bus to be free before a clock change
+and recomputes the I2C timings from the APB1 frequency after it.
+
+@param[out] n Notifier
+@param[in] i2c I2C base address
+@param[in] speed Bus speed
+*/
+
+void rcc_dvfs_i2c_register(struct rcc_dvfs_i2c *n, uint32_t i2c,
+			   enum i2c_speeds speed)
+{
+	n->nb.callback = rcc_dvfs_i2c_callback;
+	n->i2c = i2c;
+	n->speed = speed;
+	rcc_dvfs_register(&n->nb);
+}
+
+static void rcc_dvfs_timebase_callback(struct rcc_dvfs_notifier *nb,
+				       uint8_t event)
+{
+	struct rcc_dvfs_timebase *n = (struct rcc_dvfs_timebase *)nb;
+	uint32_t freq = rcc_ahb_frequency;
+
+	if (event != RCC_DVFS_POST) {
+		return;
+	}
+	if (n->tick_freq) {
+		systick_set_frequency(n->tick_freq, rcc_ahb_frequency);
+		if (!(STK_CSR & STK_CSR_CLKSOURCE)) {
+			freq /= 8;
+		}
+	}
+	timebase_set_frequency(freq);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief Clock Switching Keep Timebase
+
+Register a notifier that gives the new counter frequency to the timebase
+after a clock change, so the time stays continuous. For a timebase on the
+cycle counter pass 0. For a timebase on SysTick pass the interrupt frequency
+instead of registering rcc_dvfs_systick_register(): the reload value is
+recomputed and the current period counted at the old rate.
+
+@param[out] n Notifier
+@param[in] tick_freq SysTick interrupt frequency in Hz, or 0
+*/
+
+void rcc_dvfs_timebase_register(struct rcc_dvfs_timebase *n,
+				uint32_t tick_freq)
+{
+	n->nb.callback = rcc_dvfs_timebase_callback;
+	n->tick_freq = tick_freq;
+	rcc_dvfs_register(&n->nb);
+}
+
+/**@}*/
@@ -0,0 +1,275 @@
+/** @defgroup spi_dma_file SPI DMA transfer engine
+
+@ingroup STM32F_files
+
+@brief <b>libopencm3 STM32 SPI DMA transfer engine</b>
+
+@version 1.0.0
+
+Transactions are queued with spi_dma_submit() and executed back to back in
+master mode. Each transaction asserts its chip select, runs a full duplex
+transfer and releases the chip select again before its completion callback
+is called and the next transaction is started from the receive DMA interrupt.
+
+Short transactions are cheaper to run with the polled spi_transfer(), which
+packs two frames per data register access on the SPI with FIFO, than to set
+up two DMA channels for. The limit is set by spi_dma::dma_threshold.
+
+Both DMA streams/channels are claimed from the @ref dma_mgr_defines "DMA
+manager". The SPI must be configured for 8 bit frames in master mode and
+enabled by the application. Both DMA stream/channel interrupts must be enabled
+in the NVIC and call dma_mgr_irq(). The chip select pins must be configured as
+outputs and driven high.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <stddef.h>
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/stm32/gpio.h>
+#include <libopencm3/stm32/spi_dma.h>
+
+/* Sink for discarded receive data and source for idle transmit data. */
+static uint8_t spi_dma_dummy_rx;
+static uint8_t spi_dma_dummy_tx = 0xff;
+
+static void spi_dma_kick(struct spi_dma *sd, struct spi_dma_xfer *xfer)
+{
+	dma_xfer_stop(sd->dma, sd->rx_channel);
+	dma_xfer_stop(sd->dma, sd->tx_channel);
+	dma_xfer_set_minc(sd->dma, sd->rx_channel, xfer->rx != NULL);
+	dma_xfer_set_minc(sd->dma, sd->tx_channel, xfer->tx != NULL);
+
+	/* Receive first, so no frame can be missed. */
+	dma_xfer_restart(sd->dma, sd->rx_channel,
+			 (uint32_t)(xfer->rx ? xfer->rx : &spi_dma_dummy_rx),
+			 xfer->len);
+	dma_xfer_restart(sd->dma, sd->tx_channel,
+			 (uint32_t)(xfer->tx ? xfer->tx : &spi_dma_dummy_tx),
+			 xfer->len);
+}
+
+/* Finish the transaction at the head of the queue. */
+static void spi_dma_done(struct spi_dma *sd, int status)
+{
+	struct spi_dma_xfer *xfer = sd->head;
+
+	if (xfer->cs_port) {
+		gpio_set(xfer->cs_port, xfer->cs_pin);
+	}
+
+	CM_CRITICAL_BLOCK() {
+		sd->head = xfer->next;
+		if (sd->head == NULL) {
+			sd->tail = NULL;
+		}
+	}
+
+	xfer->status = status;
+	if (xfer->callback) {
+		xfer->callback(sd, xfer);
+	}
+}
+
+/* Transaction to run next, or NULL after marking the engine idle. */
+static struct spi_dma_xfer *spi_dma_next(struct spi_dma *sd)
+{
+	CM_CRITICAL_CONTEXT();
+
+	if (sd->head == NULL) {
+		sd->busy = false;
+	}
+	return sd->head;
+}
+
+/*
+ * Start the next DMA transaction, running short ones to completion. Only
+ * the context that set sd->busy runs the queue, outside the critical
+ * section: submissions meanwhile are only linked.
+ */
+static void spi_dma_run(struct spi_dma *sd)
+{
+	struct spi_dma_xfer *xfer;
+
+	while ((xfer = spi_dma_next(sd)) != NULL) {
+		if (xfer->cs_port) {
+			gpio_clear(xfer->cs_port, xfer->cs_pin);
+		}
+		if (xfer->len >= sd->dma_threshold && xfer->len > 0) {
+			spi_dma_kick(sd, xfer);
+			return;
+		}
+		spi_transfer(sd->spi, xfer->tx, xfer->rx, xfer->len);
+		spi_dma_done(sd, 0);
+	}
+}
+
+/*
+ * DMA manager callback of both streams/channels: completes the current
+ * transaction and starts the next one. Completion is signalled by the
+ * receive side, errors by either.
+ */
+static void spi_dma_event(uint32_t dma, uint8_t channel, uint32_t flags,
+			  void *arg)
+{
+	struct spi_dma *sd = arg;
+	int status = 0;
+
+	(void)dma;
+	if (!sd->busy) {
+		return;
+	}
+
+	if (flags & DMA_TEIF) {
+		sd->dma_errors++;
+		dma_xfer_stop(sd->dma, sd->rx_channel);
+		dma_xfer_stop(sd->dma, sd->tx_channel);
+		status = -1;
+	} else if (channel != sd->rx_channel || !(flags & DMA_TCIF)) {
+		return;
+	}
+
+	spi_dma_done(sd, status);
+	spi_dma_run(sd);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief SPI DMA Initialise Transfer Engine
+
+Claim both DMA streams/channels, configure them for byte transfers between
+memory and the SPI data register and enable the SPI DMA requests. The queue is
+emptied.
+
+@param[in] sd Engine, the configuration members must be filled in.
+@returns DMA_MGR_E_OK, or the error of dma_mgr_claim().
+*/
+
+int spi_dma_init(struct spi_dma *sd)
+{
+	const struct dma_xfer_config rx_cfg = {
+		.dma = sd->dma,
+		.channel = sd->rx_channel,
+		.request = sd->rx_request,
+		.dir = DMA_XFER_PERIPH_TO_MEM,
+		.paddr = (uint32_t)&SPI_DR(sd->spi),
+		.psize = 1,
+		.msize = 1,
+		.minc = true,
+		.priority = DMA_XFER_PRIORITY_HIGH,
+		.irq = DMA_XFER_IRQ_TC | DMA_XFER_IRQ_TE,
+	};
+	const struct dma_xfer_config tx_cfg = {
+		.dma = sd->dma,
+		.channel = sd->tx_channel,
+		.request = sd->tx_request,
+		.dir = DMA_XFER_MEM_TO_PERIPH,
+		.paddr = (uint32_t)&SPI_DR(sd->spi),
+		.psize = 1,
+		.msize = 1,
+		.minc = true,
+		.priority = DMA_XFER_PRIORITY_HIGH,
+		.irq = DMA_XFER_IRQ_TE,
+	};
+	struct dma_xfer xfer;
+	int ret;
+
+	ret = dma_mgr_claim(sd->dma, sd->rx_channel, sd);
+	if (ret != DMA_MGR_E_OK) {
+		return ret;
+	}
+	ret = dma_mgr_claim(sd->dma, sd->tx_channel, sd);
+	if (ret != DMA_MGR_E_OK) {
+		dma_mgr_release(sd->dma, sd->rx_channel, sd);
+		return ret;
+	}
+
+	sd->head = NULL;
+	sd->tail = NULL;
+	sd->busy = false;
+	sd->dma_errors = 0;
+
+	dma_xfer_prepare(&xfer, &rx_cfg);
+	dma_xfer_commit(&xfer);
+	dma_xfer_prepare(&xfer, &tx_cfg);
+	dma_xfer_commit(&xfer);
+	dma_mgr_set_callback(sd->dma, sd->rx_channel, spi_dma_event, sd);
+	dma_mgr_set_callback(sd->dma, sd->tx_channel, spi_dma_event, sd);
+
+#ifdef SPI_CR2_FRXTH
+	/* RXNE and thus the receive DMA request for every byte. */
+	spi_fifo_reception_threshold_8bit(sd->spi);
+#endif
+	spi_enable_rx_dma(sd->spi);
+	spi_enable_tx_dma(sd->spi);
+	return DMA_MGR_E_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief SPI DMA Submit Transaction
+
+Append a transaction to the queue. If the engine is idle the transaction is
+started immediately; transactions below the DMA threshold complete before
+this function returns. May be called from interrupt context, including
+completion callbacks.
+
+@param[in] sd Engine
+@param[in] xfer Transaction, owned by the caller until its callback has run.
+*/
+
+void spi_dma_submit(struct spi_dma *sd, struct spi_dma_xfer *xfer)
+{
+	bool start = false;
+
+	xfer->next = NULL;
+	xfer->status = 0;
+
+	CM_CRITICAL_BLOCK() {
+		if (sd->tail) {
+			sd->tail->next = xfer;
+		} else {
+			sd->head = xfer;
+		}
+		sd->tail = xfer;
+
+		if (!sd->busy) {
+			sd->busy = true;
+			start = true;
+		}
+	}
+
+	if (start) {
+		spi_dma_run(sd);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief SPI DMA Engine Busy
+
+@param[in] sd Engine
+@returns true while transactions are queued or in progress.
+*/
+
+bool spi_dma_busy(struct spi_dma *sd)
+{
+	return sd->busy;
+}
+
+/**@}*/
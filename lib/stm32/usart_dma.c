@@ -0,0 +1,456 @@
+/** @defgroup usart_dma_file USART DMA streaming
+
+@ingroup STM32F_files
+
+@brief <b>libopencm3 STM32 USART DMA streaming layer</b>
+
+@version 1.0.0
+
+Reception runs continuously into a circular DMA buffer. The idle line
+interrupt of the USART and the half/full transfer interrupts of the DMA are
+used to hand the application contiguous spans of the ring buffer without
+copying them. A span that wraps around the end of the buffer is delivered as
+two calls.
+
+Transmission takes a queue of buffers. Each buffer is sent by one DMA
+transfer and the next one is started from the transfer complete interrupt.
+The transmit data register and the shift register of the USART hold two
+characters at that point, so the line stays busy as long as the interrupt is
+serviced within one character time.
+
+The DMA streams/channels are claimed from the @ref dma_mgr_defines "DMA
+manager", which dispatches their events. The USART must be configured and
+enabled by the application, its interrupt must be enabled in the NVIC and
+call usart_dma_rx_irq(), and the DMA stream/channel interrupts must be
+enabled and call dma_mgr_irq(). On parts with a data cache the buffers must
+be placed in non-cacheable memory.
+
+LGPL License Terms @ref lgpl_license
+*/
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**@{*/
+
+#include <libopencm3/cm3/cortex.h>
+#include <libopencm3/stm32/usart_dma.h>
+#include <libopencm3/stm32/dma_mgr.h>
+
+#ifdef USART_ICR
+#define USART_DMA_RDR(usart)		USART_RDR(usart)
+#define USART_DMA_TDR(usart)		USART_TDR(usart)
+#define USART_DMA_LINE_FLAGS		(USART_ISR_IDLE | USART_ISR_ORE | \
+					 USART_ISR_NF | USART_ISR_FE)
+#else
+#define USART_DMA_RDR(usart)		USART_DR(usart)
+#define USART_DMA_TDR(usart)		USART_DR(usart)
+#define USART_DMA_LINE_FLAGS		(USART_SR_IDLE | USART_SR_ORE | \
+					 USART_SR_NE | USART_SR_FE)
+#endif
+
+/* Read and acknowledge the idle line and receive error flags. */
+static uint32_t usart_dma_ack_line(uint32_t usart)
+{
+#ifdef USART_ICR
+	uint32_t flags = USART_ISR(usart) & USART_DMA_LINE_FLAGS;
+
+	/* The ICR clear bits have the same positions as the ISR flags. */
+	USART_ICR(usart) = flags;
+#else
+	uint32_t flags = USART_SR(usart) & USART_DMA_LINE_FLAGS;
+
+	/* Flags are cleared by reading SR followed by DR. */
+	if (flags) {
+		(void)USART_DR(usart);
+	}
+#endif
+	return flags;
+}
+
+/* Current DMA write position in the ring buffer. */
+static uint16_t usart_dma_rx_head(struct usart_dma_rx *rx)
+{
+	uint16_t head = rx->size - dma_get_number_of_data(rx->dma, rx->channel);
+
+	return (head >= rx->size) ? 0 : head;
+}
+
+/* Hand everything received since the previous span to the callback. */
+static void usart_dma_rx_span(struct usart_dma_rx *rx, uint32_t events)
+{
+	uint16_t head = usart_dma_rx_head(rx);
+	uint16_t tail = rx->tail;
+
+	if (head < tail) {
+		/* Only the last span of a frame carries the idle event. */
+		rx->tail = 0;
+		rx->callback(rx, &rx->buf[tail], rx->size - tail,
+			     head ? (events & ~USART_DMA_RX_EVENT_IDLE) : events);
+		tail = 0;
+	}
+	if (head > tail) {
+		rx->tail = head;
+		rx->callback(rx, &rx->buf[tail], head - tail, events);
+	}
+}
+
+/* Pending events to deliver, or 0 after marking the delivery finished. */
+static uint32_t usart_dma_rx_next(struct usart_dma_rx *rx)
+{
+	uint32_t events;
+
+	CM_CRITICAL_CONTEXT();
+
+	events = rx->pending;
+	rx->pending = 0;
+	if (!events) {
+		rx->delivering = false;
+	}
+	return events;
+}
+
+/*
+ * The USART and the DMA interrupt both deliver, and may preempt each other.
+ * Only the context that set rx->delivering moves the tail and runs the
+ * callback, outside the critical section; the other one only adds its events,
+ * so spans are delivered once and in order.
+ */
+static void usart_dma_rx_deliver(struct usart_dma_rx *rx, uint32_t events)
+{
+	bool run = false;
+
+	CM_CRITICAL_BLOCK() {
+		rx->pending |= events;
+		if (!rx->delivering) {
+			rx->delivering = true;
+			run = true;
+		}
+	}
+
+	if (run) {
+		while ((events = usart_dma_rx_next(rx)) != 0) {
+			usart_dma_rx_span(rx, events);
+		}
+	}
+}
+
+static void usart_dma_rx_events(struct usart_dma_rx *rx, uint32_t line,
+				uint32_t flags)
+{
+	uint32_t events = 0;
+
+	if (line & USART_FLAG_ORE) {
+		rx->overruns++;
+	}
+	if (line & USART_FLAG_IDLE) {
+		rx->frames++;
+		events |= USART_DMA_RX_EVENT_IDLE;
+	}
+	if (flags & DMA_HTIF) {
+		events |= USART_DMA_RX_EVENT_HALF;
+	}
+	if (flags & DMA_TCIF) {
+		events |= USART_DMA_RX_EVENT_FULL;
+	}
+	if (flags & DMA_TEIF) {
+		rx->dma_errors++;
+	}
+
+	if (events && rx->callback) {
+		usart_dma_rx_deliver(rx, events);
+	}
+}
+
+/* DMA manager callback of the receive stream/channel. */
+static void usart_dma_rx_dma(uint32_t dma, uint8_t channel, uint32_t flags,
+			     void *arg)
+{
+	(void)dma;
+	(void)channel;
+	usart_dma_rx_events(arg, 0, flags);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief USART DMA Start Reception
+
+Claim the DMA stream/channel, configure it for circular peripheral to memory
+transfers into the ring buffer and enable the USART receive DMA request
+together with the idle line and error interrupts. Statistics are reset.
+
+@param[in] rx Receiver, the configuration members must be filled in.
+@returns DMA_MGR_E_OK, or the error of dma_mgr_claim().
+*/
+
+int usart_dma_rx_start(struct usart_dma_rx *rx)
+{
+	const struct dma_xfer_config cfg = {
+		.dma = rx->dma,
+		.channel = rx->channel,
+		.request = rx->request,
+		.dir = DMA_XFER_PERIPH_TO_MEM,
+		.paddr = (uint32_t)&USART_DMA_RDR(rx->usart),
+		.maddr = (uint32_t)rx->buf,
+		.count = rx->size,
+		.psize = 1,
+		.msize = 1,
+		.minc = true,
+		.circular = true,
+		.priority = DMA_XFER_PRIORITY_HIGH,
+		.irq = DMA_XFER_IRQ_TC | DMA_XFER_IRQ_HT | DMA_XFER_IRQ_TE,
+	};
+	struct dma_xfer xfer;
+	int ret = dma_mgr_claim(rx->dma, rx->channel, rx);
+
+	if (ret != DMA_MGR_E_OK) {
+		return ret;
+	}
+	dma_mgr_set_callback(rx->dma, rx->channel, usart_dma_rx_dma, rx);
+
+	rx->tail = 0;
+	rx->pending = 0;
+	rx->delivering = false;
+	rx->frames = 0;
+	rx->overruns = 0;
+	rx->dma_errors = 0;
+
+	dma_xfer_prepare(&xfer, &cfg);
+	usart_dma_ack_line(rx->usart);
+	dma_xfer_start(&xfer);
+
+	usart_enable_rx_dma(rx->usart);
+	usart_enable_idle_interrupt(rx->usart);
+	usart_enable_error_interrupt(rx->usart);
+	return DMA_MGR_E_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief USART DMA Stop Reception
+
+Data that was received but not yet delivered or consumed is discarded. The
+DMA stream/channel is released.
+
+@param[in] rx Receiver
+*/
+
+void usart_dma_rx_stop(struct usart_dma_rx *rx)
+{
+	usart_disable_idle_interrupt(rx->usart);
+	usart_disable_error_interrupt(rx->usart);
+	usart_disable_rx_dma(rx->usart);
+	dma_mgr_release(rx->dma, rx->channel, rx);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief USART DMA Receive Interrupt Handler
+
+Must be called from the USART interrupt. Acknowledges the idle line and error
+flags and, if a callback is registered, delivers all data received since the
+previous event.
+
+@param[in] rx Receiver
+*/
+
+void usart_dma_rx_irq(struct usart_dma_rx *rx)
+{
+	usart_dma_rx_events(rx, usart_dma_ack_line(rx->usart), 0);
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief USART DMA Peek at Received Data
+
+Used when no callback is registered. Returns the longest contiguous span of
+received data that has not been consumed yet. Call again after
+usart_dma_rx_consume() to get the part that wrapped around the end of the
+ring buffer.
+
+@param[in] rx Receiver
+@param[out] data Set to the start of the span inside the ring buffer.
+@returns Number of bytes available at @p data.
+*/
+
+uint16_t usart_dma_rx_peek(struct usart_dma_rx *rx, const uint8_t **data)
+{
+	uint16_t head = usart_dma_rx_head(rx);
+
+	*data = &rx->buf[rx->tail];
+	if (head >= rx->tail) {
+		return head - rx->tail;
+	}
+	return rx->size - rx->tail;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief USART DMA Consume Received Data
+
+@param[in] rx Receiver
+@param[in] len Number of bytes to release, at most the value returned by
+usart_dma_rx_peek().
+*/
+
+void usart_dma_rx_consume(struct usart_dma_rx *rx, uint16_t len)
+{
+	uint16_t tail = rx->tail + len;
+
+	if (tail >= rx->size) {
+		tail -= rx->size;
+	}
+	rx->tail = tail;
+}
+
+static void usart_dma_tx_kick(struct usart_dma_tx *tx)
+{
+	const struct usart_dma_tx_buf *buf = &tx->queue[tx->head];
+
+	dma_xfer_restart(tx->dma, tx->channel, (uint32_t)buf->data, buf->len);
+}
+
+/*
+ * DMA manager callback of the transmit stream/channel: start the next queued
+ * buffer before running the completion callback of the finished one.
+ */
+static void usart_dma_tx_dma(uint32_t dma, uint8_t channel, uint32_t flags,
+			     void *arg)
+{
+	struct usart_dma_tx *tx = arg;
+	struct usart_dma_tx_buf done;
+
+	(void)dma;
+	(void)channel;
+	if (flags & DMA_TEIF) {
+		tx->dma_errors++;
+	}
+	if (!(flags & (DMA_TCIF | DMA_TEIF)) || tx->count == 0) {
+		return;
+	}
+
+	/* Writers of any priority append relative to head and count. */
+	CM_CRITICAL_BLOCK() {
+		done = tx->queue[tx->head];
+		if (++tx->head == tx->queue_len) {
+			tx->head = 0;
+		}
+		if (--tx->count) {
+			usart_dma_tx_kick(tx);
+		}
+	}
+
+	if (done.callback) {
+		done.callback(tx, done.data, done.len);
+	}
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief USART DMA Initialise Transmit Queue
+
+Claim the DMA stream/channel, configure it for memory to peripheral transfers
+and enable the USART transmit DMA request. The queue is emptied.
+
+@param[in] tx Transmitter, the configuration members must be filled in.
+@returns DMA_MGR_E_OK, or the error of dma_mgr_claim().
+*/
+
+int usart_dma_tx_init(struct usart_dma_tx *tx)
+{
+	const struct dma_xfer_config cfg = {
+		.dma = tx->dma,
+		.channel = tx->channel,
+		.request = tx->request,
+		.dir = DMA_XFER_MEM_TO_PERIPH,
+		.paddr = (uint32_t)&USART_DMA_TDR(tx->usart),
+		.psize = 1,
+		.msize = 1,
+		.minc = true,
+		.priority = DMA_XFER_PRIORITY_HIGH,
+		.irq = DMA_XFER_IRQ_TC | DMA_XFER_IRQ_TE,
+	};
+	struct dma_xfer xfer;
+	int ret = dma_mgr_claim(tx->dma, tx->channel, tx);
+
+	if (ret != DMA_MGR_E_OK) {
+		return ret;
+	}
+	dma_mgr_set_callback(tx->dma, tx->channel, usart_dma_tx_dma, tx);
+
+	tx->head = 0;
+	tx->count = 0;
+	tx->dma_errors = 0;
+
+	dma_xfer_prepare(&xfer, &cfg);
+	dma_xfer_commit(&xfer);
+	usart_enable_tx_dma(tx->usart);
+	return DMA_MGR_E_OK;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief USART DMA Queue Buffer for Transmission
+
+The buffer is not copied and must stay valid until its callback has been
+called. If the queue was idle the transfer starts immediately. May be called
+from interrupt context.
+
+@param[in] tx Transmitter
+@param[in] data Buffer to send, must be accessible by the DMA controller.
+@param[in] len Number of bytes to send, must not be zero.
+@param[in] callback Called from the DMA interrupt once the buffer has been
+handed to the USART, or NULL.
+@returns true if the buffer was queued, false if the queue is full.
+*/
+
+bool usart_dma_tx_write(struct usart_dma_tx *tx, const uint8_t *data,
+			uint16_t len, usart_dma_tx_callback callback)
+{
+	uint8_t slot;
+
+	if (len == 0) {
+		return false;
+	}
+
+	CM_CRITICAL_CONTEXT();
+
+	if (tx->count == tx->queue_len) {
+		return false;
+	}
+
+	slot = tx->head + tx->count;
+	if (slot >= tx->queue_len) {
+		slot -= tx->queue_len;
+	}
+	tx->queue[slot].data = data;
+	tx->queue[slot].len = len;
+	tx->queue[slot].callback = callback;
+
+	if (tx->count++ == 0) {
+		usart_dma_tx_kick(tx);
+	}
+	return true;
+}
+
+/*---------------------------------------------------------------------------*/
+/** @brief USART DMA Transmit Queue Busy
+
+@param[in] tx Transmitter
+@returns true while buffers are queued or being transferred. The last
+character may still be shifting out when this turns false, use
+usart_get_flag() with USART_FLAG_TC to wait for the line to go idle.
+*/
+
+bool usart_dma_tx_busy(struct usart_dma_tx *tx)
+{
+	return tx->count != 0;
+}
+
+/**@}*/
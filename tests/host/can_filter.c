@@ -0,0 +1,170 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * CAN filter compiler on random standard identifier rules. Every requested
+ * identifier must be accepted, and only by entries of the FIFO its rule
+ * selects, whatever the number of filters left for the merges.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <libopencm3/stm32/can_filter.h>
+
+#define IDS		2048
+#define MAX_RULES	12
+#define CASES		3000
+
+static struct can_filter_entry buf[MAX_RULES * 22];
+
+#define fail(...) do { \
+	printf("FAIL %s:%d: ", __func__, __LINE__); \
+	printf(__VA_ARGS__); \
+	printf("\n"); \
+	exit(1); \
+} while (0)
+
+static bool matches(const struct can_filter_entry *e, uint32_t id)
+{
+	if (e->type == CAN_FILTER_RANGE || e->type == CAN_FILTER_DUAL) {
+		return id >= e->id && id <= e->id2;
+	}
+	return (id & e->id2) == e->id;
+}
+
+/* Random rules that do not overlap. Returns the FIFO of each identifier,
+ * -1 when none is requested. */
+static uint16_t make_rules(struct can_filter_rule *rules, int8_t *fifo)
+{
+	uint16_t i, n = 1 + rand() % MAX_RULES;
+	uint32_t id, first, len;
+
+	for (id = 0; id < IDS; id++) {
+		fifo[id] = -1;
+	}
+	for (i = 0; i < n; i++) {
+		do {
+			first = rand() % IDS;
+			len = (rand() % 3) ? 1 + rand() % 8 : 1 + rand() % 64;
+			if (first + len > IDS) {
+				len = IDS - first;
+			}
+			for (id = first; id < first + len; id++) {
+				if (fifo[id] >= 0) {
+					break;
+				}
+			}
+		} while (id < first + len);
+
+		rules[i].first = first;
+		rules[i].last = first + len - 1;
+		rules[i].ext = false;
+		rules[i].fifo = rand() % 2;
+		for (id = first; id < first + len; id++) {
+			fifo[id] = rules[i].fifo;
+		}
+	}
+	return n;
+}
+
+static void check(const struct can_filter_set *set, const int8_t *fifo)
+{
+	uint32_t id;
+	uint16_t i;
+	bool seen;
+
+	for (id = 0; id < IDS; id++) {
+		if (fifo[id] < 0) {
+			continue;
+		}
+		seen = false;
+		for (i = 0; i < set->count; i++) {
+			if (!matches(&set->buf[i], id)) {
+				continue;
+			}
+			if (set->buf[i].fifo != fifo[id]) {
+				fail("0x%03x of FIFO%d matches FIFO%d filter %u",
+				     id, fifo[id], set->buf[i].fifo,
+				     set->buf[i].filter);
+			}
+			seen = true;
+		}
+		if (!seen) {
+			fail("0x%03x is not accepted", id);
+		}
+	}
+}
+
+/* The case from the bug report: FIFO0 must not be widened over FIFO1. */
+static void fifo_overlap(void)
+{
+	static const struct can_filter_rule rules[] = {
+		{ 0x00, 0x05, false, 0 },
+		{ 0x64, 0x69, false, 0 },
+		{ 0x32, 0x37, false, 1 },
+	};
+	struct can_filter_set set = { .buf = buf, .size = 64 };
+	int ret;
+
+	ret = can_filter_compile_fdcan(&set, rules, 3, 2, 0);
+	if (ret != CAN_FILTER_E_FILTERS) {
+		fail("fdcan returned %d with %u elements", ret,
+		     set.std_elements);
+	}
+	ret = can_filter_compile_fdcan(&set, rules, 3, 3, 0);
+	if (ret || set.std_elements != 3) {
+		fail("fdcan returned %d with %u elements", ret,
+		     set.std_elements);
+	}
+}
+
+int main(void)
+{
+	struct can_filter_rule rules[MAX_RULES];
+	struct can_filter_set set = { .buf = buf, .size = sizeof(buf) /
+						  sizeof(buf[0]) };
+	static int8_t fifo[IDS];
+	uint32_t c, fitted = 0, tried = 0;
+	uint16_t n, filters;
+
+	srand(1);
+	fifo_overlap();
+	for (c = 0; c < CASES; c++) {
+		n = make_rules(rules, fifo);
+		filters = 1 + rand() % (n + 1);
+		tried += 2;
+
+		if (can_filter_compile_bxcan(&set, rules, n, filters) == 0) {
+			if (set.banks > filters) {
+				fail("%u banks of %u", set.banks, filters);
+			}
+			check(&set, fifo);
+			fitted++;
+		}
+		if (can_filter_compile_fdcan(&set, rules, n, filters, 0) == 0) {
+			if (set.std_elements > filters) {
+				fail("%u elements of %u", set.std_elements,
+				     filters);
+			}
+			check(&set, fifo);
+			fitted++;
+		}
+	}
+	printf("  %u of %u compiles fitted\n", fitted, tried);
+	printf("can_filter: ok\n");
+	return 0;
+}
@@ -0,0 +1,546 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * DMA2D operation queue against a reference renderer. The registers are
+ * mapped at the DMA2D address and a model of the peripheral executes what
+ * the driver programs: CLUT loads, fills, copies, pixel format conversions
+ * and blends, raising the interrupt flags the driver enabled. Random queues
+ * of operations must complete in order, and every output must be pixel
+ * exact with the reference rendering of the operation, computed from the
+ * operation itself with the conversion and blending rules of the reference
+ * manual. Bytes outside the output rectangle must be left alone.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <libopencm3/stm32/dma2d.h>
+
+#define SRAM		0x20000000
+#define SRAM_SIZE	0x100000
+#define ROUNDS		2000
+#define MAX_OPS		6
+
+pthread_mutex_t cm_host_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+#define fail(...) do { \
+	printf("FAIL %s:%d: ", __func__, __LINE__); \
+	printf(__VA_ARGS__); \
+	printf("\n"); \
+	exit(1); \
+} while (0)
+
+#define PTR(addr)	((uint8_t *)(uintptr_t)(addr))
+
+/* Bits per pixel of each colour mode */
+static const uint8_t bits[] = { 32, 24, 16, 16, 16, 8, 8, 16, 4, 8, 4 };
+
+static uint32_t sram_used;
+
+static uint32_t alloc(uint32_t size)
+{
+	uint32_t addr = SRAM + sram_used;
+
+	sram_used += (size + 3) & ~3U;
+	if (sram_used > SRAM_SIZE) {
+		fail("out of memory");
+	}
+	return addr;
+}
+
+/* --- Pixels --------------------------------------------------------------- */
+
+static uint32_t get_raw(const uint8_t *base, uint32_t index, uint8_t cm)
+{
+	uint32_t b = bits[cm], v = 0, i;
+	const uint8_t *p = base + index * b / 8;
+
+	if (b == 4) {
+		/* The first pixel is in the low nibble. */
+		return (index & 1) ? *p >> 4 : *p & 0xf;
+	}
+	for (i = 0; i < b / 8; i++) {
+		v |= (uint32_t)p[i] << (8 * i);
+	}
+	return v;
+}
+
+static void put_raw(uint8_t *base, uint32_t index, uint8_t cm, uint32_t v)
+{
+	uint32_t b = bits[cm], i;
+	uint8_t *p = base + index * b / 8;
+
+	if (b == 4) {
+		*p = (index & 1) ? (*p & 0x0f) | (v << 4) :
+				   (*p & 0xf0) | (v & 0xf);
+		return;
+	}
+	for (i = 0; i < b / 8; i++) {
+		p[i] = v >> (8 * i);
+	}
+}
+
+static uint32_t expand(uint32_t v, int width)
+{
+	switch (width) {
+	case 1:
+		return v ? 0xff : 0;
+	case 4:
+		return v * 0x11;
+	case 5:
+		return (v << 3) | (v >> 2);
+	case 6:
+		return (v << 2) | (v >> 4);
+	default:
+		return v;
+	}
+}
+
+#define ARGB(a, r, g, b) \
+	(((uint32_t)(a) << 24) | ((uint32_t)(r) << 16) | \
+	 ((uint32_t)(g) << 8) | (uint32_t)(b))
+
+/* CLUT entry as ARGB8888 */
+static uint32_t clut_entry(const uint8_t *clut, uint32_t i, bool rgb888)
+{
+	if (rgb888) {
+		return ARGB(0xff, clut[3 * i + 2], clut[3 * i + 1],
+			    clut[3 * i]);
+	}
+	return get_raw(clut, i, DMA2D_xPFCCR_CM_ARGB8888);
+}
+
+/* Pixel converted to ARGB8888 by a layer PFC, before the alpha mode. */
+static uint32_t to_argb(uint32_t v, uint8_t cm, uint32_t color,
+			const uint32_t *clut)
+{
+	switch (cm) {
+	case DMA2D_xPFCCR_CM_ARGB8888:
+		return v;
+	case DMA2D_xPFCCR_CM_RGB888:
+		return v | 0xff000000;
+	case DMA2D_xPFCCR_CM_RGB565:
+		return ARGB(0xff, expand(v >> 11, 5),
+			    expand((v >> 5) & 0x3f, 6), expand(v & 0x1f, 5));
+	case DMA2D_xPFCCR_CM_ARGB1555:
+		return ARGB(expand(v >> 15, 1), expand((v >> 10) & 0x1f, 5),
+			    expand((v >> 5) & 0x1f, 5), expand(v & 0x1f, 5));
+	case DMA2D_xPFCCR_CM_ARGB4444:
+		return ARGB(expand(v >> 12, 4), expand((v >> 8) & 0xf, 4),
+			    expand((v >> 4) & 0xf, 4), expand(v & 0xf, 4));
+	case DMA2D_xPFCCR_CM_L8:
+	case DMA2D_xPFCCR_CM_L4:
+		return clut[v];
+	case DMA2D_xPFCCR_CM_AL44:
+		return (clut[v & 0xf] & 0xffffff) | (expand(v >> 4, 4) << 24);
+	case DMA2D_xPFCCR_CM_AL88:
+		return (clut[v & 0xff] & 0xffffff) | ((v >> 8) << 24);
+	case DMA2D_xPFCCR_CM_A8:
+		return (color & 0xffffff) | (v << 24);
+	case DMA2D_xPFCCR_CM_A4:
+		return (color & 0xffffff) | (expand(v, 4) << 24);
+	}
+	fail("colour mode %u", cm);
+}
+
+static uint32_t from_argb(uint32_t c, uint8_t cm)
+{
+	uint32_t a = c >> 24, r = (c >> 16) & 0xff, g = (c >> 8) & 0xff;
+	uint32_t b = c & 0xff;
+
+	switch (cm) {
+	case DMA2D_xPFCCR_CM_ARGB8888:
+		return c;
+	case DMA2D_xPFCCR_CM_RGB888:
+		return c & 0xffffff;
+	case DMA2D_xPFCCR_CM_RGB565:
+		return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+	case DMA2D_xPFCCR_CM_ARGB1555:
+		return ((a >> 7) << 15) | ((r >> 3) << 10) | ((g >> 3) << 5) |
+		       (b >> 3);
+	case DMA2D_xPFCCR_CM_ARGB4444:
+		return ((a >> 4) << 12) | ((r >> 4) << 8) | ((g >> 4) << 4) |
+		       (b >> 4);
+	}
+	fail("output colour mode %u", cm);
+}
+
+static uint32_t alpha_mode(uint32_t c, uint8_t am, uint8_t alpha)
+{
+	uint32_t a = c >> 24;
+
+	if (am == DMA2D_xPFCCR_AM_FORCE) {
+		a = alpha;
+	} else if (am == DMA2D_xPFCCR_AM_PRODUCT) {
+		a = a * alpha / 255;
+	}
+	return (c & 0xffffff) | (a << 24);
+}
+
+static uint32_t blend(uint32_t fg, uint32_t bg)
+{
+	uint32_t fa = fg >> 24, ba = bg >> 24;
+	uint32_t mult = fa * ba / 255, a = fa + ba - mult, c = 0, s, f, b;
+
+	for (s = 0; s < 24 && a; s += 8) {
+		f = (fg >> s) & 0xff;
+		b = (bg >> s) & 0xff;
+		c |= ((f * fa + b * ba - b * mult) / a) << s;
+	}
+	return (a << 24) | c;
+}
+
+/* --- Peripheral model ---------------------------------------------------- */
+
+struct model_layer {
+	uint32_t addr, offset, pfccr, color;
+	const uint32_t *clut;
+};
+
+static uint32_t model_pixel(const struct model_layer *l, uint32_t index)
+{
+	uint8_t cm = l->pfccr & 0xf;
+	uint32_t v = get_raw(PTR(l->addr), index, cm);
+
+	v = to_argb(v, cm, l->color, l->clut);
+	return alpha_mode(v, (l->pfccr >> DMA2D_xPFCCR_AM_SHIFT) & 3,
+			  l->pfccr >> DMA2D_xPFCCR_ALPHA_SHIFT);
+}
+
+/* The DMA2D loads a CLUT into its own memory at the start. */
+static void model_load_clut(uint32_t pfccr, uint32_t cmar, uint32_t *clut)
+{
+	uint32_t i, size = ((pfccr >> DMA2D_xPFCCR_CS_SHIFT) & 0xff) + 1;
+
+	for (i = 0; i < size; i++) {
+		clut[i] = clut_entry(PTR(cmar), i,
+				     pfccr & DMA2D_xPFCCR_CCM_RGB888);
+	}
+}
+
+static bool model_render(void)
+{
+	uint32_t mode = (DMA2D_CR >> DMA2D_CR_MODE_SHIFT) & 3;
+	uint32_t pl = (DMA2D_NLR >> DMA2D_NLR_PL_SHIFT) & DMA2D_NLR_PL_MASK;
+	uint32_t nl = DMA2D_NLR & DMA2D_NLR_NL_MASK;
+	struct model_layer fg = {
+		DMA2D_FGMAR, DMA2D_FGOR, DMA2D_FGPFCCR, DMA2D_FGCOLR,
+		DMA2D_FG_CLUT
+	};
+	struct model_layer bg = {
+		DMA2D_BGMAR, DMA2D_BGOR, DMA2D_BGPFCCR, DMA2D_BGCOLR,
+		DMA2D_BG_CLUT
+	};
+	uint8_t out = DMA2D_OPFCCR & 7, fgcm = fg.pfccr & 0xf;
+	uint32_t x, y, o, i, c;
+
+	if (mode == DMA2D_CR_MODE_M2M) {
+		out = fgcm;
+	} else if (out > DMA2D_OPFCCR_CM_ARGB4444) {
+		return false;
+	}
+	for (y = 0; y < nl; y++) {
+		for (x = 0; x < pl; x++) {
+			o = y * (pl + DMA2D_OOR) + x;
+			i = y * (pl + fg.offset) + x;
+			if (mode == DMA2D_CR_MODE_R2M) {
+				c = DMA2D_OCOLR;
+			} else if (mode == DMA2D_CR_MODE_M2M) {
+				c = get_raw(PTR(fg.addr), i, fgcm);
+			} else if (mode == DMA2D_CR_MODE_M2MWPFC) {
+				c = from_argb(model_pixel(&fg, i), out);
+			} else {
+				c = blend(model_pixel(&fg, i),
+					  model_pixel(&bg,
+						      y * (pl + bg.offset) + x));
+				c = from_argb(c, out);
+			}
+			put_raw(PTR(DMA2D_OMAR), o, out, c);
+		}
+	}
+	return true;
+}
+
+/* Act on the start bits the driver set, and return the pending
+ * interrupts. */
+static uint32_t model_step(void)
+{
+	DMA2D_ISR &= ~DMA2D_IFCR;
+	DMA2D_IFCR = 0;
+
+	if (DMA2D_FGPFCCR & DMA2D_xPFCCR_START) {
+		DMA2D_FGPFCCR &= ~DMA2D_xPFCCR_START;
+		model_load_clut(DMA2D_FGPFCCR, DMA2D_FGCMAR, DMA2D_FG_CLUT);
+		DMA2D_ISR |= DMA2D_ISR_CTCIF;
+	} else if (DMA2D_BGPFCCR & DMA2D_xPFCCR_START) {
+		DMA2D_BGPFCCR &= ~DMA2D_xPFCCR_START;
+		model_load_clut(DMA2D_BGPFCCR, DMA2D_BGCMAR, DMA2D_BG_CLUT);
+		DMA2D_ISR |= DMA2D_ISR_CTCIF;
+	} else if (DMA2D_CR & DMA2D_CR_START) {
+		DMA2D_CR &= ~DMA2D_CR_START;
+		DMA2D_ISR |= model_render() ? DMA2D_ISR_TCIF : DMA2D_ISR_CEIF;
+	}
+	return DMA2D_ISR & (DMA2D_CR >> 8) & 0x3f;
+}
+
+/* --- Reference renderer -------------------------------------------------- */
+
+static void ref_clut(const struct dma2d_layer *l, uint32_t *clut)
+{
+	uint32_t i;
+
+	for (i = 0; l->clut && i < l->clut_size; i++) {
+		clut[i] = clut_entry((const uint8_t *)l->clut, i,
+				     l->clut_rgb888);
+	}
+}
+
+static uint32_t ref_pixel(const struct dma2d_layer *l, const uint32_t *clut,
+			  uint32_t x, uint32_t y, uint16_t width)
+{
+	uint32_t v = get_raw(PTR(l->addr), y * (width + l->offset) + x,
+			     l->format);
+
+	return alpha_mode(to_argb(v, l->format, l->color, clut),
+			  l->alpha_mode, l->alpha);
+}
+
+/* Render an operation over a copy of its output buffer. */
+static void reference(const struct dma2d_op *op, uint8_t *dst)
+{
+	static uint32_t fg_clut[256], bg_clut[256];
+	uint8_t out = op->dst_format;
+	uint32_t x, y, c;
+
+	ref_clut(&op->fg, fg_clut);
+	ref_clut(&op->bg, bg_clut);
+	if (op->mode == DMA2D_CR_MODE_M2M) {
+		out = op->fg.format;
+	}
+	for (y = 0; y < op->height; y++) {
+		for (x = 0; x < op->width; x++) {
+			switch (op->mode) {
+			case DMA2D_CR_MODE_R2M:
+				c = op->color;
+				break;
+			case DMA2D_CR_MODE_M2M:
+				c = get_raw(PTR(op->fg.addr), y * (op->width +
+					    op->fg.offset) + x, op->fg.format);
+				break;
+			case DMA2D_CR_MODE_M2MWPFC:
+				c = from_argb(ref_pixel(&op->fg, fg_clut, x, y,
+							op->width), out);
+				break;
+			default:
+				c = blend(ref_pixel(&op->fg, fg_clut, x, y,
+						    op->width),
+					  ref_pixel(&op->bg, bg_clut, x, y,
+						    op->width));
+				c = from_argb(c, out);
+				break;
+			}
+			put_raw(dst, y * (op->width + op->dst_offset) + x, out,
+				c);
+		}
+	}
+}
+
+/* --- Test ---------------------------------------------------------------- */
+
+static struct {
+	struct dma2d_op op;
+	uint32_t dst_size;
+	uint8_t *expected;
+	bool bad;
+} ops[MAX_OPS];
+static unsigned int done_count;
+
+static void callback(struct dma2d_queue *q, struct dma2d_op *op)
+{
+	(void)q;
+	if (op != &ops[done_count].op) {
+		fail("operation %u completed out of order", done_count);
+	}
+	done_count++;
+}
+
+static uint32_t random_fill(uint32_t size)
+{
+	uint32_t addr = alloc(size), i;
+
+	for (i = 0; i < size; i++) {
+		PTR(addr)[i] = rand();
+	}
+	return addr;
+}
+
+static void random_layer(struct dma2d_layer *l, uint16_t width,
+			 uint16_t height, bool any_format)
+{
+	uint32_t entries;
+
+	l->format = rand() % (any_format ? 11 : 5);
+	l->offset = 2 * (rand() % 4);
+	l->alpha_mode = rand() % 3;
+	l->alpha = rand();
+	l->color = rand() & 0xffffff;
+	l->addr = random_fill(((width + l->offset) * height *
+			       bits[l->format] + 7) / 8);
+	l->clut = NULL;
+	l->clut_size = 0;
+	l->clut_rgb888 = false;
+
+	switch (l->format) {
+	case DMA2D_xPFCCR_CM_L8:
+	case DMA2D_xPFCCR_CM_AL88:
+		entries = 256;
+		break;
+	case DMA2D_xPFCCR_CM_AL44:
+	case DMA2D_xPFCCR_CM_L4:
+		entries = 16;
+		break;
+	default:
+		return;
+	}
+	l->clut_rgb888 = rand() % 2;
+	l->clut_size = entries;
+	l->clut = (const uint32_t *)PTR(random_fill(entries *
+						    (l->clut_rgb888 ? 3 : 4)));
+}
+
+static void random_op(unsigned int n)
+{
+	struct dma2d_op *op = &ops[n].op;
+	uint8_t out;
+
+	memset(op, 0, sizeof(*op));
+	op->mode = rand() % 4;
+	op->width = 2 * (1 + rand() % 10);
+	op->height = 1 + rand() % 12;
+	op->dst_offset = 2 * (rand() % 4);
+	op->dst_format = rand() % 5;
+	op->color = rand();
+	op->callback = callback;
+
+	if (op->mode != DMA2D_CR_MODE_R2M) {
+		random_layer(&op->fg, op->width, op->height,
+			     op->mode != DMA2D_CR_MODE_M2M);
+	}
+	if (op->mode == DMA2D_CR_MODE_M2MWB) {
+		random_layer(&op->bg, op->width, op->height, true);
+	}
+
+	/* Some operations have an output mode the DMA2D rejects. */
+	ops[n].bad = op->mode != DMA2D_CR_MODE_M2M && rand() % 10 == 0;
+	if (ops[n].bad) {
+		op->dst_format = 5 + rand() % 3;
+	}
+
+	out = (op->mode == DMA2D_CR_MODE_M2M) ? op->fg.format :
+	      (ops[n].bad ? 0 : op->dst_format);
+	if (op->mode == DMA2D_CR_MODE_R2M) {
+		op->color &= (bits[out] == 32) ? 0xffffffff :
+			     (1U << bits[out]) - 1;
+	}
+	ops[n].dst_size = ((op->width + op->dst_offset) * op->height *
+			   bits[out] + 7) / 8;
+	op->dst = random_fill(ops[n].dst_size);
+
+	ops[n].expected = malloc(ops[n].dst_size);
+	memcpy(ops[n].expected, PTR(op->dst), ops[n].dst_size);
+	if (!ops[n].bad) {
+		reference(op, ops[n].expected);
+	}
+}
+
+static void round_trip(struct dma2d_queue *q)
+{
+	unsigned int n = 1 + rand() % MAX_OPS, i, steps;
+	uint32_t errors = q->errors;
+
+	sram_used = 0;
+	done_count = 0;
+	for (i = 0; i < n; i++) {
+		random_op(i);
+	}
+	for (i = 0; i < n; i++) {
+		dma2d_submit(q, &ops[i].op);
+	}
+
+	for (steps = 0; dma2d_busy(q); steps++) {
+		if (steps > 4 * MAX_OPS) {
+			fail("queue stuck after %u operations", done_count);
+		}
+		if (model_step()) {
+			dma2d_irq(q);
+		}
+	}
+	if (done_count != n) {
+		fail("%u of %u operations completed", done_count, n);
+	}
+
+	for (i = 0; i < n; i++) {
+		if (ops[i].op.status != (ops[i].bad ? -1 : 0)) {
+			fail("status %d of a %s operation", ops[i].op.status,
+			     ops[i].bad ? "bad" : "good");
+		}
+		errors += ops[i].bad;
+		if (memcmp(PTR(ops[i].op.dst), ops[i].expected,
+			   ops[i].dst_size)) {
+			fail("mode %u, output %u, fg %u, bg %u: output differs",
+			     ops[i].op.mode, ops[i].op.dst_format,
+			     ops[i].op.fg.format, ops[i].op.bg.format);
+		}
+		free(ops[i].expected);
+	}
+	if (q->errors != errors) {
+		fail("%u errors counted, %u expected", q->errors, errors);
+	}
+}
+
+static void *map(uint32_t addr, uint32_t size)
+{
+	void *p = mmap((void *)(uintptr_t)addr, size, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1,
+		       0);
+
+	if (p != (void *)(uintptr_t)addr) {
+		fail("cannot map 0x%08x", addr);
+	}
+	return p;
+}
+
+int main(void)
+{
+	struct dma2d_queue q;
+	uint32_t r;
+
+	map(DMA2D_BASE, 0x1000);
+	map(SRAM, SRAM_SIZE);
+	srand(1);
+
+	dma2d_queue_init(&q);
+	for (r = 0; r < ROUNDS; r++) {
+		round_trip(&q);
+	}
+	printf("  %u operations, %u rejected\n", q.ops, q.errors);
+	printf("dma2d: ok\n");
+	return 0;
+}
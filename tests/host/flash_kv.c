@@ -0,0 +1,276 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Flash key-value store on a RAM backend. The power is cut after a random
+ * number of flash operations, leaving the word being programmed or the area
+ * being erased half done, and the store must come back with every key
+ * holding either its old or its new value.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libopencm3/stm32/flash_kv.h>
+
+#define BASE		0x1000
+#define AREA_SIZE	1024
+#define MAX_AREAS	4
+#define KEYS		8
+#define MAX_LEN		60
+
+static uint8_t mem[MAX_AREAS * AREA_SIZE];
+/* Flash operations left before the power cut, -1 for none */
+static long budget = -1;
+static bool off;
+
+static struct flash_kv_area areas[MAX_AREAS];
+static uint32_t index_mem[KEYS];
+static struct flash_kv kv;
+/* Collections over all boots */
+static uint32_t collections;
+
+/* Expected value of each key: generation and length, len 0 when unset */
+static struct {
+	uint32_t gen;
+	uint16_t len;
+} model[KEYS];
+
+#define fail(...) do { \
+	printf("FAIL %s:%d: ", __func__, __LINE__); \
+	printf(__VA_ARGS__); \
+	printf("\n"); \
+	exit(1); \
+} while (0)
+
+static bool power_cut(void)
+{
+	if (off) {
+		return true;
+	}
+	if (budget > 0) {
+		budget--;
+	} else if (budget == 0) {
+		off = true;
+	}
+	return off;
+}
+
+static int ram_erase(struct flash_kv *store, const struct flash_kv_area *a)
+{
+	uint8_t *p = mem + a->address - BASE;
+
+	(void)store;
+	if (power_cut()) {
+		/* Interrupted erase: part of the area is still programmed. */
+		memset(p + (rand() % 2) * a->size / 2, 0xff, a->size / 2);
+		return -1;
+	}
+	memset(p, 0xff, a->size);
+	return 0;
+}
+
+static int ram_program(struct flash_kv *store, uint32_t address,
+		       const uint8_t *data)
+{
+	uint8_t *p = mem + address - BASE;
+	int i, n = 8;
+
+	(void)store;
+	for (i = 0; i < 8; i++) {
+		if (p[i] != 0xff) {
+			fail("programming a written word at 0x%x", address);
+		}
+	}
+	if (power_cut()) {
+		/* Interrupted program: only some bytes are written. */
+		n = rand() % 8;
+	}
+	for (i = 0; i < n; i++) {
+		p[i] = data[i];
+	}
+	return (n == 8) ? 0 : -1;
+}
+
+static void ram_read(struct flash_kv *store, uint32_t address, uint8_t *data,
+		     uint32_t len)
+{
+	(void)store;
+	memcpy(data, mem + address - BASE, len);
+}
+
+static const struct flash_kv_ops ram_ops = {
+	.erase = ram_erase,
+	.program = ram_program,
+	.read = ram_read,
+	.erased = 0xff,
+};
+
+static void fill(uint8_t *buf, uint16_t key, uint32_t gen, uint16_t len)
+{
+	uint16_t i;
+
+	for (i = 0; i < len; i++) {
+		buf[i] = key * 31 + gen * 7 + i;
+	}
+}
+
+/* Restart the store from whatever the flash holds. */
+static void boot(uint8_t count)
+{
+	uint8_t i;
+	int err;
+
+	off = false;
+	budget = -1;
+	collections += kv.collections;
+	memset(&kv, 0, sizeof(kv));
+	kv.ops = &ram_ops;
+	kv.areas = areas;
+	kv.count = count;
+	kv.index = index_mem;
+	kv.keys = KEYS;
+	for (i = 0; i < count; i++) {
+		areas[i].address = BASE + i * AREA_SIZE;
+		areas[i].size = AREA_SIZE;
+	}
+	err = flash_kv_init(&kv);
+	if (err) {
+		fail("init returned %d", err);
+	}
+}
+
+static bool holds(uint16_t key, uint32_t gen, uint16_t len)
+{
+	uint8_t want[MAX_LEN], got[MAX_LEN];
+	int ret = flash_kv_get(&kv, key, got, sizeof(got));
+
+	if (len == 0) {
+		return ret == FLASH_KV_E_NOKEY;
+	}
+	fill(want, key, gen, len);
+	return ret == len && memcmp(want, got, len) == 0;
+}
+
+static void check(void)
+{
+	uint16_t key;
+
+	for (key = 0; key < KEYS; key++) {
+		if (!holds(key, model[key].gen, model[key].len)) {
+			fail("key %u lost generation %u", key, model[key].gen);
+		}
+	}
+}
+
+/* Set or delete a random key, with the power cut after cut operations. */
+static void step(uint32_t gen, long cut)
+{
+	uint16_t key = rand() % KEYS;
+	uint16_t len = (rand() % 5) ? 1 + rand() % MAX_LEN : 0;
+	uint8_t buf[MAX_LEN];
+	int err;
+
+	fill(buf, key, gen, len);
+	budget = cut;
+	if (len) {
+		err = flash_kv_set(&kv, key, buf, len);
+	} else {
+		err = flash_kv_delete(&kv, key);
+		if (err == FLASH_KV_E_NOKEY) {
+			err = 0;
+		}
+	}
+
+	if (cut < 0 && err) {
+		fail("set/delete of key %u returned %d", key, err);
+	}
+	if (!err) {
+		model[key].gen = gen;
+		model[key].len = len;
+	}
+	if (cut >= 0) {
+		/* Either value may survive a cut, check() rejects any other. */
+		boot(kv.count);
+		if (holds(key, gen, len)) {
+			model[key].gen = gen;
+			model[key].len = len;
+		}
+	}
+	if (rand() % 8 == 0) {
+		flash_kv_compact(&kv);
+	}
+}
+
+static void run(uint8_t count, uint32_t steps, long cuts)
+{
+	uint32_t gen;
+
+	memset(mem, 0xff, sizeof(mem));
+	memset(model, 0, sizeof(model));
+	collections = 0;
+	boot(count);
+	for (gen = 1; gen <= steps; gen++) {
+		step(gen, (gen % 4 == 0) ? rand() % cuts : -1);
+		check();
+		if (gen % 97 == 0) {
+			boot(count);
+			check();
+		}
+	}
+	printf("  %u areas: %u steps, %u collections\n", count, steps,
+	       collections + kv.collections);
+}
+
+/* Two areas: the full head is collected into the erased one. */
+static void two_areas(void)
+{
+	uint8_t buf[40];
+	uint32_t i;
+	int err;
+
+	memset(mem, 0xff, sizeof(mem));
+	memset(model, 0, sizeof(model));
+	boot(2);
+	for (i = 1; i <= 1000; i++) {
+		fill(buf, i % 4, i, sizeof(buf));
+		err = flash_kv_set(&kv, i % 4, buf, sizeof(buf));
+		if (err) {
+			fail("set %u returned %d", i, err);
+		}
+		model[i % 4].gen = i;
+		model[i % 4].len = sizeof(buf);
+	}
+	if (kv.collections == 0) {
+		fail("no collection");
+	}
+	boot(2);
+	check();
+}
+
+int main(void)
+{
+	uint8_t count;
+
+	srand(1);
+	two_areas();
+	for (count = 2; count <= MAX_AREAS; count++) {
+		run(count, 20000, 64);
+	}
+	printf("flash_kv: ok\n");
+	return 0;
+}
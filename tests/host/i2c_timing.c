@@ -0,0 +1,231 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * I2C TIMINGR solver against the timing settings examples of the reference
+ * manuals (8, 16 and 48 MHz kernel clocks) and over a sweep of clocks. Every
+ * result must meet the SCL low/high, data hold and data setup formulas of the
+ * reference manual and its kernel clock limits, must not exceed the requested
+ * rate and, on the example clocks, must come at least as close to it as the
+ * example.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <libopencm3/stm32/i2c.h>
+
+#define fail(...) do { \
+	printf("FAIL %s:%d: ", __func__, __LINE__); \
+	printf(__VA_ARGS__); \
+	printf("\n"); \
+	exit(1); \
+} while (0)
+
+/* I2C specification limits in ns: tLOW, tHIGH, tSU;DAT, tVD;DAT */
+static const struct {
+	uint32_t max_speed;
+	uint32_t low, high, setup, valid;
+	/* Bus rise and fall times used for the mode */
+	uint16_t rise, fall;
+} modes[] = {
+	{ 100000, 4700, 4000, 250, 3450, 1000, 300 },
+	{ 400000, 1300, 600, 100, 900, 300, 300 },
+	{ 1000000, 500, 260, 50, 450, 100, 100 },
+};
+
+/* Reference manual examples: PRESC, SCLL, SCLH, SDADEL, SCLDEL */
+static const struct {
+	uint32_t clock, speed;
+	uint8_t presc, scll, sclh, sdadel, scldel;
+} examples[] = {
+	{ 8000000, 10000, 0x1, 0xc7, 0xc3, 0x2, 0x4 },
+	{ 8000000, 100000, 0x1, 0x13, 0xf, 0x2, 0x4 },
+	{ 8000000, 400000, 0x0, 0x9, 0x3, 0x1, 0x3 },
+	{ 8000000, 500000, 0x0, 0x6, 0x3, 0x0, 0x1 },
+	{ 16000000, 10000, 0x3, 0xc7, 0xc3, 0x2, 0x4 },
+	{ 16000000, 100000, 0x3, 0x13, 0xf, 0x2, 0x4 },
+	{ 16000000, 400000, 0x1, 0x9, 0x3, 0x2, 0x3 },
+	{ 16000000, 1000000, 0x0, 0x4, 0x2, 0x0, 0x2 },
+	{ 48000000, 10000, 0xb, 0xc7, 0xc3, 0x2, 0x4 },
+	{ 48000000, 100000, 0xb, 0x13, 0xf, 0x2, 0x4 },
+	{ 48000000, 400000, 0x5, 0x9, 0x3, 0x3, 0x3 },
+	{ 48000000, 1000000, 0x5, 0x3, 0x1, 0x0, 0x1 },
+};
+
+#define TIMINGR(presc, scll, sclh, sdadel, scldel) \
+	(((uint32_t)(presc) << I2C_TIMINGR_PRESC_SHIFT) | \
+	 ((uint32_t)(scldel) << I2C_TIMINGR_SCLDEL_SHIFT) | \
+	 ((uint32_t)(sdadel) << I2C_TIMINGR_SDADEL_SHIFT) | \
+	 ((uint32_t)(sclh) << I2C_TIMINGR_SCLH_SHIFT) | \
+	 ((uint32_t)(scll) << I2C_TIMINGR_SCLL_SHIFT))
+
+static unsigned int mode_of(uint32_t speed)
+{
+	return (speed <= 100000) ? 0 : (speed <= 400000) ? 1 : 2;
+}
+
+/* SCL period in ps of a TIMINGR value, with the synchronisation delays of
+ * the reference manual: filters plus two kernel clocks per edge. */
+static double period(const struct i2c_timing *t, uint32_t timingr)
+{
+	double tclk = 1e12 / t->clock;
+	double tpresc = (((timingr >> I2C_TIMINGR_PRESC_SHIFT) & 0xf) + 1) *
+			tclk;
+	double tsync = (t->analog_filter ? 50000 : 0) +
+		       (t->digital_filter + 2) * tclk;
+
+	return ((timingr & 0xff) + 1) * tpresc +
+	       (((timingr >> I2C_TIMINGR_SCLH_SHIFT) & 0xff) + 1) * tpresc +
+	       2 * tsync + (t->rise_ns + t->fall_ns) * 1000.0;
+}
+
+/* The SCL and SDA timing formulas of the reference manual. */
+static void check(const struct i2c_timing *t, uint32_t timingr)
+{
+	unsigned int m = mode_of(t->speed);
+	double tclk = 1e12 / t->clock;
+	double tpresc = (((timingr >> I2C_TIMINGR_PRESC_SHIFT) & 0xf) + 1) *
+			tclk;
+	double taf_min = t->analog_filter ? 50000 : 0;
+	double taf_max = t->analog_filter ? 260000 : 0;
+	double tdnf = t->digital_filter * tclk;
+	double tsync = taf_min + tdnf + 2 * tclk;
+	uint32_t scll = timingr & 0xff;
+	uint32_t sclh = (timingr >> I2C_TIMINGR_SCLH_SHIFT) & 0xff;
+	uint32_t sdadel = (timingr >> I2C_TIMINGR_SDADEL_SHIFT) & 0xf;
+	uint32_t scldel = (timingr >> I2C_TIMINGR_SCLDEL_SHIFT) & 0xf;
+	/* tSYNC1 and tSYNC2 of the reference manual include the edges. */
+	double tlow = (scll + 1) * tpresc + tsync + t->fall_ns * 1000.0;
+	double thigh = (sclh + 1) * tpresc + tsync + t->rise_ns * 1000.0;
+
+	if (4 * tclk >= tlow - taf_min - tdnf || tclk >= thigh) {
+		fail("%u Hz at %u Hz: clock too slow for TIMINGR 0x%08x",
+		     t->speed, t->clock, timingr);
+	}
+	if (tlow < modes[m].low * 1000.0) {
+		fail("%u Hz at %u Hz: tLOW too short, TIMINGR 0x%08x",
+		     t->speed, t->clock, timingr);
+	}
+	if (thigh < modes[m].high * 1000.0) {
+		fail("%u Hz at %u Hz: tHIGH too short, TIMINGR 0x%08x",
+		     t->speed, t->clock, timingr);
+	}
+	if (sdadel * tpresc < t->fall_ns * 1000.0 - taf_min - tdnf - 3 * tclk) {
+		fail("%u Hz at %u Hz: SDADEL below the fall time, TIMINGR 0x%08x",
+		     t->speed, t->clock, timingr);
+	}
+	if (sdadel &&
+	    sdadel * tpresc > modes[m].valid * 1000.0 - taf_max - tdnf -
+			      4 * tclk) {
+		fail("%u Hz at %u Hz: SDADEL beyond tVD;DAT, TIMINGR 0x%08x",
+		     t->speed, t->clock, timingr);
+	}
+	if ((scldel + 1) * tpresc < (t->rise_ns + modes[m].setup) * 1000.0) {
+		fail("%u Hz at %u Hz: SCLDEL below tSU;DAT, TIMINGR 0x%08x",
+		     t->speed, t->clock, timingr);
+	}
+	if (period(t, timingr) < 1e12 / t->speed) {
+		fail("%u Hz at %u Hz: SCL at %.0f Hz, TIMINGR 0x%08x",
+		     t->speed, t->clock, 1e12 / period(t, timingr), timingr);
+	}
+}
+
+static void fill(struct i2c_timing *t, uint32_t clock, uint32_t speed)
+{
+	t->clock = clock;
+	t->speed = speed;
+	t->rise_ns = modes[mode_of(speed)].rise;
+	t->fall_ns = modes[mode_of(speed)].fall;
+	t->analog_filter = true;
+	t->digital_filter = 0;
+}
+
+static void reference_examples(void)
+{
+	struct i2c_timing t;
+	uint32_t timingr, ref;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(examples) / sizeof(examples[0]); i++) {
+		fill(&t, examples[i].clock, examples[i].speed);
+		ref = TIMINGR(examples[i].presc, examples[i].scll,
+			      examples[i].sclh, examples[i].sdadel,
+			      examples[i].scldel);
+		/* The examples themselves pass the formulas. */
+		check(&t, ref);
+
+		if (!i2c_timing_compute(&t, &timingr)) {
+			fail("%u Hz at %u Hz rejected", t.speed, t.clock);
+		}
+		check(&t, timingr);
+		if (period(&t, timingr) > period(&t, ref)) {
+			fail("%u Hz at %u Hz: %.0f Hz, the example gives %.0f Hz",
+			     t.speed, t.clock, 1e12 / period(&t, timingr),
+			     1e12 / period(&t, ref));
+		}
+	}
+
+	/* 2 MHz cannot resolve the low period of Fast-mode Plus. */
+	fill(&t, 2000000, 1000000);
+	if (i2c_timing_compute(&t, &timingr)) {
+		fail("1 MHz at 2 MHz accepted, TIMINGR 0x%08x", timingr);
+	}
+}
+
+static void sweep(void)
+{
+	static const uint32_t speeds[] = { 10000, 100000, 400000, 1000000 };
+	struct i2c_timing t;
+	uint32_t clock, timingr, solved = 0, tried = 0;
+	unsigned int s, f;
+
+	for (clock = 1000000; clock <= 170000000; clock += 250000) {
+		for (s = 0; s < sizeof(speeds) / sizeof(speeds[0]); s++) {
+			for (f = 0; f < 4; f++) {
+				fill(&t, clock, speeds[s]);
+				t.analog_filter = f & 1;
+				t.digital_filter = (f & 2) ? 3 : 0;
+				tried++;
+				if (!i2c_timing_compute(&t, &timingr)) {
+					/* From the example clocks on, the only
+					 * excuse is a rate below the longest
+					 * period. */
+					if (clock >= ((speeds[s] > 400000) ?
+						      16000000 : 8000000) &&
+					    period(&t, TIMINGR(15, 255, 255,
+							       0, 0)) >=
+					    1e12 / t.speed) {
+						fail("%u Hz at %u Hz rejected",
+						     t.speed, clock);
+					}
+					continue;
+				}
+				check(&t, timingr);
+				solved++;
+			}
+		}
+	}
+	printf("  %u of %u settings solved\n", solved, tried);
+}
+
+int main(void)
+{
+	reference_examples();
+	sweep();
+	printf("i2c_timing: ok\n");
+	return 0;
+}
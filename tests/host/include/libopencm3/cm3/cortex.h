@@ -0,0 +1,51 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host stand-in for the Cortex-M core header: masking interrupts becomes
+ * holding one global recursive mutex, so the PRIMASK fallbacks and critical
+ * sections of the library run atomically against the other test threads.
+ * Tests define cm_host_lock with PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP.
+ */
+
+#ifndef LIBOPENCM3_CORTEX_H
+#define LIBOPENCM3_CORTEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+extern pthread_mutex_t cm_host_lock;
+
+static inline void cm_host_unlock(pthread_mutex_t **lock)
+{
+	pthread_mutex_unlock(*lock);
+}
+
+#define CM_ATOMIC_BLOCK()						\
+	for (int __cm_once = (pthread_mutex_lock(&cm_host_lock), 1);	\
+	     __cm_once;							\
+	     __cm_once = (pthread_mutex_unlock(&cm_host_lock), 0))
+
+#define CM_ATOMIC_CONTEXT()						\
+	pthread_mutex_t *__cm_lock __attribute__((cleanup(cm_host_unlock))) = \
+		(pthread_mutex_lock(&cm_host_lock), &cm_host_lock)
+
+#define CM_CRITICAL_BLOCK()	CM_ATOMIC_BLOCK()
+#define CM_CRITICAL_CONTEXT()	CM_ATOMIC_CONTEXT()
+
+#endif
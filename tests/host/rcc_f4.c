@@ -0,0 +1,175 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * STM32F4 PLL solver swept over sources, targets and supply voltages. Every
+ * result must meet the PLL, bus and voltage scale limits of the reference
+ * manual and the flash wait states of every F4 datasheet, and no valid PLL
+ * setting may come closer to the target.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <libopencm3/stm32/rcc.h>
+#include <libopencm3/stm32/flash.h>
+
+#define MHZ		1000000U
+
+#define fail(...) do { \
+	printf("FAIL %s:%d: ", __func__, __LINE__); \
+	printf(__VA_ARGS__); \
+	printf("\n"); \
+	exit(1); \
+} while (0)
+
+/* HCLK per wait state at 2.7, 2.4, 2.1 and 1.7/1.8 V and above. */
+static const struct {
+	const char *part;
+	uint32_t step[4];
+} parts[] = {
+	{ "F40x/F41x", { 30, 24, 22, 20 } },
+	{ "F42x/F43x", { 30, 24, 22, 20 } },
+	{ "F401", { 30, 24, 18, 16 } },
+	{ "F410/F411/F412/F413", { 30, 24, 18, 16 } },
+	{ "F446", { 30, 24, 22, 20 } },
+	{ "F469/F479", { 30, 24, 22, 20 } },
+};
+
+static const uint16_t supplies[] = { 1800, 2000, 2200, 2500, 3000, 3300 };
+
+static uint32_t wait_states(uint32_t hclk, uint32_t step_mhz)
+{
+	return (hclk - 1) / (step_mhz * MHZ);
+}
+
+static int supply_range(uint16_t mv)
+{
+	return (mv >= 2700) ? 0 : (mv >= 2400) ? 1 : (mv >= 2100) ? 2 : 3;
+}
+
+/* Highest SYSCLK not above target from any valid M, N, P. */
+static uint32_t best_sysclk(uint32_t src, uint32_t target)
+{
+	uint32_t m, n, p, vco, f, best = 0;
+
+	for (m = 2; m <= 63; m++) {
+		if (src < m * MHZ || src > 2 * m * MHZ) {
+			continue;
+		}
+		for (n = 50; n <= 432; n++) {
+			vco = (uint64_t)src * n / m;
+			if (vco < 100 * MHZ || vco > 432 * MHZ) {
+				continue;
+			}
+			for (p = 2; p <= 8; p += 2) {
+				f = vco / p;
+				if (f <= target && f > best) {
+					best = f;
+				}
+			}
+		}
+	}
+	return best;
+}
+
+static void check(const struct rcc_clock_request *req,
+		  const struct rcc_clock_scale *c)
+{
+	uint32_t src = req->hse_frequency ? req->hse_frequency : 16 * MHZ;
+	uint64_t vco = (uint64_t)src * c->plln / c->pllm;
+	uint32_t sys = c->ahb_frequency, ws, need;
+	unsigned int i;
+
+	if (src < c->pllm * MHZ || src > 2 * c->pllm * MHZ ||
+	    vco < 100 * MHZ || vco > 432 * MHZ ||
+	    c->plln < 50 || c->plln > 432 || c->pllq < 2 || c->pllq > 15 ||
+	    (c->pllp & 1) || c->pllp < 2 || c->pllp > 8) {
+		fail("M %u N %u P %u Q %u out of range", c->pllm, c->plln,
+		     c->pllp, c->pllq);
+	}
+	if (sys != vco / c->pllp || sys > req->sysclk_frequency) {
+		fail("SYSCLK %u for %u", sys, req->sysclk_frequency);
+	}
+	if (vco / c->pllq > 48 * MHZ ||
+	    (req->usb && vco != (uint64_t)48 * MHZ * c->pllq)) {
+		fail("PLL Q output %u", (uint32_t)(vco / c->pllq));
+	}
+	if (c->apb1_frequency > 42 * MHZ || c->apb2_frequency > 84 * MHZ ||
+	    c->apb1_frequency < sys / 16 || c->apb2_frequency < sys / 16) {
+		fail("APB %u %u", c->apb1_frequency, c->apb2_frequency);
+	}
+	if ((sys > 84 * MHZ && c->voltage_scale != PWR_SCALE1) ||
+	    (sys > 60 * MHZ && c->voltage_scale == PWR_SCALE3)) {
+		fail("scale %d at %u", c->voltage_scale, sys);
+	}
+
+	ws = c->flash_config & FLASH_ACR_LATENCY_MASK;
+	for (i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+		need = wait_states(sys,
+				   parts[i].step[supply_range(req->vdd_mv)]);
+		if (ws < need) {
+			fail("%u wait states at %u Hz %u mV, %s needs %u", ws,
+			     sys, req->vdd_mv, parts[i].part, need);
+		}
+	}
+}
+
+int main(void)
+{
+	struct rcc_clock_request req = { 0 };
+	struct rcc_clock_scale c;
+	uint32_t src, target, solved = 0, tried = 0;
+	unsigned int v;
+
+	for (src = 0; src <= 26 * MHZ; src += src ? MHZ / 2 : 4 * MHZ) {
+		for (target = 24 * MHZ; target <= 180 * MHZ; target += MHZ) {
+			for (v = 0; v < 2 * sizeof(supplies) /
+				    sizeof(supplies[0]); v++) {
+				req.hse_frequency = src;
+				req.sysclk_frequency = target;
+				req.usb = v & 1;
+				req.vdd_mv = supplies[v / 2];
+				tried++;
+				if (!rcc_clock_scale_solve(&req, &c)) {
+					if (!req.usb) {
+						fail("no PLL for %u from %u",
+						     target, src);
+					}
+					continue;
+				}
+				check(&req, &c);
+				solved++;
+			}
+
+			/* Optimality, on whole MHz sources only. */
+			if (src % MHZ || target % (7 * MHZ)) {
+				continue;
+			}
+			req.usb = false;
+			rcc_clock_scale_solve(&req, &c);
+			if (c.ahb_frequency !=
+			    best_sysclk(src ? src : 16 * MHZ, target)) {
+				fail("%u from %u, %u is possible",
+				     c.ahb_frequency, src,
+				     best_sysclk(src ? src : 16 * MHZ, target));
+			}
+		}
+	}
+	printf("  %u of %u requests solved\n", solved, tried);
+	printf("rcc_f4: ok\n");
+	return 0;
+}
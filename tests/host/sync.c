@@ -0,0 +1,197 @@
+/*
+ * This file is part of the libopencm3 project.
+ *
+ * This library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Lock free rings and sequence lock under threads. Four producers share an
+ * MPSC ring, one feeds an SPSC ring and one rewrites a seqlock snapshot,
+ * while the main thread consumes both rings and reads the snapshot. No
+ * element may be lost, duplicated or reordered per producer, and no
+ * snapshot may be torn. The atomics run on the PRIMASK fallback, which the
+ * host cortex.h turns into a mutex.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+#include <libopencm3/cm3/sync.h>
+
+#define PRODUCERS	4
+#define ELEMS		20000
+#define SNAP_WORDS	4
+/* Consumer passes without an element before a loss is assumed */
+#define STALL		1000000
+
+pthread_mutex_t cm_host_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+static struct sync_mpsc mpsc;
+static uint32_t mpsc_buf[64];
+static volatile uint32_t mpsc_seq[64];
+
+static struct sync_spsc spsc;
+static uint32_t spsc_buf[16];
+
+static struct sync_seqlock seqlock = SYNC_SEQLOCK_INIT;
+static volatile uint32_t snap[SNAP_WORDS];
+static volatile bool stop;
+
+static volatile uint32_t counter;
+
+#define fail(...) do { \
+	printf("FAIL %s:%d: ", __func__, __LINE__); \
+	printf(__VA_ARGS__); \
+	printf("\n"); \
+	exit(1); \
+} while (0)
+
+static void *mpsc_producer(void *arg)
+{
+	uint32_t id = (uintptr_t)arg, i, v;
+
+	for (i = 0; i < ELEMS; i++) {
+		v = (id << 24) | i;
+		while (!sync_mpsc_push(&mpsc, &v)) {
+			sched_yield();
+		}
+		sync_fetch_add(&counter, 1);
+	}
+	return NULL;
+}
+
+static void *spsc_producer(void *arg)
+{
+	uint32_t i;
+
+	(void)arg;
+	for (i = 0; i < PRODUCERS * ELEMS; i++) {
+		while (!sync_spsc_push(&spsc, &i)) {
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static void *seqlock_writer(void *arg)
+{
+	uint32_t i, k;
+
+	(void)arg;
+	for (i = 1; !stop; i++) {
+		sync_seqlock_write_begin(&seqlock);
+		for (k = 0; k < SNAP_WORDS; k++) {
+			snap[k] = i;
+		}
+		sync_seqlock_write_end(&seqlock);
+		if (i % 64 == 0) {
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+static void read_snapshot(void)
+{
+	uint32_t seq, k, copy[SNAP_WORDS];
+
+	do {
+		seq = sync_seqlock_read_begin(&seqlock);
+		for (k = 0; k < SNAP_WORDS; k++) {
+			copy[k] = snap[k];
+		}
+	} while (sync_seqlock_read_retry(&seqlock, seq));
+
+	for (k = 1; k < SNAP_WORDS; k++) {
+		if (copy[k] != copy[0]) {
+			fail("torn snapshot %u/%u", copy[0], copy[k]);
+		}
+	}
+}
+
+/* Single threaded semantics of the atomics. */
+static void atomics(void)
+{
+	uint32_t x = 5;
+
+	if (sync_fetch_add(&x, 3) != 5 || x != 8) {
+		fail("fetch_add");
+	}
+	if (sync_cas(&x, 7, 1) || x != 8 || !sync_cas(&x, 8, 2) || x != 2) {
+		fail("cas");
+	}
+	if (sync_exchange(&x, 9) != 2 || x != 9) {
+		fail("exchange");
+	}
+}
+
+int main(void)
+{
+	pthread_t t[PRODUCERS + 2];
+	uint32_t next[PRODUCERS] = { 0 };
+	uint32_t mpsc_got = 0, spsc_got = 0, reads = 0, idle = 0, v, id;
+	uintptr_t i;
+
+	atomics();
+	sync_mpsc_init(&mpsc, mpsc_buf, mpsc_seq, 64, sizeof(uint32_t));
+	sync_spsc_init(&spsc, spsc_buf, 16, sizeof(uint32_t));
+
+	for (i = 0; i < PRODUCERS; i++) {
+		pthread_create(&t[i], NULL, mpsc_producer, (void *)i);
+	}
+	pthread_create(&t[PRODUCERS], NULL, spsc_producer, NULL);
+	pthread_create(&t[PRODUCERS + 1], NULL, seqlock_writer, NULL);
+
+	while (mpsc_got < PRODUCERS * ELEMS || spsc_got < PRODUCERS * ELEMS) {
+		while (sync_mpsc_pop(&mpsc, &v)) {
+			id = v >> 24;
+			if (id >= PRODUCERS || (v & 0xffffff) != next[id]) {
+				fail("MPSC got 0x%08x, producer %u at %u", v,
+				     id, next[id % PRODUCERS]);
+			}
+			next[id]++;
+			mpsc_got++;
+			idle = 0;
+		}
+		while (sync_spsc_pop(&spsc, &v)) {
+			if (v != spsc_got) {
+				fail("SPSC got %u, expected %u", v, spsc_got);
+			}
+			spsc_got++;
+			idle = 0;
+		}
+		if (++idle == STALL) {
+			fail("stalled at %u + %u elements", mpsc_got, spsc_got);
+		}
+		read_snapshot();
+		reads++;
+		sched_yield();
+	}
+
+	stop = true;
+	for (i = 0; i < PRODUCERS + 2; i++) {
+		pthread_join(t[i], NULL);
+	}
+	if (sync_mpsc_pop(&mpsc, &v) || sync_spsc_pop(&spsc, &v)) {
+		fail("element left after the last one");
+	}
+	if (counter != PRODUCERS * ELEMS) {
+		fail("counter %u of %u", counter, PRODUCERS * ELEMS);
+	}
+	printf("  %u + %u elements, %u snapshots\n", mpsc_got, spsc_got,
+	       reads);
+	printf("sync: ok\n");
+	return 0;
+}